@@ -1,4 +1,7 @@
 #include "app.h"
+#include "bitmap_probe.h"
+
+#include <fstream>
 
 
 void App::Setup() {
@@ -9,6 +12,22 @@ void App::Setup() {
     fpf_.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
     fpf_.AddFilterMaker("edge", &FilterFactories::MakeEdgeDetectionFilter);
     fpf_.AddFilterMaker("scale", &FilterFactories::MakeLanczosScaleFilter);
+    fpf_.AddFilterMaker("median", &FilterFactories::MakeMedianFilter);
+    fpf_.AddFilterMaker("bilateral", &FilterFactories::MakeBilateralFilter);
+    fpf_.AddFilterMaker("unsharp", &FilterFactories::MakeUnsharpMaskFilter);
+    fpf_.AddFilterMaker("erode", &FilterFactories::MakeMorphologyFilter);
+    fpf_.AddFilterMaker("dilate", &FilterFactories::MakeMorphologyFilter);
+    fpf_.AddFilterMaker("open", &FilterFactories::MakeMorphologyFilter);
+    fpf_.AddFilterMaker("close", &FilterFactories::MakeMorphologyFilter);
+    fpf_.AddFilterMaker("canny", &FilterFactories::MakeCannyFilter);
+    fpf_.AddFilterMaker("adaptive_threshold", &FilterFactories::MakeAdaptiveThresholdFilter);
+    fpf_.AddFilterMaker("equalize", &FilterFactories::MakeEqualizeFilter);
+    fpf_.AddFilterMaker("clahe", &FilterFactories::MakeClaheFilter);
+    fpf_.AddFilterMaker("rotate", &FilterFactories::MakeRotateFilter);
+    fpf_.AddFilterMaker("affine", &FilterFactories::MakeAffineFilter);
+    fpf_.AddFilterMaker("transpose", &FilterFactories::MakeTransposeFilter);
+    fpf_.AddFilterMaker("rot90", &FilterFactories::MakeRot90Filter);
+    fpf_.AddFilterMaker("flip", &FilterFactories::MakeFlipFilter);
 }
 
 
@@ -22,7 +41,16 @@ void App::Run(int argc, char* argv[]) {
         std::cerr <<"Wrong program arguments" <<std::endl;
         return;
     }
-    bool fp_created = fpf_.CreateFilterPipeline(fp_, cmd_parser_.GetData());
+    if (cmd_parser_.HasOption("probe")) {
+        RunProbe();
+        return;
+    }
+    fdv_ = cmd_parser_.GetData();
+    if (cmd_parser_.HasOption("gray-output")) {
+        // 8-битный файл хранит одну яркость на пиксель
+        fdv_.push_back({"gs", {}});
+    }
+    bool fp_created = fpf_.CreateFilterPipeline(fp_, fdv_);
     if (!fp_created) {
         return;
     }
@@ -36,16 +64,206 @@ void App::Run(int argc, char* argv[]) {
         std::cerr << "given output file is not bitmap";
         return;
     }
+    if (cmd_parser_.HasOption("thumbnails")) {
+        if (cmd_parser_.HasOption("stream")) {
+            std::cerr << "thumbnails are not supported in streaming mode" <<std::endl;
+            return;
+        }
+        try {
+            for (const Thumbnailer::Size& size : Thumbnailer::ParseSizes(cmd_parser_.GetOption("thumbnails"))) {
+                thumbnailer_.AddSize(size.width, size.height);
+            }
+        } catch (std::logic_error& e) {
+            std::cerr << e.what() <<std::endl;
+            return;
+        }
+    }
+    if (cmd_parser_.HasOption("precision")) {
+        if (cmd_parser_.GetOption("precision") != "float") {
+            std::cerr << "precision must be float" <<std::endl;
+            return;
+        }
+        if (cmd_parser_.HasOption("stream")) {
+            std::cerr << "float precision is not supported in streaming mode" <<std::endl;
+            return;
+        }
+    }
+    if (cmd_parser_.HasOption("cache")) {
+        if (!OpenCache(input_filename)) {
+            return;
+        }
+        if (cache_->Lookup(cache_key_, output_filename)) {
+            if (!thumbnailer_.GetSizes().empty()) {
+                if (!bmp_.Load(output_filename.c_str())) {
+                    std::cerr << "program cannot read the file" <<std::endl;
+                    return;
+                }
+                WriteThumbnails(output_filename);
+            }
+            if (cmd_parser_.HasOption("cache-stats")) {
+                cache_->PrintStats(std::cerr);
+            }
+            return;
+        }
+    }
+    if (cmd_parser_.HasOption("stream")) {
+        if (RunStreaming(input_filename, output_filename)) {
+            StoreResult(output_filename);
+        }
+        return;
+    }
     bool file_loaded = bmp_.Load(input_filename.c_str());
     if (!file_loaded) {
         std::cerr << "program cannot read the file" <<std::endl;
         return;
     }
+    if (!PlanPipeline(bmp_.GetPixels().GetWidth(), bmp_.GetPixels().GetHeight())) {
+        return;
+    }
+    fp_.EnableRegionPropagation(!cmd_parser_.HasOption("no-optimize"));
+    fp_.EnablePrecise(cmd_parser_.HasOption("precision"));
+    fp_.EnableProfiling(cmd_parser_.HasOption("profile"));
     fp_.Apply(bmp_);
-    bool file_writen = bmp_.CreateFile(output_filename.c_str());
+    if (cmd_parser_.HasOption("profile")) {
+        fp_.PrintStats(std::cerr);
+    }
+    bool file_writen = bmp_.CreateFile(output_filename.c_str(), cmd_parser_.HasOption("gray-output"));
     if (!file_writen) {
         std::cerr << "program cannot write the file" <<std::endl;
         return;
     }
+    if (!thumbnailer_.GetSizes().empty()) {
+        WriteThumbnails(output_filename);
+    }
+    StoreResult(output_filename);
+}
+
+bool App::PlanPipeline(size_t width, size_t height) {
+    if (cmd_parser_.HasOption("no-optimize")) {
+        return true;
+    }
+    optimizer_.EnableApproximate(cmd_parser_.HasOption("approximate"));
+    CmdLineParser::FilterDescriptorVector fdv = optimizer_.Optimize(fdv_, width, height);
+    if (cmd_parser_.HasOption("explain")) {
+        optimizer_.Explain(std::cerr);
+    }
+    fp_.Clear();
+    return fpf_.CreateFilterPipeline(fp_, fdv);
+}
+
+void App::RunProbe() {
+    std::string_view path = cmd_parser_.GetOption("probe");
+    if (path.empty()) {
+        std::cerr << "probe needs a file or a directory" <<std::endl;
+        return;
+    }
+    BitmapProbe::ResultVector results = BitmapProbe::ProbeAll(std::filesystem::path(path));
+    if (results.empty()) {
+        std::cerr << "no bmp files found" <<std::endl;
+    }
+    for (const BitmapProbe::Result& result : results) {
+        BitmapProbe::Print(result, std::cout);
+    }
+}
 
+bool App::RunStreaming(const std::string& input_filename, const std::string& output_filename) {
+    std::ifstream input(input_filename, std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    if (!input.is_open() || !reader.Open(input)) {
+        std::cerr << "program cannot read the file" <<std::endl;
+        return false;
+    }
+    std::ofstream output(output_filename, std::ios_base::out | std::ios_base::binary);
+    if (!output.is_open()) {
+        std::cerr << "program cannot write the file" <<std::endl;
+        return false;
+    }
+    if (reader.HasAlpha()) {
+        std::cerr << "32-bit images are not supported in streaming mode" <<std::endl;
+        return false;
+    }
+    if (reader.IsTopDown()) {
+        std::cerr << "top-down images are not supported in streaming mode" <<std::endl;
+        return false;
+    }
+    if (!PlanPipeline(reader.GetWidth(), reader.GetHeight())) {
+        return false;
+    }
+    if (!fp_.ApplyStreaming(reader, output, cmd_parser_.HasOption("gray-output"))) {
+        std::cerr << "program cannot process the file in streaming mode" <<std::endl;
+        return false;
+    }
+    return true;
+}
+
+void App::WriteThumbnails(const std::string& output_filename) {
+    Thumbnailer::PixelArrayVector thumbnails;
+    Thumbnailer::PixelArrayVector alpha_thumbnails;
+    if (PixelArray* alpha = bmp_.GetAlpha()) {
+        // Копии с альфа-каналом уменьшаются по умноженным на альфу цветам, как фильтром -scale
+        Bitmap premultiplied = bmp_;
+        premultiplied.Premultiply();
+        thumbnails = thumbnailer_.Generate(premultiplied.GetPixels());
+        alpha_thumbnails = thumbnailer_.Generate(*alpha);
+    } else {
+        thumbnails = thumbnailer_.Generate(bmp_.GetPixels());
+    }
+    for (size_t i = 0; i < thumbnails.size(); ++i) {
+        std::string thumbnail_filename = Thumbnailer::GetThumbnailFileName(output_filename,
+                                                                           thumbnailer_.GetSizes()[i]);
+        Bitmap thumbnail = bmp_.CopyWithPixels(std::move(thumbnails[i]));
+        if (!alpha_thumbnails.empty()) {
+            thumbnail.SetAlpha(std::move(alpha_thumbnails[i]), true);
+            thumbnail.Unpremultiply();
+        }
+        if (!thumbnail.CreateFile(thumbnail_filename.c_str(), cmd_parser_.HasOption("gray-output"))) {
+            std::cerr << "program cannot write the file " << thumbnail_filename <<std::endl;
+        }
+    }
+}
+
+bool App::OpenCache(const std::string& input_filename) {
+    uint64_t max_bytes = ResultCache::DEFAULT_MAX_BYTES;
+    if (cmd_parser_.HasOption("cache-size")) {
+        try {
+            max_bytes = std::stoull(std::string(cmd_parser_.GetOption("cache-size"))) << 20;
+        } catch (std::logic_error& e) {
+            std::cerr << "wrong cache size" <<std::endl;
+            return false;
+        }
+    }
+    cache_.emplace(std::string(cmd_parser_.GetOption("cache")), max_bytes);
+    if (!cache_->Open()) {
+        std::cerr << "program cannot open the cache directory" <<std::endl;
+        return false;
+    }
+    std::ifstream input(input_filename, std::ios_base::in | std::ios_base::binary);
+    // Оптимизированная цепочка и режим повышенной точности могут отличаться от обычного в пределах округления
+    std::string settings = cmd_parser_.HasOption("no-optimize") ? "no-optimize" : "";
+    if (cmd_parser_.HasOption("precision")) {
+        settings += " precision=float";
+    }
+    if (cmd_parser_.HasOption("gray-output")) {
+        settings += " gray-output";
+    }
+    if (cmd_parser_.HasOption("approximate") && !cmd_parser_.HasOption("no-optimize")) {
+        settings += " approximate";
+    }
+    if (!input.is_open() || !ResultCache::ComputeKey(input, cmd_parser_.GetData(), settings, cache_key_)) {
+        std::cerr << "program cannot read the file" <<std::endl;
+        return false;
+    }
+    return true;
+}
+
+void App::StoreResult(const std::string& output_filename) {
+    if (!cache_) {
+        return;
+    }
+    if (!cache_->Store(cache_key_, output_filename)) {
+        std::cerr << "program cannot put the result into the cache" <<std::endl;
+    }
+    if (cmd_parser_.HasOption("cache-stats")) {
+        cache_->PrintStats(std::cerr);
+    }
 }
@@ -1,15 +1,45 @@
 #pragma once
+#include <optional>
 #include "cmd_arg_parser.h"
 #include "filter_pipeline_factory.h"
 #include "bitmap.h"
+#include "pipeline_optimizer.h"
+#include "result_cache.h"
+#include "thumbnailer.h"
 
 class App {
 public:
     void Setup();
     void Run(int argc, char* argv[]);
 protected:
+    // Переписывает цепочку фильтров под изображение размером width x height и пересоздаёт конвейер.
+    // Отключается опцией --no-optimize, приближённые переписывания включаются опцией --approximate,
+    // план печатается опцией --explain.
+    bool PlanPipeline(size_t width, size_t height);
+
+    // Построчная обработка без загрузки всего изображения в память (--stream)
+    bool RunStreaming(const std::string& input_filename, const std::string& output_filename);
+
+    // Печатает размеры и формат файлов, не декодируя их (--probe)
+    void RunProbe();
+
+    // Записывает уменьшенные копии результата рядом с выходным файлом (--thumbnails)
+    void WriteThumbnails(const std::string& output_filename);
+
+    // Открывает кэш результатов (--cache) и считает ключ для входного файла
+    bool OpenCache(const std::string& input_filename);
+
+    // Кладёт результат в кэш, если он включён
+    void StoreResult(const std::string& output_filename);
+
     CmdLineParser cmd_parser_;
+    // Цепочка фильтров из командной строки вместе с добавленными опциями, например --gray-output
+    CmdLineParser::FilterDescriptorVector fdv_;
     FilterPipelineFactory fpf_;
     FilterPipeline fp_;
     Bitmap bmp_;
+    Thumbnailer thumbnailer_;
+    PipelineOptimizer optimizer_;
+    std::optional<ResultCache> cache_;
+    uint64_t cache_key_ = 0;
 };
@@ -1 +1,39 @@
 #include "base_filter.h"
+#include "float_image.h"
+
+#include <algorithm>
+
+Region Region::Expand(size_t radius, size_t image_width, size_t image_height) const {
+    Region result;
+    result.row = row > radius ? row - radius : 0;
+    result.column = column > radius ? column - radius : 0;
+    result.height = std::min(image_height, row + height + radius) - result.row;
+    result.width = std::min(image_width, column + width + radius) - result.column;
+    return result;
+}
+
+void BaseFilter::ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t /*width*/,
+                               size_t /*height*/) {
+    Apply(image);
+    CutRegion(image.GetPixels(), Region{output.row - input.row, output.column - input.column,
+                                        output.height, output.width});
+}
+
+void BaseFilter::ApplyPreciseToRegion(FloatImage& image, const Region& input, const Region& output,
+                                      size_t /*width*/, size_t /*height*/) {
+    ApplyPrecise(image);
+    image.Cut(Region{output.row - input.row, output.column - input.column, output.height, output.width});
+}
+
+void BaseFilter::CutRegion(PixelArray& pixels, const Region& region) {
+    if (region.row == 0 && region.column == 0 && region.height == pixels.GetHeight() &&
+        region.width == pixels.GetWidth()) {
+        return;
+    }
+    PixelArray result(region.height, region.width);
+    for (size_t i = 0; i < region.height; ++i) {
+        std::copy(&pixels(region.row + i, region.column), &pixels(region.row + i, region.column) + region.width,
+                  &result(i, 0));
+    }
+    pixels = std::move(result);
+}
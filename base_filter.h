@@ -1,8 +1,72 @@
 #pragma once
+#include <optional>
+#include <utility>
 #include "bitmap.h"
 
+class StreamPipeline;
+class FloatImage;
+
+// Прямоугольная область изображения в координатах PixelArray
+struct Region {
+    size_t row = 0;
+    size_t column = 0;
+    size_t height = 0;
+    size_t width = 0;
+
+    // Область, расширенная на radius пикселей в каждую сторону и обрезанная по границам изображения
+    Region Expand(size_t radius, size_t image_width, size_t image_height) const;
+
+    bool operator==(const Region& rhv) const = default;
+};
+
 class BaseFilter {
+public:
+    using Size = std::pair<size_t, size_t>; // ширина и высота
+
 public:
     virtual ~BaseFilter() = default;
     virtual void Apply(Bitmap& image) = 0;
-};
\ No newline at end of file
+
+    // Добавляет в потоковый конвейер стадии, выполняющие этот фильтр построчно.
+    // Возвращает false, если фильтр не поддерживает потоковую обработку.
+    virtual bool AddStreamStages(StreamPipeline& /*sp*/) const { return false; }
+
+    // Размеры результата фильтра для входного изображения width x height
+    virtual Size GetOutputSize(size_t width, size_t height) const { return {width, height}; }
+
+    // Область входного изображения width x height, по которой можно посчитать область output результата.
+    // nullopt означает, что фильтру нужно всё изображение.
+    virtual std::optional<Region> GetInputRegion(const Region& /*output*/, size_t /*width*/,
+                                                 size_t /*height*/) const {
+        return std::nullopt;
+    }
+
+    // image содержит только область input входного изображения width x height, область получена
+    // из GetInputRegion(output, width, height). Применяет фильтр и оставляет в image область output результата.
+    // По умолчанию фильтр применяется к фрагменту как к целому изображению, а затем лишние края
+    // (на которых не хватило соседних пикселей) отрезаются.
+    virtual void ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                               size_t height);
+
+    // Режим повышенной точности: фильтр применяется к изображению с каналами float, не округляя их.
+    // Фильтры, не поддерживающие этот режим, получают изображение, округлённое до 8 бит.
+    virtual bool SupportsPrecise() const { return false; }
+
+    virtual void ApplyPrecise(FloatImage& /*image*/) {}
+
+    // То же, что ApplyToRegion, в режиме повышенной точности
+    virtual void ApplyPreciseToRegion(FloatImage& image, const Region& input, const Region& output, size_t width,
+                                      size_t height);
+
+    // Как фильтр обходится с альфа-каналом изображения
+    enum class AlphaMode {
+        KEEP,         // фильтр меняет только исходные цвета, альфа остаётся прежней
+        MOVE,         // фильтр переставляет пиксели, не смешивая их, и так же переставляет альфу
+        PREMULTIPLIED // фильтр линейно смешивает пиксели: применяется к умноженным на альфу цветам и к альфе
+    };
+
+    virtual AlphaMode GetAlphaMode() const { return AlphaMode::KEEP; }
+
+    // Оставляет в pixels область region
+    static void CutRegion(PixelArray& pixels, const Region& region);
+};
@@ -1,6 +1,9 @@
 #include "bitmap.h"
 
+#include <algorithm>
+#include <cstdlib>
 #include <fstream>
+#include <limits>
 
 
 PixelArray::PixelArray(const PixelArray& other) : PixelArray() {
@@ -93,58 +96,513 @@ bool Bitmap::Load(const char* file_name) {
 }
 
 bool Bitmap::Load(std::istream& stream) {
-    if (!stream) {
+    BitmapRowReader reader;
+    if (!reader.Open(stream)) {
         return false;
     }
-    stream.read(reinterpret_cast<char *> (&bmp_header_), sizeof(bmp_header_));
-    stream.read(reinterpret_cast<char *> (&dib_header_), sizeof(dib_header_));
-    if (dib_header_.bits_per_pixel != 24) {
-        return false;
+    bmp_header_ = reader.GetBMPHeader();
+    dib_header_ = reader.GetDIBHeader();
+    size_t height = reader.GetHeight();
+    size_t width = reader.GetWidth();
+    // Несколько десятков байт RLE могут объявить изображение в сотни мегабайт, поэтому для сжатых файлов
+    // строки выделяются по мере распаковки, удваиваясь. Сжатые файлы всегда записаны снизу вверх,
+    // так что уже прочитанные строки при росте остаются на своих местах.
+    size_t allocated = reader.IsCompressed() ? 1 : height;
+    pixels_.Resize(allocated, width);
+    premultiplied_ = false;
+    alpha_.reset();
+    if (reader.HasAlpha()) {
+        alpha_.emplace(allocated, width);
     }
-    pixels_.Resize(dib_header_.height, dib_header_.width);
-    size_t RUBBISH_BETWEEN_LINES = (4 - (dib_header_.width * 3) % 4) % 4;
-    for (size_t i = 0; i < dib_header_.height; ++i) {
-        for (size_t j = 0; j < dib_header_.width; ++j) {
-            if (!stream) {
-                return false;
+    bool opaque = true;
+    for (size_t k = 0; k < height; ++k) {
+        if (k == allocated) {
+            allocated = std::min(height, allocated * 2);
+            pixels_.Resize(allocated, width);
+            if (alpha_) {
+                alpha_->Resize(allocated, width);
             }
-            stream.read(reinterpret_cast<char *> (&pixels_(i, j)), sizeof(PixelArray::Pixel));
         }
-        stream.ignore(RUBBISH_BETWEEN_LINES);
+        // Строки изображения, записанного сверху вниз, сразу раскладываются на свои места
+        size_t i = reader.IsTopDown() ? height - 1 - k : k;
+        if (!reader.ReadRow(&pixels_(i, 0), alpha_ ? &(*alpha_)(i, 0) : nullptr)) {
+            return false;
+        }
+        if (alpha_) {
+            opaque = opaque && std::all_of(&(*alpha_)(i, 0), &(*alpha_)(i, 0) + width,
+                                           [](const PixelArray::Pixel& pixel) { return pixel.red == 0; });
+        }
+    }
+    // Многие программы пишут 32-битные bmp без альфы, оставляя четвёртый байт нулевым
+    if (opaque) {
+        alpha_.reset();
     }
     return true;
 }
 
-bool Bitmap::CreateFile(const char* file_name) {
+bool Bitmap::CreateFile(const char* file_name, bool gray) {
     std::ofstream file;
     file.open(file_name, std::ios_base::out | std::ios_base::binary); // Открываем файл на вписывание как бинарный
     if (!file.is_open()) {
         return false;
     }
-    CreateFile(file);
+    CreateFile(file, gray);
+    return true;
+}
+
+bool Bitmap::CreateFile(std::ofstream& stream, bool gray) {
+    BitmapRowWriter::Format format = BitmapRowWriter::Format::BGR24;
+    if (alpha_) {
+        format = BitmapRowWriter::Format::BGRA32;
+    } else if (gray) {
+        format = BitmapRowWriter::Format::GRAY8;
+    }
+    BitmapRowWriter writer;
+    if (!writer.Open(stream, bmp_header_, dib_header_, pixels_.GetWidth(), pixels_.GetHeight(), format)) {
+        return false;
+    }
+    for (size_t i = 0; i < pixels_.GetHeight(); ++i) {
+        if (!writer.WriteRow(&pixels_(i, 0), alpha_ ? &(*alpha_)(i, 0) : nullptr)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Bitmap::Premultiply() {
+    if (!alpha_ || premultiplied_) {
+        return;
+    }
+    for (size_t i = 0; i < pixels_.GetHeight(); ++i) {
+        PixelArray::Pixel* row = &pixels_(i, 0);
+        const PixelArray::Pixel* alpha = &(*alpha_)(i, 0);
+        for (size_t j = 0; j < pixels_.GetWidth(); ++j) {
+            int a = alpha[j].red;
+            row[j].red = (row[j].red * a + 127) / 255;
+            row[j].green = (row[j].green * a + 127) / 255;
+            row[j].blue = (row[j].blue * a + 127) / 255;
+        }
+    }
+    premultiplied_ = true;
+}
+
+void Bitmap::Unpremultiply() {
+    if (!alpha_ || !premultiplied_) {
+        return;
+    }
+    auto divide = [](int channel, int a) {
+        return static_cast<uint8_t>(std::min(255, (channel * 255 + a / 2) / a));
+    };
+    for (size_t i = 0; i < pixels_.GetHeight(); ++i) {
+        PixelArray::Pixel* row = &pixels_(i, 0);
+        const PixelArray::Pixel* alpha = &(*alpha_)(i, 0);
+        for (size_t j = 0; j < pixels_.GetWidth(); ++j) {
+            int a = alpha[j].red;
+            // Цвет полностью прозрачного пикселя не восстановить
+            row[j] = a == 0 ? PixelArray::Pixel{0, 0, 0}
+                            : PixelArray::Pixel{divide(row[j].red, a), divide(row[j].green, a), divide(row[j].blue, a)};
+        }
+    }
+    premultiplied_ = false;
+}
+
+Bitmap Bitmap::CopyWithPixels(PixelArray pixels) const {
+    Bitmap result;
+    result.bmp_header_ = bmp_header_;
+    result.dib_header_ = dib_header_;
+    result.pixels_ = std::move(pixels);
+    return result;
+}
+
+// -------------------------------------------------------------------------------------------------------------
+
+namespace {
+    // BITMAPCOREHEADER после поля размера
+    struct CoreHeader {
+        uint16_t width;
+        uint16_t height;
+        uint16_t planes;
+        uint16_t bits_per_pixel;
+    } __attribute__((__packed__));
+
+    // Размер BITMAPV5HEADER; более длинных заголовков не бывает
+    const uint32_t MAX_DIB_HEADER_SIZE = 124;
+
+    // Размер оставшейся части потока, если поток позволяет его узнать
+    std::optional<uint64_t> GetRemainingSize(std::istream& stream) {
+        std::istream::pos_type position = stream.tellg();
+        if (position == std::istream::pos_type(-1)) {
+            return std::nullopt;
+        }
+        stream.seekg(0, std::ios_base::end);
+        std::istream::pos_type end = stream.tellg();
+        stream.clear();
+        stream.seekg(position);
+        if (end == std::istream::pos_type(-1) || !stream) {
+            stream.clear();
+            return std::nullopt;
+        }
+        return static_cast<uint64_t>(end - position);
+    }
+
+    // Маски каналов BI_BITFIELDS, при которых пиксель лежит в файле как у 24-битного bmp с альфой в конце
+    const uint32_t CHANNEL_MASKS[] = {0x00FF0000, 0x0000FF00, 0x000000FF};
+
+    // Байт на пиксель для BitmapRowWriter::Format
+    const size_t PIXEL_SIZES[] = {3, 4, 1};
+
+    // Палитра из 256 оттенков серого
+    const std::array<uint8_t, 1024> GRAY_PALETTE = [] {
+        std::array<uint8_t, 1024> palette{};
+        for (size_t i = 0; i < 256; ++i) {
+            palette[4 * i] = palette[4 * i + 1] = palette[4 * i + 2] = static_cast<uint8_t>(i);
+        }
+        return palette;
+    }();
+}
+
+bool BitmapRowReader::Open(std::istream& stream) {
+    stream_ = nullptr;
+    if (!stream || !ReadHeaders(stream)) {
+        return false;
+    }
+    // Данные должны помещаться в поток; для сжатых известен только их заявленный размер
+    if (stream_size_ && GetRequiredSize() > *stream_size_) {
+        return false;
+    }
+    rle_skipped_rows_ = 0;
+    rle_column_ = 0;
+    rle_finished_ = false;
+    if (IsPalettized() && !ReadPalette(stream)) {
+        return false;
+    }
+    // Между заголовками и пикселями может быть продолжение заголовка новых версий
+    if (bmp_header_.bitarray_offset < headers_size_) {
+        return false;
+    }
+    stream.ignore(bmp_header_.bitarray_offset - headers_size_);
+    if (!stream) {
+        return false;
+    }
+    stream_ = &stream;
     return true;
 }
 
-bool Bitmap::CreateFile(std::ofstream& stream) {
+bool BitmapRowReader::Probe(std::istream& stream) {
+    stream_ = nullptr;
+    return stream && ReadHeaders(stream);
+}
+
+bool BitmapRowReader::ReadHeaders(std::istream& stream) {
+    stream_size_ = GetRemainingSize(stream);
+    stream.read(reinterpret_cast<char *> (&bmp_header_), sizeof(bmp_header_));
+    uint32_t dib_header_size = 0;
+    stream.read(reinterpret_cast<char *> (&dib_header_size), sizeof(dib_header_size));
+    if (!stream || bmp_header_.signature != Bitmap::SIGNATURE) {
+        return false;
+    }
+    dib_header_ = Bitmap::DIBHeader{};
+    dib_header_.dib_header_size = dib_header_size;
+    headers_size_ = sizeof(bmp_header_) + sizeof(dib_header_size);
+    palette_entry_size_ = 4;
+    if (dib_header_size == sizeof(dib_header_size) + sizeof(CoreHeader)) {
+        CoreHeader core;
+        stream.read(reinterpret_cast<char *> (&core), sizeof(core));
+        headers_size_ += sizeof(core);
+        dib_header_.width = core.width;
+        dib_header_.height = core.height;
+        dib_header_.planes = core.planes;
+        dib_header_.bits_per_pixel = core.bits_per_pixel;
+        dib_header_.compression = Bitmap::BI_RGB;
+        palette_entry_size_ = 3;
+    } else if (dib_header_size >= sizeof(dib_header_) && dib_header_size <= MAX_DIB_HEADER_SIZE) {
+        stream.read(reinterpret_cast<char *> (&dib_header_) + sizeof(dib_header_size),
+                    sizeof(dib_header_) - sizeof(dib_header_size));
+        headers_size_ += sizeof(dib_header_) - sizeof(dib_header_size);
+    } else {
+        return false;
+    }
     if (!stream) {
         return false;
     }
-    dib_header_.width = pixels_.GetWidth();
-    dib_header_.height = pixels_.GetHeight();
-    size_t RUBBISH_BETWEEN_LINES = (4 - (dib_header_.width * 3) % 4) % 4;
-    dib_header_.raw_bitmap_data_size = dib_header_.height * (dib_header_.width * 3 + RUBBISH_BETWEEN_LINES);
-    bmp_header_.file_size = bmp_header_.bitarray_offset + dib_header_.raw_bitmap_data_size;
-    stream.write(reinterpret_cast<char*> (&bmp_header_), sizeof(bmp_header_));
-    stream.write(reinterpret_cast<char*> (&dib_header_), sizeof(dib_header_));
-    static int RUBBISH = 0x42424242;
-    for (size_t i = 0; i < dib_header_.height; ++i) {
-        for (size_t j = 0; j < dib_header_.width; ++j) {
-            if (!stream) {
+    uint16_t bits_per_pixel = dib_header_.bits_per_pixel;
+    uint32_t compression = dib_header_.compression;
+    if (bits_per_pixel == 32 && compression == Bitmap::BI_BITFIELDS) {
+        // Маски лежат сразу после 40 байт заголовка: отдельно или в заголовке более новой версии
+        uint32_t masks[std::size(CHANNEL_MASKS)];
+        stream.read(reinterpret_cast<char *> (masks), sizeof(masks));
+        if (!stream || !std::equal(masks, masks + std::size(masks), CHANNEL_MASKS)) {
+            return false;
+        }
+        headers_size_ += sizeof(masks);
+    }
+    bool compressed = compression == Bitmap::BI_RLE8 || compression == Bitmap::BI_RLE4;
+    bool supported = (bits_per_pixel == 24 && compression == Bitmap::BI_RGB) ||
+                     (bits_per_pixel == 32 && (compression == Bitmap::BI_RGB ||
+                                               compression == Bitmap::BI_BITFIELDS)) ||
+                     ((bits_per_pixel == 1 || bits_per_pixel == 4 || bits_per_pixel == 8) &&
+                      compression == Bitmap::BI_RGB) ||
+                     (bits_per_pixel == 8 && compression == Bitmap::BI_RLE8) ||
+                     (bits_per_pixel == 4 && compression == Bitmap::BI_RLE4);
+    // Сжатые изображения хранятся только снизу вверх
+    if (!supported || dib_header_.width < 0 || dib_header_.height == std::numeric_limits<int32_t>::min() ||
+        (compressed && dib_header_.height < 0)) {
+        return false;
+    }
+    width_ = static_cast<size_t>(dib_header_.width);
+    height_ = static_cast<size_t>(std::abs(dib_header_.height));
+    if (static_cast<uint64_t>(width_) * height_ > MAX_PIXELS) {
+        return false;
+    }
+    // Продолжение заголовка версий 4 и 5 пропускается, за ним начинается палитра
+    if (IsPalettized()) {
+        stream.ignore(dib_header_size - (headers_size_ - sizeof(bmp_header_)));
+        headers_size_ = sizeof(bmp_header_) + dib_header_size;
+        size_t colors = dib_header_.colors_used ? dib_header_.colors_used : size_t{1} << bits_per_pixel;
+        if (colors > (size_t{1} << bits_per_pixel)) {
+            return false;
+        }
+        headers_size_ += palette_entry_size_ * colors;
+    }
+    if (!stream || bmp_header_.bitarray_offset < headers_size_) {
+        return false;
+    }
+    uint64_t row_size = (static_cast<uint64_t>(width_) * bits_per_pixel + 31) / 32 * 4;
+    data_size_ = compressed ? dib_header_.raw_bitmap_data_size : row_size * height_;
+    padding_ = row_size - width_ * (bits_per_pixel / 8);
+    if (IsPalettized()) {
+        padding_ = 0;
+        indices_.resize(compressed ? width_ : 0);
+    }
+    return true;
+}
+
+bool BitmapRowReader::ReadPalette(std::istream& stream) {
+    size_t bits_per_pixel = dib_header_.bits_per_pixel;
+    size_t colors = dib_header_.colors_used ? dib_header_.colors_used : size_t{1} << bits_per_pixel;
+    // Цвета палитры записаны как синий, зелёный, красный и, кроме BITMAPCOREHEADER, неиспользуемый байт,
+    // то есть в порядке пикселя 24-битного файла
+    uint8_t entries[256 * 4];
+    stream.read(reinterpret_cast<char *> (entries), static_cast<std::streamsize>(palette_entry_size_ * colors));
+    if (!stream) {
+        return false;
+    }
+    palette_.fill(PixelArray::Pixel{0, 0, 0});
+    for (size_t i = 0; i < colors; ++i) {
+        const uint8_t* entry = &entries[palette_entry_size_ * i];
+        palette_[i] = PixelArray::Pixel{entry[0], entry[1], entry[2]};
+    }
+    // Старшие биты байта соответствуют левому пикселю
+    size_t pixels_per_byte = 8 / bits_per_pixel;
+    uint8_t mask = (1u << bits_per_pixel) - 1;
+    expansion_.resize(256 * pixels_per_byte);
+    for (size_t value = 0; value < 256; ++value) {
+        for (size_t k = 0; k < pixels_per_byte; ++k) {
+            size_t shift = 8 - bits_per_pixel * (k + 1);
+            expansion_[value * pixels_per_byte + k] = palette_[(value >> shift) & mask];
+        }
+    }
+    return true;
+}
+
+bool BitmapRowReader::ReadRow(PixelArray::Pixel* row, PixelArray::Pixel* alpha) {
+    if (!stream_ || !*stream_) {
+        return false;
+    }
+    if (IsPalettized()) {
+        return ReadPalettizedRow(row);
+    }
+    if (!HasAlpha()) {
+        stream_->read(reinterpret_cast<char *> (row), width_ * sizeof(PixelArray::Pixel));
+        if (!*stream_) {
+            return false;
+        }
+        stream_->ignore(padding_);
+        return true;
+    }
+    buffer_.resize(width_ * 4);
+    stream_->read(reinterpret_cast<char *> (buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+    if (!*stream_) {
+        return false;
+    }
+    for (size_t j = 0; j < width_; ++j) {
+        const uint8_t* pixel = &buffer_[4 * j];
+        row[j] = PixelArray::Pixel{pixel[0], pixel[1], pixel[2]};
+        if (alpha) {
+            alpha[j] = PixelArray::Pixel{pixel[3], pixel[3], pixel[3]};
+        }
+    }
+    return true;
+}
+
+bool BitmapRowReader::ReadPalettizedRow(PixelArray::Pixel* row) {
+    size_t width = width_;
+    if (dib_header_.compression != Bitmap::BI_RGB) {
+        if (!DecodeRLERow()) {
+            return false;
+        }
+        for (size_t j = 0; j < width; ++j) {
+            row[j] = palette_[indices_[j]];
+        }
+        return true;
+    }
+    size_t bits_per_pixel = dib_header_.bits_per_pixel;
+    size_t pixels_per_byte = 8 / bits_per_pixel;
+    size_t row_size = (width * bits_per_pixel + 31) / 32 * 4;
+    buffer_.resize(row_size);
+    stream_->read(reinterpret_cast<char *> (buffer_.data()), static_cast<std::streamsize>(row_size));
+    if (!*stream_) {
+        return false;
+    }
+    if (bits_per_pixel == 8) {
+        for (size_t j = 0; j < width; ++j) {
+            row[j] = palette_[buffer_[j]];
+        }
+        return true;
+    }
+    // Каждый байт, кроме, может быть, последнего, целиком превращается в пиксели из таблицы
+    size_t full_bytes = width / pixels_per_byte;
+    for (size_t k = 0; k < full_bytes; ++k) {
+        const PixelArray::Pixel* pixels = &expansion_[buffer_[k] * pixels_per_byte];
+        std::copy(pixels, pixels + pixels_per_byte, row + k * pixels_per_byte);
+    }
+    size_t rest = width - full_bytes * pixels_per_byte;
+    if (rest > 0) {
+        const PixelArray::Pixel* pixels = &expansion_[buffer_[full_bytes] * pixels_per_byte];
+        std::copy(pixels, pixels + rest, row + full_bytes * pixels_per_byte);
+    }
+    return true;
+}
+
+bool BitmapRowReader::DecodeRLERow() {
+    // Пиксели, пропущенные командами смещения, получают нулевой индекс
+    std::fill(indices_.begin(), indices_.end(), 0);
+    if (rle_finished_) {
+        return true;
+    }
+    if (rle_skipped_rows_ > 0) {
+        --rle_skipped_rows_;
+        return true;
+    }
+    bool rle4 = dib_header_.compression == Bitmap::BI_RLE4;
+    size_t width = indices_.size();
+    size_t column = rle_column_;
+    rle_column_ = 0;
+    auto put = [this, width, &column](uint8_t index) {
+        // Лишние пиксели за правым краем отбрасываются
+        if (column < width) {
+            indices_[column] = index;
+        }
+        ++column;
+    };
+    uint8_t command[2];
+    while (true) {
+        stream_->read(reinterpret_cast<char *> (command), sizeof(command));
+        if (!*stream_) {
+            return false;
+        }
+        if (command[0] > 0) {
+            // Повторение: command[0] пикселей, для RLE4 два индекса из command[1] чередуются
+            for (size_t k = 0; k < command[0]; ++k) {
+                put(rle4 ? (k % 2 == 0 ? command[1] >> 4 : command[1] & 0x0F) : command[1]);
+            }
+            continue;
+        }
+        if (command[1] == 0) {
+            // Конец строки
+            return true;
+        }
+        if (command[1] == 1) {
+            // Конец изображения, оставшиеся строки пустые
+            rle_finished_ = true;
+            return true;
+        }
+        if (command[1] == 2) {
+            // Смещение на delta[0] столбцов вправо и delta[1] строк вверх
+            uint8_t delta[2];
+            stream_->read(reinterpret_cast<char *> (delta), sizeof(delta));
+            if (!*stream_) {
                 return false;
             }
-            stream.write(reinterpret_cast<char*> (&pixels_(i, j)), sizeof(PixelArray::Pixel));
+            column += delta[0];
+            if (delta[1] > 0) {
+                rle_skipped_rows_ = delta[1] - 1;
+                rle_column_ = column;
+                return true;
+            }
+            continue;
+        }
+        // Неупакованный участок из command[1] пикселей, выровненный до 2 байт
+        size_t count = command[1];
+        size_t bytes = rle4 ? (count + 1) / 2 : count;
+        buffer_.resize(bytes + bytes % 2);
+        stream_->read(reinterpret_cast<char *> (buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+        if (!*stream_) {
+            return false;
+        }
+        for (size_t k = 0; k < count; ++k) {
+            put(rle4 ? (k % 2 == 0 ? buffer_[k / 2] >> 4 : buffer_[k / 2] & 0x0F) : buffer_[k]);
         }
-        stream.write(reinterpret_cast<char*> (&RUBBISH), RUBBISH_BETWEEN_LINES);
     }
-    return true;
-}
\ No newline at end of file
+}
+
+bool BitmapRowWriter::Open(std::ostream& stream, Bitmap::BMPHeader bmp_header, Bitmap::DIBHeader dib_header,
+                           size_t width, size_t height, Format format) {
+    if (!stream) {
+        return false;
+    }
+    width_ = width;
+    format_ = format;
+    size_t pixel_size = PIXEL_SIZES[static_cast<size_t>(format)];
+    padding_ = (4 - (width * pixel_size) % 4) % 4;
+    // Заголовок всегда пишется в 40-байтной версии снизу вверх, за ним палитра и пиксели
+    bmp_header.signature = Bitmap::SIGNATURE;
+    bmp_header.reserved = 0;
+    dib_header.planes = 1;
+    size_t palette_size = format == Format::GRAY8 ? sizeof(GRAY_PALETTE) : 0;
+    bmp_header.bitarray_offset = sizeof(bmp_header) + sizeof(dib_header) + palette_size;
+    dib_header.dib_header_size = sizeof(dib_header);
+    dib_header.bits_per_pixel = 8 * pixel_size;
+    dib_header.compression = Bitmap::BI_RGB;
+    dib_header.colors_used = format == Format::GRAY8 ? 256 : 0;
+    dib_header.important_colors = 0;
+    dib_header.width = width;
+    dib_header.height = height;
+    dib_header.raw_bitmap_data_size = height * (width * pixel_size + padding_);
+    bmp_header.file_size = bmp_header.bitarray_offset + dib_header.raw_bitmap_data_size;
+    stream.write(reinterpret_cast<char*> (&bmp_header), sizeof(bmp_header));
+    stream.write(reinterpret_cast<char*> (&dib_header), sizeof(dib_header));
+    stream.write(reinterpret_cast<const char*> (GRAY_PALETTE.data()), static_cast<std::streamsize>(palette_size));
+    stream_ = &stream;
+    return static_cast<bool>(stream);
+}
+
+bool BitmapRowWriter::WriteRow(const PixelArray::Pixel* row, const PixelArray::Pixel* alpha) {
+    static int RUBBISH = 0x42424242;
+    if (!stream_ || !*stream_) {
+        return false;
+    }
+    if (format_ == Format::GRAY8) {
+        buffer_.resize(width_ + padding_);
+        for (size_t j = 0; j < width_; ++j) {
+            buffer_[j] = row[j].red;
+        }
+        stream_->write(reinterpret_cast<const char*> (buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+        return static_cast<bool>(*stream_);
+    }
+    if (format_ == Format::BGRA32) {
+        buffer_.resize(width_ * 4);
+        for (size_t j = 0; j < width_; ++j) {
+            uint8_t* pixel = &buffer_[4 * j];
+            pixel[0] = row[j].red;
+            pixel[1] = row[j].green;
+            pixel[2] = row[j].blue;
+            pixel[3] = alpha[j].red;
+        }
+        stream_->write(reinterpret_cast<const char*> (buffer_.data()), static_cast<std::streamsize>(buffer_.size()));
+        return static_cast<bool>(*stream_);
+    }
+    stream_->write(reinterpret_cast<const char*> (row), width_ * sizeof(PixelArray::Pixel));
+    stream_->write(reinterpret_cast<char*> (&RUBBISH), padding_);
+    return static_cast<bool>(*stream_);
+}
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <iostream>
+#include <optional>
 #include <tuple>
+#include <vector>
 
 
 class PixelArray {
@@ -43,6 +46,11 @@ public:
 
     PixelArray& operator=(const PixelArray& rhv);
 
+    PixelArray& operator=(PixelArray&& rhv) noexcept {
+        Swap(rhv);
+        return *this;
+    }
+
     void Resize(size_t height, size_t width, Pixel default_pixel = Pixel());
 
     size_t GetHeight() const{
@@ -104,24 +112,37 @@ protected:
 class Bitmap {
 public:
     struct BMPHeader {
-        uint16_t signature;
+        uint16_t signature; // "BM"
         uint32_t file_size;
-        uint32_t dummy;
+        uint32_t reserved;
         uint32_t bitarray_offset;
     } __attribute__((__packed__));
 
+    // Заголовок BITMAPINFOHEADER. Заголовки других версий при чтении приводятся к нему: у старого
+    // 12-байтного BITMAPCOREHEADER поля короче, а версии 4 и 5 продолжают его масками каналов,
+    // цветовым пространством и прочим, что не используется.
     struct DIBHeader {
         uint32_t dib_header_size;
-        uint32_t width;  // Ширина
-        uint32_t height; // Высота
-        uint16_t dummy1; // Это же на не нужно?
+        int32_t width;  // Ширина
+        int32_t height; // Высота; отрицательная, если строки записаны сверху вниз
+        uint16_t planes;
         uint16_t bits_per_pixel;
-        uint32_t dummy2; // Это же нам не нужно?
-        uint32_t raw_bitmap_data_size;  // (including padding)
-        uint64_t dummy3; // Это же нам не нужно?
-        uint64_t dummy4; // Это же нам не нужно?
+        uint32_t compression;
+        uint32_t raw_bitmap_data_size;  // (including padding), для BI_RGB может быть 0
+        int32_t horizontal_resolution;  // пикселей на метр
+        int32_t vertical_resolution;
+        uint32_t colors_used; // Число цветов палитры, 0 -- 2 в степени bits_per_pixel
+        uint32_t important_colors;
     } __attribute__((__packed__));
 
+    static const uint16_t SIGNATURE = 0x4D42;
+
+    // Значения DIBHeader::compression
+    static const uint32_t BI_RGB = 0;
+    static const uint32_t BI_RLE8 = 1;       // 8 бит на пиксель, строки сжаты RLE
+    static const uint32_t BI_RLE4 = 2;       // 4 бита на пиксель, строки сжаты RLE
+    static const uint32_t BI_BITFIELDS = 3;  // только 32 бита на пиксель с обычными масками каналов
+
 public:
     // Загружает файл из переданного потока чтения (функция под этой как раз возвращает поток)
     bool Load(std::istream& stream);
@@ -130,18 +151,147 @@ public:
     bool Load(const char* file_name);
 
     // Создаёт по имени файла bmp файл и загружает туда что-то.
-    bool CreateFile(const char* file_name);
+    bool CreateFile(const char* file_name, bool gray = false);
 
     // Мы можем не иметь права записывать что-то на диск или не иметь какой-то папки
     // поэтому делим create file в виде двух функций, по аналогии с load.
-    bool CreateFile(std::ofstream& stream);
+    // Изображение с альфой записывается 32-битным, остальные -- 24-битными, а при gray -- 8-битными с серой
+    // палитрой. В 8-битный файл пишется канал red, так что изображение должно быть серым.
+    bool CreateFile(std::ofstream& stream, bool gray = false);
 
     PixelArray& GetPixels() {return pixels_;}
 
+    // Альфа-канал 32-битного bmp: прозрачность пикселя записана во все три канала, поэтому к альфе
+    // применимы те же фильтры, что и к цветам. nullptr, если альфа-канала нет.
+    PixelArray* GetAlpha() { return alpha_ ? &*alpha_ : nullptr; }
+
+    // alpha того же размера, что и пиксели; premultiplied -- цвета уже умножены на альфу
+    void SetAlpha(std::optional<PixelArray> alpha, bool premultiplied = false) {
+        alpha_ = std::move(alpha);
+        premultiplied_ = alpha_ && premultiplied;
+    }
+
+    // Умножает цвета на альфу (premultiplied alpha) или возвращает исходные цвета. Размытие и масштабирование
+    // умноженных цветов не подмешивают цвет прозрачных пикселей к соседним. Повторный вызов ничего не делает.
+    void Premultiply();
+
+    void Unpremultiply();
+
+    // Возвращает bmp с такими же заголовками, но другими пикселями (например, уменьшенную копию) без альфы
+    Bitmap CopyWithPixels(PixelArray pixels) const;
+
 protected:
     BMPHeader bmp_header_;
     DIBHeader dib_header_;
     PixelArray pixels_;
+    std::optional<PixelArray> alpha_;
+    bool premultiplied_ = false;
+};
+
+// Построчное чтение bmp файла. Строки отдаются в порядке хранения в файле (снизу вверх),
+// поэтому в памяти никогда не держится больше одной строки. Поддерживаются 24 и 32 бита на пиксель
+// без сжатия, а также 1, 4 и 8 бит на пиксель с палитрой, в том числе сжатые BI_RLE4 и BI_RLE8.
+class BitmapRowReader {
+public:
+    // Наибольшее число пикселей изображения. Для несжатых файлов размер данных ещё и сверяется с размером
+    // потока, а сжатые RLE маленькие файлы могут описывать большие изображения.
+    static const uint64_t MAX_PIXELS = uint64_t{1} << 28;
+
+public:
+    // Читает заголовки и палитру и проверяет, что формат поддерживается, а размеры согласованы между собой
+    // и с размером потока, ещё до чтения пикселей
+    bool Open(std::istream& stream);
+
+    // Читает только заголовки, не проверяя, что данные помещаются в поток, и не готовясь читать строки.
+    // Подходит для быстрого получения размеров и формата.
+    bool Probe(std::istream& stream);
+
+    // Читает очередную строку в row (width пикселей), а для 32-битного файла альфу -- в alpha, если он не nullptr
+    bool ReadRow(PixelArray::Pixel* row, PixelArray::Pixel* alpha = nullptr);
+
+    size_t GetWidth() const { return width_; }
+
+    size_t GetHeight() const { return height_; }
+
+    bool HasAlpha() const { return dib_header_.bits_per_pixel == 32; }
+
+    // Данные сжаты RLE, и их размер не ограничивает размеры изображения
+    bool IsCompressed() const {
+        return dib_header_.compression == Bitmap::BI_RLE8 || dib_header_.compression == Bitmap::BI_RLE4;
+    }
+
+    // Строки записаны сверху вниз, и ReadRow возвращает сначала верхнюю
+    bool IsTopDown() const { return dib_header_.height < 0; }
+
+    // Размер потока от начала файла, если поток позволяет его узнать
+    std::optional<uint64_t> GetStreamSize() const { return stream_size_; }
+
+    // Сколько байт должно быть в файле по заголовкам: смещение пикселей и размер данных
+    uint64_t GetRequiredSize() const { return bmp_header_.bitarray_offset + data_size_; }
+
+    const Bitmap::BMPHeader& GetBMPHeader() const { return bmp_header_; }
+
+    const Bitmap::DIBHeader& GetDIBHeader() const { return dib_header_; }
+
+protected:
+    bool IsPalettized() const { return dib_header_.bits_per_pixel <= 8; }
+
+    // Читает заголовок любой версии в dib_header_ и проверяет его
+    bool ReadHeaders(std::istream& stream);
+
+    // Читает палитру и строит таблицу, по которой байт строки сразу превращается в 8 / bits_per_pixel пикселей
+    bool ReadPalette(std::istream& stream);
+
+    bool ReadPalettizedRow(PixelArray::Pixel* row);
+
+    // Распаковывает очередную строку RLE в indices_
+    bool DecodeRLERow();
+
+protected:
+    std::istream* stream_ = nullptr;
+    Bitmap::BMPHeader bmp_header_;
+    Bitmap::DIBHeader dib_header_;
+    size_t width_ = 0;
+    size_t height_ = 0;
+    size_t headers_size_ = 0;       // прочитано байт от начала файла
+    uint64_t data_size_ = 0;
+    std::optional<uint64_t> stream_size_;
+    size_t palette_entry_size_ = 4; // у BITMAPCOREHEADER цвета палитры занимают 3 байта
+    size_t padding_ = 0;
+    std::vector<uint8_t> buffer_; // строка 32-битного файла или файла с палитрой
+    std::array<PixelArray::Pixel, 256> palette_{}; // индексы за пределами палитры дают чёрный цвет
+    std::vector<PixelArray::Pixel> expansion_;      // пиксели для каждого значения байта строки подряд
+    // Состояние распаковки RLE: индексы строки, число пропущенных командой смещения строк,
+    // столбец, с которого продолжается следующая строка, и признак конца изображения
+    std::vector<uint8_t> indices_;
+    size_t rle_skipped_rows_ = 0;
+    size_t rle_column_ = 0;
+    bool rle_finished_ = false;
+};
+
+// Построчная запись bmp файла. Размеры изображения должны быть известны заранее.
+class BitmapRowWriter {
+public:
+    enum class Format {
+        BGR24,  // 24 бита на пиксель
+        BGRA32, // 32 бита на пиксель с альфой
+        GRAY8   // 8 бит на пиксель с серой палитрой, пишется канал red
+    };
+
+public:
+    // Записывает заголовки, взяв за основу переданные (как Bitmap::CreateFile берёт загруженные)
+    bool Open(std::ostream& stream, Bitmap::BMPHeader bmp_header, Bitmap::DIBHeader dib_header,
+              size_t width, size_t height, Format format = Format::BGR24);
+
+    // alpha обязательна для формата BGRA32
+    bool WriteRow(const PixelArray::Pixel* row, const PixelArray::Pixel* alpha = nullptr);
+
+protected:
+    std::ostream* stream_ = nullptr;
+    size_t width_ = 0;
+    size_t padding_ = 0;
+    Format format_ = Format::BGR24;
+    std::vector<uint8_t> buffer_;
 };
 
 
@@ -0,0 +1,99 @@
+#include "bitmap_probe.h"
+#include "bitmap.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace BitmapProbe {
+    Result ProbeFile(const std::filesystem::path& path) {
+        Result result;
+        result.path = path;
+        std::ifstream input(path, std::ios_base::in | std::ios_base::binary);
+        BitmapRowReader reader;
+        if (!input.is_open() || !reader.Probe(input)) {
+            return result;
+        }
+        result.valid = true;
+        result.width = reader.GetWidth();
+        result.height = reader.GetHeight();
+        result.bits_per_pixel = reader.GetDIBHeader().bits_per_pixel;
+        result.compression = reader.GetDIBHeader().compression;
+        result.top_down = reader.IsTopDown();
+        result.file_size = reader.GetStreamSize().value_or(0);
+        result.required_size = reader.GetRequiredSize();
+        return result;
+    }
+
+    std::vector<std::filesystem::path> FindFiles(const std::filesystem::path& path) {
+        std::error_code error;
+        if (!std::filesystem::is_directory(path, error)) {
+            return {path};
+        }
+        std::vector<std::filesystem::path> files;
+        std::vector<std::filesystem::path> level = {path};
+        while (!level.empty()) {
+            // Каждый каталог уровня пишет найденное в свои векторы, так что потокам не нужна синхронизация
+            std::vector<std::vector<std::filesystem::path>> level_files(level.size());
+            std::vector<std::vector<std::filesystem::path>> level_directories(level.size());
+            Parallel::ForBands(0, level.size(), [&](size_t band_begin, size_t band_end) {
+                for (size_t i = band_begin; i < band_end; ++i) {
+                    std::error_code iteration_error;
+                    for (std::filesystem::directory_iterator it(level[i], iteration_error), end;
+                         !iteration_error && it != end; it.increment(iteration_error)) {
+                        std::error_code entry_error;
+                        // Ссылки на каталоги не обходятся, как и в recursive_directory_iterator по умолчанию:
+                        // ссылка на родительский каталог иначе зациклила бы обход
+                        bool symlink = it->is_symlink(entry_error);
+                        if (!symlink && it->is_directory(entry_error)) {
+                            level_directories[i].push_back(it->path());
+                        } else if (it->path().extension() == ".bmp" && it->is_regular_file(entry_error)) {
+                            level_files[i].push_back(it->path());
+                        }
+                    }
+                }
+            });
+            level.clear();
+            for (size_t i = 0; i < level_files.size(); ++i) {
+                files.insert(files.end(), level_files[i].begin(), level_files[i].end());
+                level.insert(level.end(), level_directories[i].begin(), level_directories[i].end());
+            }
+        }
+        std::sort(files.begin(), files.end());
+        return files;
+    }
+
+    ResultVector ProbeAll(const std::filesystem::path& path) {
+        std::vector<std::filesystem::path> files = FindFiles(path);
+        ResultVector results(files.size());
+        Parallel::ForBands(0, files.size(), [&](size_t band_begin, size_t band_end) {
+            for (size_t i = band_begin; i < band_end; ++i) {
+                results[i] = ProbeFile(files[i]);
+            }
+        });
+        return results;
+    }
+
+    void Print(const Result& result, std::ostream& stream) {
+        stream << result.path.string() << ": ";
+        if (!result.valid) {
+            stream << "not a supported bmp file" << std::endl;
+            return;
+        }
+        stream << result.width << "x" << result.height << ", " << result.bits_per_pixel << " bpp";
+        if (result.compression == Bitmap::BI_RLE8) {
+            stream << " RLE8";
+        } else if (result.compression == Bitmap::BI_RLE4) {
+            stream << " RLE4";
+        }
+        if (result.top_down) {
+            stream << ", top-down";
+        }
+        if (result.IsComplete()) {
+            stream << ", file size ok" << std::endl;
+        } else {
+            stream << ", file is truncated: " << result.file_size << " of " << result.required_size << " bytes"
+                   << std::endl;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+// Быстрое получение размеров и формата bmp файлов без декодирования пикселей (--probe). Из каждого
+// файла читаются только заголовки (не больше полутора сотен байт), а размер файла сверяется с размером,
+// который следует из заголовков. Каталоги обходятся по уровням: подкаталоги одного уровня читаются
+// параллельно, затем параллельно читаются заголовки всех найденных файлов.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <vector>
+
+namespace BitmapProbe {
+    struct Result {
+        std::filesystem::path path;
+        bool valid = false; // заголовки прочитаны, и формат поддерживается
+        size_t width = 0;
+        size_t height = 0;
+        uint16_t bits_per_pixel = 0;
+        uint32_t compression = 0;
+        bool top_down = false;
+        uint64_t file_size = 0;
+        uint64_t required_size = 0; // размер файла по заголовкам
+
+        bool IsComplete() const { return file_size >= required_size; }
+    };
+    using ResultVector = std::vector<Result>;
+
+    Result ProbeFile(const std::filesystem::path& path);
+
+    // Файл path или все файлы .bmp в каталоге path и его подкаталогах, упорядоченные по пути
+    std::vector<std::filesystem::path> FindFiles(const std::filesystem::path& path);
+
+    // Результаты для всех файлов из FindFiles(path) в том же порядке
+    ResultVector ProbeAll(const std::filesystem::path& path);
+
+    // Строка вида "a.bmp: 640x480, 24 bpp, file size ok"
+    void Print(const Result& result, std::ostream& stream);
+}
@@ -0,0 +1,39 @@
+#include "border.h"
+
+#include <algorithm>
+
+namespace Border {
+    int64_t Resolve(int64_t index, int64_t size, BorderMode mode) {
+        if (index >= 0 && index < size) {
+            return index;
+        }
+        switch (mode) {
+            case BorderMode::CLAMP:
+                return std::clamp<int64_t>(index, 0, size - 1);
+            case BorderMode::REFLECT: {
+                if (size == 1) {
+                    return 0;
+                }
+                // Отражения повторяются с периодом 2 * (size - 1)
+                int64_t period = 2 * (size - 1);
+                int64_t position = std::abs(index) % period;
+                return position < size ? position : period - position;
+            }
+            case BorderMode::WRAP:
+                return (index % size + size) % size;
+            case BorderMode::CONSTANT:
+                return -1;
+        }
+        return -1;
+    }
+
+    const PixelArray::Pixel* GetRow(const PixelArray& pixels, int64_t row, BorderMode mode,
+                                    std::vector<PixelArray::Pixel>& black_row) {
+        int64_t source = Resolve(row, static_cast<int64_t>(pixels.GetHeight()), mode);
+        if (source >= 0) {
+            return &pixels(source, 0);
+        }
+        black_row.resize(pixels.GetWidth());
+        return black_row.data();
+    }
+}
@@ -0,0 +1,48 @@
+// Обработка краёв изображения для фильтров-свёрток. Пиксель внутренней области, вся окрестность
+// которого лежит в изображении, считается без проверок. Для рамки шириной в радиус ядра строки
+// и столбцы за краем один раз на строку заменяются по выбранному правилу: указатели на строки
+// выбираются заранее, а строка дополняется полями нужной ширины, после чего ядро применяется
+// к дополненной строке так же без проверок.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "bitmap.h"
+
+enum class BorderMode {
+    CLAMP,   // повторяется крайний пиксель: a a | a b c
+    REFLECT, // зеркальное отражение относительно крайнего пикселя: c b | a b c
+    WRAP,    // изображение повторяется периодически: b c | a b c
+    CONSTANT // за краем чёрный цвет
+};
+
+namespace Border {
+    // Индекс пикселя изображения размером size, заменяющего пиксель index, или -1 для чёрного цвета
+    int64_t Resolve(int64_t index, int64_t size, BorderMode mode);
+
+    // Записывает в out пиксели строки row шириной width со столбцами begin ... end - 1, столбцы за краем
+    // заменяются по правилу mode. Pixel{} -- чёрный цвет.
+    template <typename Pixel>
+    void PadRow(const Pixel* row, int64_t width, int64_t begin, int64_t end, BorderMode mode, Pixel* out) {
+        int64_t inner_begin = std::clamp<int64_t>(begin, 0, width);
+        int64_t inner_end = std::clamp<int64_t>(end, inner_begin, width);
+        auto pad = [row, width, mode, begin, out](int64_t column) {
+            int64_t source = Resolve(column, width, mode);
+            out[column - begin] = source >= 0 ? row[source] : Pixel{};
+        };
+        for (int64_t j = begin; j < std::min(inner_begin, end); ++j) {
+            pad(j);
+        }
+        std::copy(row + inner_begin, row + inner_end, out + (inner_begin - begin));
+        for (int64_t j = std::max(inner_end, begin); j < end; ++j) {
+            pad(j);
+        }
+    }
+
+    // Строка row изображения pixels, строки за краем заменяются по правилу mode. Для CONSTANT за краем
+    // возвращается чёрная строка из black_row, которая заполняется при первой надобности.
+    const PixelArray::Pixel* GetRow(const PixelArray& pixels, int64_t row, BorderMode mode,
+                                    std::vector<PixelArray::Pixel>& black_row);
+}
@@ -1,9 +1,17 @@
 #include "cmd_arg_parser.h"
 
+#include <cctype>
+
 const char* CmdLineParser::MANUAL = "Description of the format of arguments in cmd:\n"
                                     "{program name} {input file path} {output file path} [-{filter name 1} [filter param 1] [filter param 2] ...]\n"
                                     "[-{filter name 2} [filter param 1] [filter param 2] ...] ...\n"
                                     "Args in {} are mandatory, args in [] are optional.\n"
+                                    "Input files are 24-bit or 32-bit bmp, or 1-bit, 4-bit and 8-bit bmp with a palette (including\n"
+                                    "RLE4 and RLE8 compression). Results are written as 24-bit bmp, or 32-bit if the input has alpha,\n"
+                                    "or 8-bit with --gray-output. The alpha channel of a 32-bit file is kept:\n"
+                                    "-blur, -sharp, -unsharp, -scale, -rotate and -affine work on colors premultiplied by alpha and\n"
+                                    "transform alpha too, -crop, -transpose, -rot90 and -flip move alpha with colors, other filters\n"
+                                    "change only colors.\n"
                                     "List of all filters:\n"
                                     "Crop (-crop width height)\n"
                                     "Crops an image with given width and height. Top left side of an image is used.\n"
@@ -12,35 +20,155 @@ const char* CmdLineParser::MANUAL = "Description of the format of arguments in c
                                     "Converts the image to shades of gray.\n"
                                     "Negative (-neg)\n"
                                     "Converts the image to negative.\n"
-                                    "Sharpening (-sharp)\n"
+                                    "Sharpening (-sharp [border])\n"
                                     "Self explanatory.\n"
-                                    "Edge Detection (-edge threshold)\n"
+                                    "Edge Detection (-edge threshold [border])\n"
                                     "Applies grayscale, sharpens, then pixels with a value greater than threshold are colored white, the rest are black.\n"
-                                    "Gaussian Blur (-blur sigma)\n"
+                                    "Gaussian Blur (-blur sigma [border])\n"
                                     "Gaussian Blur with sigma parameter.\n"
+                                    "Border sets what lies beyond the edges of the image for -sharp, -edge, -blur and -unsharp:\n"
+                                    "clamp (default) repeats the edge pixels, reflect mirrors the image around them, wrap repeats\n"
+                                    "the image periodically, constant is black. Only the default clamp works with --stream.\n"
                                     "Lanczos Scale (-scale width height [alpha])\n"
-                                    "Scales image to given width and height with alpha parameter. Default alpha value is 3.";
+                                    "Scales image to given width and height with alpha parameter. Default alpha value is 3.\n"
+                                    "Median (-median radius)\n"
+                                    "Replaces every channel with the median over a square with the given radius (from 1 to 127).\n"
+                                    "Removes salt-and-pepper noise. Works equally fast for any radius.\n"
+                                    "Bilateral (-bilateral sigma_s sigma_r)\n"
+                                    "Smooths the image while keeping edges: pixels are averaged over distance sigma_s, but only with\n"
+                                    "pixels whose brightness differs by about sigma_r or less. Both sigmas must be at least 1.\n"
+                                    "Unsharp Mask (-unsharp sigma amount threshold [border])\n"
+                                    "Adds amount times the difference between the image and its Gaussian blur with given sigma.\n"
+                                    "Channels that differ from the blur by less than threshold (0-255) are left unchanged.\n"
+                                    "Erosion, Dilation, Opening, Closing (-erode width height, -dilate width height,\n"
+                                    "-open width height, -close width height)\n"
+                                    "Replace every channel with the minimum (erosion) or maximum (dilation) over a width x height\n"
+                                    "rectangle. Opening is erosion followed by dilation, closing is dilation followed by erosion.\n"
+                                    "Works equally fast for any rectangle size.\n"
+                                    "Canny Edge Detection (-canny low high sigma)\n"
+                                    "Blurs the brightness with given sigma and keeps one pixel wide edges along the maxima of its\n"
+                                    "gradient. Edges with gradient at least high (0-1) are kept, edges with gradient at least low\n"
+                                    "are kept only if they are connected to the former. Edges are white, the rest is black.\n"
+                                    "Adaptive Threshold (-adaptive_threshold window C)\n"
+                                    "Pixels brighter than the mean brightness over the window x window square around them minus C\n"
+                                    "(0-255) become white, the rest become black. The window must be odd and at most 1023. Works equally\n"
+                                    "fast for any window.\n"
+                                    "Histogram Equalization (-equalize)\n"
+                                    "Spreads the brightness evenly over 0-255: every pixel is brightened or darkened by the same\n"
+                                    "amount in all channels, so colors keep their hue.\n"
+                                    "Contrast Limited Adaptive Histogram Equalization (-clahe tiles clip)\n"
+                                    "Equalizes each of tiles x tiles parts of the image separately and blends the results smoothly.\n"
+                                    "clip (for example, 2-4) limits how much the contrast may grow: each brightness may take at most\n"
+                                    "clip times its average share of a part.\n"
+                                    "Rotation (-rotate degrees [interpolation])\n"
+                                    "Rotates the image counterclockwise around its center (negative angles rotate clockwise).\n"
+                                    "The result is the smallest rectangle containing the rotated image, uncovered corners are black.\n"
+                                    "Interpolation is nearest, bilinear (default) or bicubic. Multiples of 90 degrees are exact.\n"
+                                    "Affine Transformation (-affine a b c d e f [interpolation])\n"
+                                    "Moves the point (x, y) of the image to (a * x + b * y + c, d * x + e * y + f), where x and y are\n"
+                                    "measured in pixels from the top left corner (y grows downwards). The size of the image is kept,\n"
+                                    "uncovered pixels are black. Interpolation is the same as for -rotate.\n"
+                                    "Transposition (-transpose)\n"
+                                    "Mirrors the image across the diagonal from the top left corner: columns become rows.\n"
+                                    "Rotation by 90 Degrees (-rot90)\n"
+                                    "Same as -rotate 90: rotates the image counterclockwise by a quarter turn.\n"
+                                    "Flip (-flip direction)\n"
+                                    "Mirrors the image left to right (direction h) or top to bottom (direction v).\n"
+                                    "List of all options (--{option name}[={value}], may be placed anywhere after program name):\n"
+                                    "--profile\n"
+                                    "Prints time and hardware performance counters (cycles, instructions, cache misses,\n"
+                                    "branch misses, dTLB misses) of every filter to the error stream.\n"
+                                    "--stream\n"
+                                    "Processes the image row by row without loading it into memory. Memory usage does not depend\n"
+                                    "on the image height. Supported by all filters listed above except -bilateral, -canny,\n"
+                                    "-equalize, -clahe, -rotate, -affine, -transpose, -rot90 and -flip v, and not supported\n"
+                                    "for 32-bit and top-down images.\n"
+                                    "--precision=float\n"
+                                    "Runs chains of -blur, -sharp, -edge, -neg, -gs and -crop on 32-bit float channels: the image is\n"
+                                    "converted once before such a chain and rounded to 8 bits once after it, so rounding errors of\n"
+                                    "blur and sharpen do not accumulate. Not supported with --stream, 32-bit images are processed\n"
+                                    "with 8-bit channels.\n"
+                                    "--thumbnails=width1xheight1[,width2xheight2...]\n"
+                                    "Also writes scaled copies of the result next to the output file ({output file}_{width}x{height}.bmp).\n"
+                                    "The result is decoded once, and every copy is scaled from the nearest larger level of\n"
+                                    "a pyramid of halved images.\n"
+                                    "--explain\n"
+                                    "Prints how the chain of filters was rewritten before execution. The chain is rewritten into\n"
+                                    "a cheaper one with the same result (up to rounding): -neg -neg cancel out, adjacent crops are\n"
+                                    "merged, -neg and -gs are moved to the smaller side of crops and scales, crops are moved before\n"
+                                    "-blur, -sharp and -edge with a margin. Also prints whether --approximate is on.\n"
+                                    "--approximate\n"
+                                    "Also allows rewrites that change the result slightly more than rounding: adjacent scales are\n"
+                                    "merged, -blur is moved after large downscales with a proportionally smaller sigma.\n"
+                                    "--no-optimize\n"
+                                    "Runs the chain of filters exactly as given. Without this option filters before a crop\n"
+                                    "process only the part of the image that affects the cropped result.\n"
+                                    "--cache=directory\n"
+                                    "Keeps results in the given directory. A run with the same input file contents and the same\n"
+                                    "filters copies the stored result without processing the image.\n"
+                                    "--cache-size=megabytes\n"
+                                    "Limits the size of the cache (1024 by default), least recently used results are removed first.\n"
+                                    "--cache-stats\n"
+                                    "Prints the number of cache hits, misses and evictions.\n"
+                                    "--gray-output\n"
+                                    "Converts the result to shades of gray (as -gs) and writes it as an 8-bit bmp with a gray palette,\n"
+                                    "which is three times smaller than a 24-bit one. Works with --stream; images with alpha are\n"
+                                    "still written as 32-bit.\n"
+                                    "--probe=path\n"
+                                    "Reads only the headers of the given file or of all .bmp files in the given directory and its\n"
+                                    "subdirectories, and prints their width, height, bits per pixel and whether the file is as long\n"
+                                    "as the headers require. No other arguments are needed: {program name} --probe=path.";
+
 
+bool CmdLineParser::IsFilterName(std::string_view arg) {
+    // -30 или -.5 -- отрицательное число, то есть параметр фильтра
+    return arg.size() > 1 && arg[0] == '-' && !std::isdigit(static_cast<unsigned char>(arg[1])) && arg[1] != '.';
+}
 
 CmdLineParser::parse_result CmdLineParser::Parse(int argc, char* argv[]) {
-    if (argc == ZERO_PARAM_NUM) {
-        return CmdLineParser::parse_result::HELP;
-    } else if (argc < MIN_PARAM_NUM) {
+    fdv_.clear();
+    options_.clear();
+    std::vector<std::string_view> args; // аргументы без опций
+    std::string_view arg;
+    for (int i = 0; i < argc; ++i) {
+        arg = argv[i];
+        if (i == 0 || !arg.starts_with("--")) {
+            args.push_back(arg);
+            continue;
+        }
+        arg.remove_prefix(2);
+        size_t value_pos = arg.find('=');
+        if (arg.empty() || value_pos == 0) {
+            return CmdLineParser::parse_result::FAILED;
+        }
+        if (value_pos == std::string_view::npos) {
+            options_[arg] = std::string_view();
+        } else {
+            options_[arg.substr(0, value_pos)] = arg.substr(value_pos + 1);
+        }
+    }
+    int args_num = static_cast<int>(args.size());
+    if (args_num == ZERO_PARAM_NUM) {
+        if (options_.empty()) {
+            return CmdLineParser::parse_result::HELP;
+        }
+        // --probe не требует входного и выходного файлов
+        return HasOption("probe") ? CmdLineParser::parse_result::PARSED : CmdLineParser::parse_result::FAILED;
+    } else if (args_num < MIN_PARAM_NUM) {
         return CmdLineParser::parse_result::FAILED; // Недостаточно параметров
     }
-    input_file_name_ = argv[INPUT_FILE_NAME_POS];
-    output_file_name_ = argv[OUTPUT_FILE_NAME_POS];
-    if (argc == MIN_PARAM_NUM) {
+    input_file_name_ = args[INPUT_FILE_NAME_POS];
+    output_file_name_ = args[OUTPUT_FILE_NAME_POS];
+    if (args_num == MIN_PARAM_NUM) {
         return CmdLineParser::parse_result::PARSED;
     }
-    if (argc > MIN_PARAM_NUM && argv[OUTPUT_FILE_NAME_POS + 1][0] != '-') {
+    if (args_num > MIN_PARAM_NUM && !IsFilterName(args[OUTPUT_FILE_NAME_POS + 1])) {
         return CmdLineParser::parse_result::FAILED;
     }
     FilterDescriptor struct_holder;
-    std::string_view arg;
-    for (int i = OUTPUT_FILE_NAME_POS + 1; i < argc; ++i) {
-        arg = argv[i]; // перевел в string_view
-        if (arg[0] == '-') {
+    for (int i = OUTPUT_FILE_NAME_POS + 1; i < args_num; ++i) {
+        arg = args[i];
+        if (IsFilterName(arg)) {
             if (i != OUTPUT_FILE_NAME_POS + 1) { // чтобы не добавить пустую структуру
                 fdv_.push_back(struct_holder);
             }
@@ -56,4 +184,12 @@ CmdLineParser::parse_result CmdLineParser::Parse(int argc, char* argv[]) {
     }
     fdv_.push_back(struct_holder);
     return CmdLineParser::parse_result::PARSED;
-}
\ No newline at end of file
+}
+
+std::string_view CmdLineParser::GetOption(std::string_view name) const {
+    OptionMap::const_iterator it = options_.find(name);
+    if (it != options_.end()) {
+        return it->second;
+    }
+    return {};
+}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <map>
 #include <string_view>
 #include <vector>
 #include <iostream>
@@ -23,14 +24,24 @@ public:
     };
 public:
     using FilterDescriptorVector = std::vector<FilterDescriptor>;
+    using OptionMap = std::map<std::string_view, std::string_view>;
 public:
     parse_result Parse(int argc, char* argv[]);  // enum для разных случаев пользовательского ввода
     std::string_view GetInputFileName() const { return input_file_name_; }
     std::string_view GetOutputFileName() const { return output_file_name_; }
     FilterDescriptorVector GetData() const { return fdv_; }
 
+    // Опции программы задаются в виде --name или --name=value в любом месте командной строки
+    bool HasOption(std::string_view name) const { return options_.contains(name); }
+    std::string_view GetOption(std::string_view name) const;
+
+protected:
+    // Аргумент, начинающийся с '-', -- имя фильтра, если это не отрицательное число
+    static bool IsFilterName(std::string_view arg);
+
 protected:
     std::string_view input_file_name_;
     std::string_view output_file_name_;
     FilterDescriptorVector fdv_;
+    OptionMap options_;
 };
@@ -1,17 +1,238 @@
 #include "filter_pipeline.h"
+#include "stream_pipeline.h"
+
+#include <chrono>
+#include <iomanip>
 
 void FilterPipeline::Apply(Bitmap& image) {
+    RegionPlan plan;
+    plan.first_stage = fv_.size();
+    if (region_propagation_) {
+        plan = PlanRegions(image.GetPixels().GetWidth(), image.GetPixels().GetHeight());
+    }
+    // Фильтры, считающие только часть изображения, зависят от всей цепочки, их результаты не сохраняются.
+    // Кэш хранит только цвета, поэтому изображения с альфа-каналом в нём не сохраняются.
+    std::vector<std::string> keys = image.GetAlpha() ? std::vector<std::string>() : GetPrefixKeys(plan.first_stage);
+    size_t first_stage = RestorePrefix(image, keys);
+    if (!profiling_) {
+        for (size_t i = first_stage; i < fv_.size(); ++i) {
+            ApplyStage(i, image, plan);
+            if (i < keys.size()) {
+                prefix_cache_->Insert(keys[i], image.GetPixels());
+            }
+        }
+        image.Unpremultiply();
+        return;
+    }
+    PerfCounters counters;
+    counters_available_ = counters.IsAvailable();
+    for (size_t event = 0; event < PerfCounters::EVENT_NUM; ++event) {
+        counters_opened_[event] = counters.IsOpened(static_cast<PerfCounters::Event>(event));
+    }
+    stats_.clear();
+    for (size_t i = first_stage; i < fv_.size(); ++i) {
+        StageStats current_stats;
+        current_stats.name = names_[i];
+        auto start = std::chrono::steady_clock::now();
+        counters.Start();
+        ApplyStage(i, image, plan);
+        current_stats.counters = counters.Stop();
+        auto finish = std::chrono::steady_clock::now();
+        current_stats.milliseconds = std::chrono::duration<double, std::milli>(finish - start).count();
+        stats_.push_back(current_stats);
+        if (i < keys.size()) {
+            prefix_cache_->Insert(keys[i], image.GetPixels());
+        }
+    }
+    image.Unpremultiply();
+}
+
+std::vector<std::string> FilterPipeline::GetPrefixKeys(size_t stage_num) const {
+    std::vector<std::string> keys;
+    if (!prefix_cache_ || precise_) {
+        return keys;
+    }
+    std::string prefix;
+    for (size_t i = 0; i < stage_num && !names_[i].empty(); ++i) {
+        prefix += names_[i];
+        prefix += '\n';
+        keys.push_back(PrefixCache::MakeKey(input_id_, prefix));
+    }
+    return keys;
+}
+
+size_t FilterPipeline::RestorePrefix(Bitmap& image, const std::vector<std::string>& keys) {
+    for (size_t i = keys.size(); i > 0; --i) {
+        if (const PixelArray* cached = prefix_cache_->Find(keys[i - 1])) {
+            image.GetPixels() = *cached;
+            return i;
+        }
+    }
+    return 0;
+}
+
+void FilterPipeline::ApplyStage(size_t i, Bitmap& image, const RegionPlan& plan) {
+    PixelArray* alpha = image.GetAlpha();
+    if (!alpha) {
+        if (precise_ && fv_[i]->SupportsPrecise()) {
+            ApplyPreciseStage(i, image, plan);
+            return;
+        }
+        ApplyPixelsStage(i, image, plan);
+        return;
+    }
+    BaseFilter::AlphaMode alpha_mode = fv_[i]->GetAlphaMode();
+    if (alpha_mode == BaseFilter::AlphaMode::KEEP) {
+        image.Unpremultiply();
+        ApplyPixelsStage(i, image, plan);
+        // Такие фильтры не меняют размеров, и из альфы вырезается та же область, что осталась от цветов
+        if (i >= plan.first_stage) {
+            if (i == plan.first_stage) {
+                BaseFilter::CutRegion(*alpha, plan.regions[i]);
+            }
+            const Region& input = plan.regions[i];
+            const Region& output = plan.regions[i + 1];
+            BaseFilter::CutRegion(*alpha, Region{output.row - input.row, output.column - input.column,
+                                                 output.height, output.width});
+        }
+        return;
+    }
+    // Перестановке пикселей всё равно, умножены ли цвета на альфу
+    if (alpha_mode == BaseFilter::AlphaMode::PREMULTIPLIED) {
+        image.Premultiply();
+    }
+    ApplyPixelsStage(i, image, plan);
+    Bitmap alpha_image = image.CopyWithPixels(std::move(*alpha));
+    ApplyPixelsStage(i, alpha_image, plan);
+    *alpha = std::move(alpha_image.GetPixels());
+}
+
+void FilterPipeline::ApplyPixelsStage(size_t i, Bitmap& image, const RegionPlan& plan) {
+    if (i < plan.first_stage) {
+        fv_[i]->Apply(image);
+        return;
+    }
+    if (i == plan.first_stage) {
+        BaseFilter::CutRegion(image.GetPixels(), plan.regions[i]);
+    }
+    fv_[i]->ApplyToRegion(image, plan.regions[i], plan.regions[i + 1], plan.sizes[i].first, plan.sizes[i].second);
+}
+
+void FilterPipeline::ApplyPreciseStage(size_t i, Bitmap& image, const RegionPlan& plan) {
+    if (!precise_image_) {
+        precise_image_.emplace(image.GetPixels());
+    }
+    if (i < plan.first_stage) {
+        fv_[i]->ApplyPrecise(*precise_image_);
+    } else {
+        if (i == plan.first_stage) {
+            precise_image_->Cut(plan.regions[i]);
+        }
+        fv_[i]->ApplyPreciseToRegion(*precise_image_, plan.regions[i], plan.regions[i + 1], plan.sizes[i].first,
+                                     plan.sizes[i].second);
+    }
+    // Следующий фильтр работает с 8-битным изображением
+    if (i + 1 == fv_.size() || !fv_[i + 1]->SupportsPrecise()) {
+        precise_image_->Quantize(image.GetPixels());
+        precise_image_.reset();
+    }
+}
+
+FilterPipeline::RegionPlan FilterPipeline::PlanRegions(size_t width, size_t height) const {
+    RegionPlan plan;
+    plan.sizes.emplace_back(width, height);
     for (BaseFilter* i : fv_) {
-        i->Apply(image);
+        plan.sizes.push_back(i->GetOutputSize(plan.sizes.back().first, plan.sizes.back().second));
     }
+    plan.regions.resize(fv_.size() + 1);
+    plan.regions.back() = Region{0, 0, plan.sizes.back().second, plan.sizes.back().first};
+    plan.first_stage = 0;
+    for (size_t i = fv_.size(); i > 0; --i) {
+        std::optional<Region> input = fv_[i - 1]->GetInputRegion(plan.regions[i], plan.sizes[i - 1].first,
+                                                                 plan.sizes[i - 1].second);
+        if (!input) {
+            plan.first_stage = i;
+            break;
+        }
+        plan.regions[i - 1] = *input;
+    }
+    bool reduces_work = false;
+    for (size_t i = plan.first_stage; i < fv_.size(); ++i) {
+        reduces_work |= plan.regions[i].width * plan.regions[i].height < plan.sizes[i].first * plan.sizes[i].second;
+    }
+    if (!reduces_work) {
+        plan.first_stage = fv_.size();
+    }
+    return plan;
 }
 
-void FilterPipeline::AddFilter(BaseFilter* new_filter) {
+bool FilterPipeline::ApplyStreaming(BitmapRowReader& reader, std::ostream& stream, bool gray) {
+    StreamPipeline sp(reader.GetWidth(), reader.GetHeight());
+    for (size_t i = 0; i < fv_.size(); ++i) {
+        if (!fv_[i]->AddStreamStages(sp)) {
+            std::cerr << names_[i] << " does not support streaming mode" << std::endl;
+            return false;
+        }
+    }
+    return sp.Run(reader, stream, gray ? BitmapRowWriter::Format::GRAY8 : BitmapRowWriter::Format::BGR24);
+}
+
+void FilterPipeline::AddFilter(BaseFilter* new_filter, std::string_view name) {
     fv_.push_back(new_filter);
+    names_.emplace_back(name);
 }
 
-FilterPipeline::~FilterPipeline() {
+void FilterPipeline::PrintStats(std::ostream& stream) const {
+    const int NAME_WIDTH = 24;
+    const int VALUE_WIDTH = 15;
+    stream << std::left << std::setw(NAME_WIDTH) << "stage" << std::right << std::setw(VALUE_WIDTH) << "time, ms";
+    if (counters_available_) {
+        for (std::string_view event_name : PerfCounters::EVENT_NAMES) {
+            stream << std::setw(VALUE_WIDTH) << event_name;
+        }
+        stream << std::setw(VALUE_WIDTH) << "IPC";
+    }
+    stream << std::endl;
+    double total_milliseconds = 0;
+    for (const StageStats& i : stats_) {
+        total_milliseconds += i.milliseconds;
+        stream << std::left << std::setw(NAME_WIDTH) << i.name << std::right << std::setw(VALUE_WIDTH)
+               << std::fixed << std::setprecision(3) << i.milliseconds;
+        if (counters_available_) {
+            for (size_t event = 0; event < PerfCounters::EVENT_NUM; ++event) {
+                if (counters_opened_[event]) {
+                    stream << std::setw(VALUE_WIDTH) << i.counters[event];
+                } else {
+                    stream << std::setw(VALUE_WIDTH) << "n/a";
+                }
+            }
+            double cycles = static_cast<double>(i.counters[PerfCounters::CYCLES]);
+            double instructions = static_cast<double>(i.counters[PerfCounters::INSTRUCTIONS]);
+            if (counters_opened_[PerfCounters::CYCLES] && counters_opened_[PerfCounters::INSTRUCTIONS]) {
+                stream << std::setw(VALUE_WIDTH) << std::setprecision(2) << (cycles > 0 ? instructions / cycles : 0.0);
+            } else {
+                stream << std::setw(VALUE_WIDTH) << "n/a";
+            }
+        }
+        stream << std::endl;
+    }
+    stream << std::left << std::setw(NAME_WIDTH) << "total" << std::right << std::setw(VALUE_WIDTH)
+           << std::fixed << std::setprecision(3) << total_milliseconds << std::endl;
+    if (!counters_available_) {
+        stream << "hardware performance counters are not available "
+                  "(check /proc/sys/kernel/perf_event_paranoid)" << std::endl;
+    }
+}
+
+void FilterPipeline::Clear() {
     for (BaseFilter* i : fv_) {
         delete i;
     }
+    fv_.clear();
+    names_.clear();
+    stats_.clear();
+}
+
+FilterPipeline::~FilterPipeline() {
+    Clear();
 }
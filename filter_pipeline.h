@@ -1,18 +1,112 @@
 #pragma once
+#include <array>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
 #include <vector>
 #include "base_filter.h"
+#include "float_image.h"
+#include "perf_counters.h"
+#include "prefix_cache.h"
 
 class FilterPipeline {
 public:
     using FilterVector = std::vector<BaseFilter*>;
 
+    // Статистика выполнения одного фильтра (стадии) конвейера
+    struct StageStats {
+        std::string name;
+        double milliseconds = 0;
+        PerfCounters::Values counters{};
+    };
+    using StageStatsVector = std::vector<StageStats>;
+
+    // Какие области изображения нужно считать на каждой стадии, чтобы получить весь результат.
+    // Стадии до first_stage применяются ко всему изображению, стадия i >= first_stage получает
+    // область regions[i] своего входного изображения размером sizes[i].
+    // regions и sizes содержат по одному элементу на стадию и ещё один для результата конвейера.
+    struct RegionPlan {
+        size_t first_stage = 0;
+        std::vector<Region> regions;
+        std::vector<BaseFilter::Size> sizes;
+    };
+
 public:
     ~FilterPipeline();
 
-    void AddFilter(BaseFilter* new_filter);
+    // name -- описание фильтра для вывода статистики (например, "blur 5")
+    void AddFilter(BaseFilter* new_filter, std::string_view name = {});
+
+    // Удаляет все фильтры
+    void Clear();
 
+    // Если включено распространение областей, фильтры считают только ту часть изображения,
+    // которая влияет на результат (например, на то, что останется после последней обрезки)
     void Apply(Bitmap& image);
 
+    void EnableRegionPropagation(bool enable) { region_propagation_ = enable; }
+
+    // В режиме повышенной точности подряд идущие фильтры, поддерживающие FloatImage, работают с float:
+    // изображение переводится в float перед первым из них и округляется до 8 бит после последнего.
+    // Промежуточные результаты не округляются, поэтому кэш начал цепочки в этом режиме не используется.
+    void EnablePrecise(bool enable) { precise_ = enable; }
+
+    // Результаты начальных фильтров, применяемых ко всему изображению, сохраняются в cache с идентификатором
+    // входного изображения input_id, а Apply начинает с самого длинного уже посчитанного начала цепочки.
+    // Для этого у всех фильтров должны быть описания (name в AddFilter), однозначно задающие фильтр.
+    // nullptr отключает кэш. Конвейер не владеет кэшем, один кэш можно использовать в нескольких конвейерах.
+    void SetPrefixCache(PrefixCache* cache, uint64_t input_id) {
+        prefix_cache_ = cache;
+        input_id_ = input_id;
+    }
+
+    // Распространяет область результата от последнего фильтра к первому. Если ни на одной стадии
+    // область не меньше всего изображения, first_stage равен числу фильтров.
+    RegionPlan PlanRegions(size_t width, size_t height) const;
+
+    // Потоковая обработка: изображение читается из reader и пишется в stream построчно,
+    // не загружаясь в память целиком. Возвращает false, если какой-то фильтр не поддерживает
+    // потоковый режим или не удалось прочитать/записать данные. gray -- как в Bitmap::CreateFile.
+    bool ApplyStreaming(BitmapRowReader& reader, std::ostream& stream, bool gray = false);
+
+    // В режиме профилирования каждая стадия замеряется по времени и аппаратным счётчикам
+    void EnableProfiling(bool enable) { profiling_ = enable; }
+
+    const StageStatsVector& GetStats() const { return stats_; }
+
+    void PrintStats(std::ostream& stream) const;
+
+protected:
+    // Применяет фильтр i; если стадия входит в план, image содержит только нужную ей область.
+    // Для изображения с альфа-каналом цвета перед фильтром умножаются на альфу или возвращаются к исходным,
+    // смотря по BaseFilter::GetAlphaMode; режим повышенной точности для таких изображений не используется.
+    void ApplyStage(size_t i, Bitmap& image, const RegionPlan& plan);
+
+    // Применяет фильтр i к пикселям image без учёта альфы
+    void ApplyPixelsStage(size_t i, Bitmap& image, const RegionPlan& plan);
+
+    // То же для фильтра, работающего с precise_image_
+    void ApplyPreciseStage(size_t i, Bitmap& image, const RegionPlan& plan);
+
+    // Ключи кэша для результатов первых 1, 2, ... фильтров; только для фильтров до stage_num
+    std::vector<std::string> GetPrefixKeys(size_t stage_num) const;
+
+    // Подставляет в image самый длинный сохранённый результат и возвращает число пропущенных фильтров
+    size_t RestorePrefix(Bitmap& image, const std::vector<std::string>& keys);
+
 protected:
     FilterVector fv_;
+    std::vector<std::string> names_;
+    bool profiling_ = false;
+    bool region_propagation_ = true;
+    bool precise_ = false;
+    // Изображение внутри цепочки фильтров, работающих с float
+    std::optional<FloatImage> precise_image_;
+    PrefixCache* prefix_cache_ = nullptr;
+    uint64_t input_id_ = 0;
+    bool counters_available_ = false;
+    // Какие счётчики удалось открыть: значения остальных не измерены и печатаются как n/a
+    std::array<bool, PerfCounters::EVENT_NUM> counters_opened_{};
+    StageStatsVector stats_;
 };
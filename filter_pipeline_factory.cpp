@@ -11,11 +11,25 @@ namespace FilterFactories {
         return result;
     }
 
+    BorderMode ParseBorderMode(const std::string_view& sw) {
+        static const std::map<std::string_view, BorderMode> BORDER_MODES = {
+            {"clamp", BorderMode::CLAMP},
+            {"reflect", BorderMode::REFLECT},
+            {"wrap", BorderMode::WRAP},
+            {"constant", BorderMode::CONSTANT}};
+        auto border = BORDER_MODES.find(sw);
+        if (border == BORDER_MODES.end()) {
+            throw std::invalid_argument("border must be clamp, reflect, wrap or constant");
+        }
+        return border->second;
+    }
+
     BaseFilter* MakeGaussianBlurFilter(const FilterDescriptor& fd) {
         if (fd.filter_name != "blur") {
             throw std::invalid_argument("wrong blur filter descriptor");
         }
-        if (fd.filter_params.size() != GaussianBlurFilter::PARAM_NUM) {
+        if (fd.filter_params.size() != GaussianBlurFilter::PARAM_NUM &&
+            fd.filter_params.size() != GaussianBlurFilter::PARAM_NUM_WITH_BORDER) {
             throw std::invalid_argument("wrong blur filter params size");
         }
         double sigma;
@@ -24,7 +38,11 @@ namespace FilterFactories {
         } catch (std::invalid_argument& e) {
             throw std::invalid_argument("wrong blur filter param type");
         }
-        return new GaussianBlurFilter(sigma);
+        BorderMode border = BorderMode::CLAMP;
+        if (fd.filter_params.size() == GaussianBlurFilter::PARAM_NUM_WITH_BORDER) {
+            border = ParseBorderMode(fd.filter_params[1]);
+        }
+        return new GaussianBlurFilter(sigma, border);
     }
 
     BaseFilter* MakeCropFilter(const FilterDescriptor& fd) {
@@ -73,17 +91,22 @@ namespace FilterFactories {
         if (fd.filter_name != "sharp") {
             throw std::invalid_argument("wrong sharpening filter descriptor");
         }
-        if (!fd.filter_params.empty()) {
+        if (!fd.filter_params.empty() && fd.filter_params.size() != SharpeningFilter::PARAM_NUM_WITH_BORDER) {
             throw std::invalid_argument("wrong sharpening filter params size");
         }
-        return new SharpeningFilter;
+        BorderMode border = BorderMode::CLAMP;
+        if (fd.filter_params.size() == SharpeningFilter::PARAM_NUM_WITH_BORDER) {
+            border = ParseBorderMode(fd.filter_params[0]);
+        }
+        return new SharpeningFilter(border);
     }
 
     BaseFilter* MakeEdgeDetectionFilter(const FilterDescriptor& fd) {
         if (fd.filter_name != "edge") {
             throw std::invalid_argument("wrong edge detection filter descriptor");
         }
-        if (fd.filter_params.size() != EdgeDetectionFilter::PARAM_NUM) {
+        if (fd.filter_params.size() != EdgeDetectionFilter::PARAM_NUM &&
+            fd.filter_params.size() != EdgeDetectionFilter::PARAM_NUM_WITH_BORDER) {
             throw std::invalid_argument("wrong edge detection filter params size");
         }
         double threshold;
@@ -92,7 +115,11 @@ namespace FilterFactories {
         } catch (std::invalid_argument& e) {
             throw std::invalid_argument("wrong edge detection filter param type");
         }
-        return new EdgeDetectionFilter(threshold);
+        BorderMode border = BorderMode::CLAMP;
+        if (fd.filter_params.size() == EdgeDetectionFilter::PARAM_NUM_WITH_BORDER) {
+            border = ParseBorderMode(fd.filter_params[1]);
+        }
+        return new EdgeDetectionFilter(threshold, border);
     }
 
     BaseFilter* MakeLanczosScaleFilter(const FilterDescriptor& fd) {
@@ -140,6 +167,278 @@ namespace FilterFactories {
             throw std::invalid_argument("wrong lanczos scale filter params size");
         }
     }
+
+    BaseFilter* MakeMedianFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "median") {
+            throw std::invalid_argument("wrong median filter descriptor");
+        }
+        if (fd.filter_params.size() != MedianFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong median filter params size");
+        }
+        size_t radius;
+        try {
+            radius = SWtoSize(fd.filter_params[0]);
+        } catch(std::invalid_argument& e) {
+            throw std::invalid_argument("wrong median filter radius param type");
+        }
+        if (radius == 0 || radius > MedianFilter::MAX_RADIUS) {
+            throw std::invalid_argument("median filter radius must be from 1 to " +
+                                        std::to_string(MedianFilter::MAX_RADIUS));
+        }
+        return new MedianFilter(radius);
+    }
+
+    BaseFilter* MakeBilateralFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "bilateral") {
+            throw std::invalid_argument("wrong bilateral filter descriptor");
+        }
+        if (fd.filter_params.size() != BilateralFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong bilateral filter params size");
+        }
+        double sigma_s;
+        double sigma_r;
+        try {
+            sigma_s = std::stod(std::string(fd.filter_params[0]));
+            sigma_r = std::stod(std::string(fd.filter_params[1]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong bilateral filter param type");
+        }
+        if (!(sigma_s >= BilateralFilter::MIN_SIGMA && sigma_r >= BilateralFilter::MIN_SIGMA)) {
+            throw std::invalid_argument("bilateral filter sigmas must be at least 1");
+        }
+        return new BilateralFilter(sigma_s, sigma_r);
+    }
+
+    BaseFilter* MakeUnsharpMaskFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "unsharp") {
+            throw std::invalid_argument("wrong unsharp mask filter descriptor");
+        }
+        if (fd.filter_params.size() != UnsharpMaskFilter::PARAM_NUM &&
+            fd.filter_params.size() != UnsharpMaskFilter::PARAM_NUM_WITH_BORDER) {
+            throw std::invalid_argument("wrong unsharp mask filter params size");
+        }
+        double sigma;
+        double amount;
+        double threshold;
+        try {
+            sigma = std::stod(std::string(fd.filter_params[0]));
+            amount = std::stod(std::string(fd.filter_params[1]));
+            threshold = std::stod(std::string(fd.filter_params[2]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong unsharp mask filter param type");
+        }
+        if (!(sigma > 0) || !(amount >= 0) || !(threshold >= 0)) {
+            throw std::invalid_argument("unsharp mask sigma must be positive, amount and threshold must not be negative");
+        }
+        BorderMode border = BorderMode::CLAMP;
+        if (fd.filter_params.size() == UnsharpMaskFilter::PARAM_NUM_WITH_BORDER) {
+            border = ParseBorderMode(fd.filter_params[UnsharpMaskFilter::PARAM_NUM]);
+        }
+        return new UnsharpMaskFilter(sigma, amount, threshold, border);
+    }
+
+    BaseFilter* MakeMorphologyFilter(const FilterDescriptor& fd) {
+        static const std::map<std::string_view, MorphologyFilter::Operation> OPERATIONS = {
+            {"erode", MorphologyFilter::Operation::ERODE},
+            {"dilate", MorphologyFilter::Operation::DILATE},
+            {"open", MorphologyFilter::Operation::OPEN},
+            {"close", MorphologyFilter::Operation::CLOSE}};
+        auto operation = OPERATIONS.find(fd.filter_name);
+        if (operation == OPERATIONS.end()) {
+            throw std::invalid_argument("wrong morphology filter descriptor");
+        }
+        if (fd.filter_params.size() != MorphologyFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong morphology filter params size");
+        }
+        size_t width;
+        size_t height;
+        try {
+            width = SWtoSize(fd.filter_params[0]);
+            height = SWtoSize(fd.filter_params[1]);
+        } catch(std::invalid_argument& e) {
+            throw std::invalid_argument("wrong morphology filter param type");
+        }
+        if (width == 0 || height == 0) {
+            throw std::invalid_argument("morphology structuring element must not be empty");
+        }
+        return new MorphologyFilter(operation->second, width, height);
+    }
+
+    BaseFilter* MakeCannyFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "canny") {
+            throw std::invalid_argument("wrong canny filter descriptor");
+        }
+        if (fd.filter_params.size() != CannyFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong canny filter params size");
+        }
+        double low;
+        double high;
+        double sigma;
+        try {
+            low = std::stod(std::string(fd.filter_params[0]));
+            high = std::stod(std::string(fd.filter_params[1]));
+            sigma = std::stod(std::string(fd.filter_params[2]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong canny filter param type");
+        }
+        if (!(low >= 0 && low <= high) || !(sigma > 0)) {
+            throw std::invalid_argument("canny thresholds must satisfy 0 <= low <= high, sigma must be positive");
+        }
+        return new CannyFilter(low, high, sigma);
+    }
+
+    BaseFilter* MakeAdaptiveThresholdFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "adaptive_threshold") {
+            throw std::invalid_argument("wrong adaptive threshold filter descriptor");
+        }
+        if (fd.filter_params.size() != AdaptiveThresholdFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong adaptive threshold filter params size");
+        }
+        size_t window;
+        double c;
+        try {
+            window = SWtoSize(fd.filter_params[0]);
+            c = std::stod(std::string(fd.filter_params[1]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong adaptive threshold filter param type");
+        }
+        if (window % 2 == 0) {
+            throw std::invalid_argument("adaptive threshold window must be odd");
+        }
+        if (window > AdaptiveThresholdFilter::MAX_WINDOW) {
+            throw std::invalid_argument("adaptive threshold window must be at most " +
+                                        std::to_string(AdaptiveThresholdFilter::MAX_WINDOW));
+        }
+        return new AdaptiveThresholdFilter(window, c);
+    }
+
+    BaseFilter* MakeEqualizeFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "equalize") {
+            throw std::invalid_argument("wrong equalize filter descriptor");
+        }
+        if (!fd.filter_params.empty()) {
+            throw std::invalid_argument("wrong equalize filter params size");
+        }
+        return new EqualizeFilter;
+    }
+
+    BaseFilter* MakeClaheFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "clahe") {
+            throw std::invalid_argument("wrong clahe filter descriptor");
+        }
+        if (fd.filter_params.size() != ClaheFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong clahe filter params size");
+        }
+        size_t tiles;
+        double clip;
+        try {
+            tiles = SWtoSize(fd.filter_params[0]);
+            clip = std::stod(std::string(fd.filter_params[1]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong clahe filter param type");
+        }
+        if (tiles == 0 || !(clip > 0)) {
+            throw std::invalid_argument("clahe tiles and clip must be positive");
+        }
+        return new ClaheFilter(tiles, clip);
+    }
+
+    AffineFilter::Interpolation ParseInterpolation(const std::string_view& sw) {
+        static const std::map<std::string_view, AffineFilter::Interpolation> INTERPOLATIONS = {
+            {"nearest", AffineFilter::Interpolation::NEAREST},
+            {"bilinear", AffineFilter::Interpolation::BILINEAR},
+            {"bicubic", AffineFilter::Interpolation::BICUBIC}};
+        auto interpolation = INTERPOLATIONS.find(sw);
+        if (interpolation == INTERPOLATIONS.end()) {
+            throw std::invalid_argument("interpolation must be nearest, bilinear or bicubic");
+        }
+        return interpolation->second;
+    }
+
+    BaseFilter* MakeRotateFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "rotate") {
+            throw std::invalid_argument("wrong rotate filter descriptor");
+        }
+        if (fd.filter_params.size() != RotateFilter::PARAM_NUM &&
+            fd.filter_params.size() != RotateFilter::PARAM_NUM_WITH_INTERPOLATION) {
+            throw std::invalid_argument("wrong rotate filter params size");
+        }
+        double degrees;
+        try {
+            degrees = std::stod(std::string(fd.filter_params[0]));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong rotate filter param type");
+        }
+        if (!std::isfinite(degrees)) {
+            throw std::invalid_argument("rotate angle must be finite");
+        }
+        AffineFilter::Interpolation interpolation = AffineFilter::Interpolation::BILINEAR;
+        if (fd.filter_params.size() == RotateFilter::PARAM_NUM_WITH_INTERPOLATION) {
+            interpolation = ParseInterpolation(fd.filter_params[1]);
+        }
+        return new RotateFilter(degrees, interpolation);
+    }
+
+    BaseFilter* MakeAffineFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "affine") {
+            throw std::invalid_argument("wrong affine filter descriptor");
+        }
+        if (fd.filter_params.size() != AffineFilter::PARAM_NUM &&
+            fd.filter_params.size() != AffineFilter::PARAM_NUM_WITH_INTERPOLATION) {
+            throw std::invalid_argument("wrong affine filter params size");
+        }
+        std::vector<double> coefficients;
+        try {
+            for (size_t i = 0; i < AffineFilter::PARAM_NUM; ++i) {
+                coefficients.push_back(std::stod(std::string(fd.filter_params[i])));
+            }
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong affine filter param type");
+        }
+        AffineFilter::Matrix matrix{coefficients[0], coefficients[1], coefficients[2],
+                                    coefficients[3], coefficients[4], coefficients[5]};
+        if (!std::isnormal(matrix.GetDeterminant())) {
+            throw std::invalid_argument("affine matrix must be invertible");
+        }
+        AffineFilter::Interpolation interpolation = AffineFilter::Interpolation::BILINEAR;
+        if (fd.filter_params.size() == AffineFilter::PARAM_NUM_WITH_INTERPOLATION) {
+            interpolation = ParseInterpolation(fd.filter_params[AffineFilter::PARAM_NUM]);
+        }
+        return new AffineFilter(matrix, interpolation);
+    }
+
+    BaseFilter* MakeTransposeFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "transpose") {
+            throw std::invalid_argument("wrong transpose filter descriptor");
+        }
+        if (!fd.filter_params.empty()) {
+            throw std::invalid_argument("wrong transpose filter params size");
+        }
+        return new TransposeFilter;
+    }
+
+    BaseFilter* MakeRot90Filter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "rot90") {
+            throw std::invalid_argument("wrong rot90 filter descriptor");
+        }
+        if (!fd.filter_params.empty()) {
+            throw std::invalid_argument("wrong rot90 filter params size");
+        }
+        return new RotateFilter(90, AffineFilter::Interpolation::NEAREST);
+    }
+
+    BaseFilter* MakeFlipFilter(const FilterDescriptor& fd) {
+        if (fd.filter_name != "flip") {
+            throw std::invalid_argument("wrong flip filter descriptor");
+        }
+        if (fd.filter_params.size() != FlipFilter::PARAM_NUM) {
+            throw std::invalid_argument("wrong flip filter params size");
+        }
+        if (fd.filter_params[0] != "h" && fd.filter_params[0] != "v") {
+            throw std::invalid_argument("flip direction must be h or v");
+        }
+        return new FlipFilter(fd.filter_params[0] == "h");
+    }
 }
 
 void FilterPipelineFactory::AddFilterMaker(std::string_view name, FilterFactory factory) {
@@ -175,7 +474,16 @@ bool FilterPipelineFactory::CreateFilterPipeline(FilterPipeline& fp, const CmdLi
             std::cerr << e.what() <<std::endl;
             return false;
         }
-        fp.AddFilter(filter_template);
+        fp.AddFilter(filter_template, DescribeFilter(i));
     }
     return true;
 }
+
+std::string FilterPipelineFactory::DescribeFilter(const FilterDescriptor& descriptor) {
+    std::string result(descriptor.filter_name);
+    for (std::string_view param : descriptor.filter_params) {
+        result += ' ';
+        result += param;
+    }
+    return result;
+}
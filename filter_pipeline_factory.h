@@ -25,6 +25,9 @@ public:
 
     bool CreateFilterPipeline(FilterPipeline& fp, const CmdLineParser::FilterDescriptorVector& fdv) const;
 
+    // Текстовое описание фильтра вида "имя параметр1 параметр2 ..."
+    static std::string DescribeFilter(const FilterDescriptor& descriptor);
+
 
 protected:
     FilterToMakerMap filter_to_makers_;
@@ -33,6 +36,9 @@ protected:
 namespace FilterFactories {
     size_t SWtoSize(const std::string_view& sw); //перевод std::string_view в size_t
 
+    // Обработка краёв по имени: clamp, reflect, wrap или constant
+    BorderMode ParseBorderMode(const std::string_view& sw);
+
     // Тут мы фактически хардкодим список фильтров, доступных нашей программе.
     // Добавление нового фильтра осуществляется путём создания новой продуцирующей функции.
     BaseFilter* MakeGaussianBlurFilter(const FilterDescriptor& fd);
@@ -49,6 +55,38 @@ namespace FilterFactories {
 
     BaseFilter* MakeLanczosScaleFilter(const FilterDescriptor& fd);
 
+    BaseFilter* MakeMedianFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeBilateralFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeUnsharpMaskFilter(const FilterDescriptor& fd);
+
+    // Эрозия, дилатация, открытие и закрытие (-erode, -dilate, -open, -close)
+    BaseFilter* MakeMorphologyFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeCannyFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeAdaptiveThresholdFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeEqualizeFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeClaheFilter(const FilterDescriptor& fd);
+
+    // Способ интерполяции по имени: nearest, bilinear или bicubic
+    AffineFilter::Interpolation ParseInterpolation(const std::string_view& sw);
+
+    BaseFilter* MakeRotateFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeAffineFilter(const FilterDescriptor& fd);
+
+    BaseFilter* MakeTransposeFilter(const FilterDescriptor& fd);
+
+    // Поворот на 90 градусов против часовой стрелки (-rot90)
+    BaseFilter* MakeRot90Filter(const FilterDescriptor& fd);
+
+    // Отражение слева направо (-flip h) или сверху вниз (-flip v)
+    BaseFilter* MakeFlipFilter(const FilterDescriptor& fd);
+
 }
 
 
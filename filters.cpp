@@ -1,8 +1,14 @@
 #include "filters.h"
+#include "float_image.h"
+#include "integral_image.h"
+#include "parallel.h"
+#include "stream_pipeline.h"
+
+#include <mutex>
 
 namespace PixelMath {
     PixelArray::Pixel ApplyMatrix(const PixelArray& pixels, size_t row, size_t column,
-                                  Matrix& matrix) {
+                                  const Matrix& matrix) {
         PixelArray::Pixel new_pixel = PixelArray::Pixel();
         size_t matrix_vertical_radius = matrix.size() / 2; // расстояние от центра матрицы к вертикальному краю
         size_t matrix_horizontal_radius = matrix[0].size() / 2; // расстояние от центра матрицы к горизонтальному краю
@@ -30,6 +36,28 @@ namespace PixelMath {
         return new_pixel;
     }
 
+    void ConvolveRow(const PixelArray::Pixel* row, size_t width, const std::vector<double>& kernel,
+                     BorderMode border, std::vector<PixelArray::Pixel>& padded, PixelArray::Pixel* out) {
+        int64_t radius = static_cast<int64_t>(kernel.size() / 2);
+        padded.resize(width + kernel.size() - 1);
+        Border::PadRow(row, static_cast<int64_t>(width), -radius, static_cast<int64_t>(width) + radius, border,
+                       padded.data());
+        for (size_t j = 0; j < width; ++j) {
+            const PixelArray::Pixel* taps = &padded[j];
+            double red = 0;
+            double green = 0;
+            double blue = 0;
+            for (size_t k = 0; k < kernel.size(); ++k) {
+                red += kernel[k] * taps[k].red;
+                green += kernel[k] * taps[k].green;
+                blue += kernel[k] * taps[k].blue;
+            }
+            out[j].red = std::min(255, std::max(0, int(std::round(red))));
+            out[j].green = std::min(255, std::max(0, int(std::round(green))));
+            out[j].blue = std::min(255, std::max(0, int(std::round(blue))));
+        }
+    }
+
     Matrix TransposeMatrix(const Matrix& matrix) {
         size_t matrix_height = matrix.size();
         size_t matrix_width = matrix[0].size();
@@ -46,30 +74,145 @@ namespace PixelMath {
         }
         return result;
     }
+
+    PixelArray BoxReduce(const PixelArray& pixels, size_t factor_y, size_t factor_x) {
+        size_t height = pixels.GetHeight();
+        size_t new_height = (height + factor_y - 1) / factor_y;
+        size_t new_width = (pixels.GetWidth() + factor_x - 1) / factor_x;
+        PixelArray result(new_height, new_width);
+        for (size_t i = 0; i < new_height; ++i) {
+            size_t first_row = i * factor_y;
+            BoxReduceRow(pixels, first_row, std::min(factor_y, height - first_row), factor_x, &result(i, 0));
+        }
+        return result;
+    }
+
+    void BoxReduceRow(const PixelArray& pixels, size_t first_row, size_t row_count, size_t factor_x,
+                      PixelArray::Pixel* out) {
+        size_t width = pixels.GetWidth();
+        size_t new_width = (width + factor_x - 1) / factor_x;
+        std::vector<uint64_t> sums(new_width * 3);
+        for (size_t i = first_row; i < first_row + row_count; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                const PixelArray::Pixel& current_pixel = pixels(i, j);
+                uint64_t* current_sum = &sums[j / factor_x * 3];
+                current_sum[0] += current_pixel.red;
+                current_sum[1] += current_pixel.green;
+                current_sum[2] += current_pixel.blue;
+            }
+        }
+        for (size_t j = 0; j < new_width; ++j) {
+            uint64_t count = row_count * (std::min(width, (j + 1) * factor_x) - j * factor_x);
+            out[j].red = (sums[j * 3] + count / 2) / count;
+            out[j].green = (sums[j * 3 + 1] + count / 2) / count;
+            out[j].blue = (sums[j * 3 + 2] + count / 2) / count;
+        }
+    }
+
+    PixelArray Transpose(const PixelArray& pixels) {
+        size_t height = pixels.GetHeight();
+        size_t width = pixels.GetWidth();
+        PixelArray result(width, height);
+        Parallel::ForBands(0, width, [&](size_t band_begin, size_t band_end) {
+            for (size_t block_column = band_begin; block_column < band_end; block_column += TRANSPOSE_BLOCK) {
+                size_t column_end = std::min(block_column + TRANSPOSE_BLOCK, band_end);
+                for (size_t block_row = 0; block_row < height; block_row += TRANSPOSE_BLOCK) {
+                    size_t row_end = std::min(block_row + TRANSPOSE_BLOCK, height);
+                    for (size_t j = block_column; j < column_end; ++j) {
+                        for (size_t i = block_row; i < row_end; ++i) {
+                            result(j, i) = pixels(i, j);
+                        }
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    void FlipVertical(PixelArray& pixels) {
+        size_t height = pixels.GetHeight();
+        size_t width = pixels.GetWidth();
+        Parallel::ForBands(0, height / 2, [&](size_t band_begin, size_t band_end) {
+            for (size_t i = band_begin; i < band_end; ++i) {
+                std::swap_ranges(&pixels(i, 0), &pixels(i, 0) + width, &pixels(height - 1 - i, 0));
+            }
+        });
+    }
+
+    void FlipHorizontal(PixelArray& pixels) {
+        size_t width = pixels.GetWidth();
+        Parallel::ForBands(0, pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            for (size_t i = band_begin; i < band_end; ++i) {
+                std::reverse(&pixels(i, 0), &pixels(i, 0) + width);
+            }
+        });
+    }
 }
 
 void GaussianBlurFilter::Apply(Bitmap& image) {
     PixelArray& image_pixels = image.GetPixels();
-    PixelArray new_pixels = image_pixels;
-    PixelArray::Pixel current_pixel{};
-    for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = PixelMath::ApplyMatrix(image_pixels, i, j, matrix_);
-            new_pixels(i, j) = current_pixel;
-        }
+    auto horizontal_pass = [this](const PixelArray& pixels) {
+        PixelArray result(pixels.GetHeight(), pixels.GetWidth());
+        Parallel::ForBands(0, pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            std::vector<PixelArray::Pixel> padded;
+            for (size_t i = band_begin; i < band_end; ++i) {
+                PixelMath::ConvolveRow(&pixels(i, 0), pixels.GetWidth(), matrix_[0], border_, padded, &result(i, 0));
+            }
+        });
+        return result;
+    };
+    // Вертикальный проход -- тот же горизонтальный над транспонированным изображением
+    PixelArray transposed = PixelMath::Transpose(horizontal_pass(image_pixels));
+    image_pixels = PixelMath::Transpose(horizontal_pass(transposed));
+}
+
+void GaussianBlurFilter::ApplyPrecise(FloatImage& image) {
+    std::vector<float> kernel(matrix_[0].begin(), matrix_[0].end());
+    image = FloatMath::ConvolveSeparable(image, kernel, border_);
+}
+
+bool GaussianBlurFilter::AddStreamStages(StreamPipeline& sp) const {
+    // Окно потоковой стадии за краями изображения повторяет крайние строки
+    if (border_ != BorderMode::CLAMP) {
+        return false;
     }
-    image_pixels = new_pixels;
-    PixelMath::Matrix transposed_matrix = PixelMath::TransposeMatrix(matrix_);
-    for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = PixelMath::ApplyMatrix(image_pixels, i, j, transposed_matrix);
-            new_pixels(i, j) = current_pixel;
+    sp.AddStage(new RowStreamStage([this, padded = std::vector<PixelArray::Pixel>()]
+    (const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) mutable {
+        PixelMath::ConvolveRow(in, width, matrix_[0], border_, padded, out);
+    }));
+    const std::vector<double>& kernel = matrix_[0];
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(kernel.size() / 2, [kernel]
+    (const PixelArray& window, size_t, PixelArray::Pixel* out) {
+        for (size_t j = 0; j < window.GetWidth(); ++j) {
+            double red = 0;
+            double green = 0;
+            double blue = 0;
+            for (size_t k = 0; k < kernel.size(); ++k) {
+                red += kernel[k] * window(k, j).red;
+                green += kernel[k] * window(k, j).green;
+                blue += kernel[k] * window(k, j).blue;
+            }
+            out[j].red = std::min(255, std::max(0, int(std::round(red))));
+            out[j].green = std::min(255, std::max(0, int(std::round(green))));
+            out[j].blue = std::min(255, std::max(0, int(std::round(blue))));
         }
+    }));
+    return true;
+}
+
+std::optional<Region> GaussianBlurFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    // При периодическом продолжении краевым пикселям нужен противоположный край изображения
+    if (border_ == BorderMode::WRAP) {
+        return std::nullopt;
     }
-    image_pixels = new_pixels;
+    return output.Expand(matrix_[0].size() / 2, width, height);
 }
 
 void GaussianBlurFilter::GenerateMatrix(double sigma) {
+    matrix_.push_back(MakeKernel(sigma));
+}
+
+std::vector<double> GaussianBlurFilter::MakeKernel(double sigma) {
     // Пиксели на расстоянии более 3σ оказывают достаточно малое влияние, можно не считать
     size_t matrix_radius = std::ceil(sigma * 3);
     size_t matrix_size = matrix_radius * 2 + 1;
@@ -91,7 +234,7 @@ void GaussianBlurFilter::GenerateMatrix(double sigma) {
     for (double& i : matrix_row) {
         i /= matrix_sum;
     }
-    matrix_.push_back(matrix_row);
+    return matrix_row;
 }
 
 void CropFilter::Apply(Bitmap& image) {
@@ -104,87 +247,208 @@ void CropFilter::Apply(Bitmap& image) {
     if (height_ > image_height) {
         height_ = image_height;
     }
-    RotateImage(image_pixels);
-    image_pixels.Resize(height_, width_);
-    RotateImage(image_pixels);
+    // Обрезка оставляет верхние строки изображения, а в PixelArray они хранятся последними
+    CutRegion(image_pixels, Region{image_height - height_, 0, height_, width_});
 }
 
-void CropFilter::RotateImage(PixelArray& pixels) {
-    for (size_t i = 0; i < pixels.GetHeight() / 2; ++i) {
-        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
-            std::swap(pixels(i, j), pixels(pixels.GetHeight() - i - 1, j));
-        }
-    }
+bool CropFilter::AddStreamStages(StreamPipeline& sp) const {
+    sp.AddStage(new CropStreamStage(width_, height_));
+    return true;
+}
+
+BaseFilter::Size CropFilter::GetOutputSize(size_t width, size_t height) const {
+    return {std::min(width_, width), std::min(height_, height)};
+}
+
+std::optional<Region> CropFilter::GetInputRegion(const Region& output, size_t /*width*/, size_t height) const {
+    // Обрезка оставляет верхние строки изображения, а в PixelArray они хранятся последними
+    Region input = output;
+    input.row += height - std::min(height_, height);
+    return input;
+}
+
+void CropFilter::ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                               size_t height) {
+    std::optional<Region> needed = GetInputRegion(output, width, height);
+    CutRegion(image.GetPixels(), Region{needed->row - input.row, needed->column - input.column,
+                                        needed->height, needed->width});
+}
+
+void CropFilter::ApplyPrecise(FloatImage& image) {
+    width_ = std::min(width_, image.GetWidth());
+    height_ = std::min(height_, image.GetHeight());
+    image.Cut(Region{image.GetHeight() - height_, 0, height_, width_});
+}
+
+void CropFilter::ApplyPreciseToRegion(FloatImage& image, const Region& input, const Region& output, size_t width,
+                                      size_t height) {
+    std::optional<Region> needed = GetInputRegion(output, width, height);
+    image.Cut(Region{needed->row - input.row, needed->column - input.column, needed->height, needed->width});
 }
 
 void NegativeFilter::Apply(Bitmap& image) {
     PixelArray& image_pixels = image.GetPixels();
-    PixelArray::Pixel current_pixel{};
     for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = image_pixels(i, j);
-            current_pixel.red = 255 - current_pixel.red;
-            current_pixel.green = 255 - current_pixel.green;
-            current_pixel.blue = 255 - current_pixel.blue;
-            image_pixels(i, j) = current_pixel;
+        ApplyToRow(&image_pixels(i, 0), image_pixels.GetWidth());
+    }
+}
+
+bool NegativeFilter::AddStreamStages(StreamPipeline& sp) const {
+    sp.AddStage(new RowStreamStage([](const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) {
+        std::copy(in, in + width, out);
+        ApplyToRow(out, width);
+    }));
+    return true;
+}
+
+std::optional<Region> NegativeFilter::GetInputRegion(const Region& output, size_t, size_t) const {
+    return output;
+}
+
+void NegativeFilter::ApplyPrecise(FloatImage& image) {
+    size_t channels = image.GetWidth() * FloatImage::CHANNELS;
+    for (size_t i = 0; i < image.GetHeight(); ++i) {
+        float* row = image.GetChannels(i);
+        for (size_t c = 0; c < channels; ++c) {
+            row[c] = 255 - row[c];
+        }
+    }
+}
+
+void NegativeFilter::ApplyToRow(PixelArray::Pixel* row, size_t width) {
+    for (size_t j = 0; j < width; ++j) {
+        row[j].red = 255 - row[j].red;
+        row[j].green = 255 - row[j].green;
+        row[j].blue = 255 - row[j].blue;
+    }
+}
+
+void BrightnessFilter::ToGrayscaleRow(PixelArray::Pixel* row, size_t width) const {
+    uint8_t current_grayscale;
+    for (size_t j = 0; j < width; ++j) {
+        current_grayscale = GetGrayscale(row[j]);
+        row[j].red = current_grayscale;
+        row[j].green = current_grayscale;
+        row[j].blue = current_grayscale;
+    }
+}
+
+void BrightnessFilter::ToGrayscalePrecise(FloatImage& image) const {
+    for (size_t i = 0; i < image.GetHeight(); ++i) {
+        float* row = image.GetChannels(i);
+        for (size_t j = 0; j < image.GetWidth(); ++j) {
+            float* pixel = row + j * FloatImage::CHANNELS;
+            float value = static_cast<float>(RED_COEF) * pixel[0] + static_cast<float>(GREEN_COEF) * pixel[1] +
+                          static_cast<float>(BLUE_COEF) * pixel[2];
+            std::fill(pixel, pixel + FloatImage::CHANNELS, value);
         }
     }
 }
 
 void GrayscaleFilter::Apply(Bitmap& image) {
     PixelArray& image_pixels = image.GetPixels();
-    PixelArray::Pixel current_pixel{};
-    uint8_t current_grayscale;
     for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = image_pixels(i, j);
-            current_grayscale = GetGrayscale(current_pixel);
-            current_pixel.red = current_grayscale;
-            current_pixel.green = current_grayscale;
-            current_pixel.blue = current_grayscale;
-            image_pixels(i, j) = current_pixel;
-        }
+        ToGrayscaleRow(&image_pixels(i, 0), image_pixels.GetWidth());
     }
 }
 
+bool GrayscaleFilter::AddStreamStages(StreamPipeline& sp) const {
+    sp.AddStage(new RowStreamStage([this](const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) {
+        std::copy(in, in + width, out);
+        ToGrayscaleRow(out, width);
+    }));
+    return true;
+}
+
+std::optional<Region> GrayscaleFilter::GetInputRegion(const Region& output, size_t, size_t) const {
+    return output;
+}
+
+void GrayscaleFilter::ApplyPrecise(FloatImage& image) {
+    ToGrayscalePrecise(image);
+}
+
 void SharpeningFilter::Apply(Bitmap& image) {
     PixelArray& image_pixels = image.GetPixels();
-    PixelArray new_pixels = image_pixels;
-    PixelArray::Pixel current_pixel{};
-    for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = GetSharpenPixel(image_pixels, i, j);
-            new_pixels(i, j) = current_pixel;
-        }
+    image_pixels = FixedKernel::Apply<KERNEL>(image_pixels, border_);
+}
+
+bool SharpeningFilter::AddStreamStages(StreamPipeline& sp) const {
+    if (border_ != BorderMode::CLAMP) {
+        return false;
+    }
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(KERNEL.HEIGHT / 2, []
+    (const PixelArray& window, size_t, PixelArray::Pixel* out) {
+        FixedKernel::ApplyRow<KERNEL>(window, KERNEL.HEIGHT / 2, out);
+    }));
+    return true;
+}
+
+std::optional<Region> SharpeningFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    if (border_ == BorderMode::WRAP) {
+        return std::nullopt;
     }
-    image_pixels = new_pixels;
+    return output.Expand(KERNEL.HEIGHT / 2, width, height);
 }
 
-PixelArray::Pixel SharpeningFilter::GetSharpenPixel(PixelArray& pixels, size_t i, size_t j) {
-    return PixelMath::ApplyMatrix(pixels, i, j, matrix_);
+void SharpeningFilter::ApplyPrecise(FloatImage& image) {
+    image = FloatMath::Convolve(image, FloatMath::ToKernel(KERNEL), border_);
 }
 
 void EdgeDetectionFilter::Apply(Bitmap& image) {
-    GrayscaleFilter::Apply(image);
     PixelArray& image_pixels = image.GetPixels();
-    PixelArray new_pixels = image_pixels;
-    PixelArray::Pixel current_pixel{};
     for (size_t i = 0; i < image_pixels.GetHeight(); ++i) {
-        for (size_t j = 0; j < image_pixels.GetWidth(); ++j) {
-            current_pixel = PixelMath::ApplyMatrix(image_pixels, i, j, matrix_);
-            if (static_cast<double>(current_pixel.red) / 255 > threshold_) {
-                current_pixel.red = 255;
-                current_pixel.green = 255;
-                current_pixel.blue = 255;
-            } else {
-                current_pixel.red = 0;
-                current_pixel.green = 0;
-                current_pixel.blue = 0;
-            }
-            new_pixels(i, j) = current_pixel;
+        ToGrayscaleRow(&image_pixels(i, 0), image_pixels.GetWidth());
+    }
+    PixelArray new_pixels = FixedKernel::Apply<KERNEL>(image_pixels, border_);
+    for (size_t i = 0; i < new_pixels.GetHeight(); ++i) {
+        ApplyThreshold(&new_pixels(i, 0), new_pixels.GetWidth());
+    }
+    image_pixels = std::move(new_pixels);
+}
+
+bool EdgeDetectionFilter::AddStreamStages(StreamPipeline& sp) const {
+    if (border_ != BorderMode::CLAMP) {
+        return false;
+    }
+    sp.AddStage(new RowStreamStage([this](const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) {
+        std::copy(in, in + width, out);
+        ToGrayscaleRow(out, width);
+    }));
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(KERNEL.HEIGHT / 2, [this]
+    (const PixelArray& window, size_t, PixelArray::Pixel* out) {
+        FixedKernel::ApplyRow<KERNEL>(window, KERNEL.HEIGHT / 2, out);
+        ApplyThreshold(out, window.GetWidth());
+    }));
+    return true;
+}
+
+std::optional<Region> EdgeDetectionFilter::GetInputRegion(const Region& output, size_t width,
+                                                          size_t height) const {
+    if (border_ == BorderMode::WRAP) {
+        return std::nullopt;
+    }
+    return output.Expand(KERNEL.HEIGHT / 2, width, height);
+}
+
+void EdgeDetectionFilter::ApplyThreshold(PixelArray::Pixel* row, size_t width) const {
+    for (size_t j = 0; j < width; ++j) {
+        uint8_t value = static_cast<double>(row[j].red) / 255 > threshold_ ? 255 : 0;
+        row[j] = PixelArray::Pixel{value, value, value};
+    }
+}
+
+void EdgeDetectionFilter::ApplyPrecise(FloatImage& image) {
+    ToGrayscalePrecise(image);
+    image = FloatMath::Convolve(image, FloatMath::ToKernel(KERNEL), border_);
+    for (size_t i = 0; i < image.GetHeight(); ++i) {
+        float* row = image.GetChannels(i);
+        for (size_t j = 0; j < image.GetWidth(); ++j) {
+            float* pixel = row + j * FloatImage::CHANNELS;
+            float value = static_cast<double>(pixel[0]) / 255 > threshold_ ? 255 : 0;
+            std::fill(pixel, pixel + FloatImage::CHANNELS, value);
         }
     }
-    image_pixels = new_pixels;
 }
 
 void LanczosScaleFilter::Apply(Bitmap& image) {
@@ -196,26 +460,108 @@ void LanczosScaleFilter::Apply(Bitmap& image) {
     }
     double delta_x = static_cast<double>(current_width) / static_cast<double>(dest_width_);
     double delta_y = static_cast<double>(current_height) / static_cast<double>(dest_height_);
-    double new_x;
-    double new_y;
-    PixelArray new_width_pixels = PixelArray(current_height, dest_width_);
-    PixelArray::Pixel new_pixel{};
-    for (size_t i = 0; i < current_height; ++i) {
-        for (size_t j = 0; j < dest_width_; ++j) {
-            new_x = (j + 0.5) * delta_x - 0.5;
-            new_pixel = ApplyLanczosX(image_pixels, new_x, alpha_, i);
-            new_width_pixels(i, j) = new_pixel;
-        }
+    size_t factor_x = GetAreaReductionFactor(delta_x);
+    size_t factor_y = GetAreaReductionFactor(delta_y);
+    if (factor_x > 1 || factor_y > 1) {
+        PixelArray reduced_pixels = PixelMath::BoxReduce(image_pixels, factor_y, factor_x);
+        image_pixels = Resample(reduced_pixels, delta_x / factor_x, delta_y / factor_y);
+        return;
     }
-    PixelArray new_pixels = PixelArray(dest_height_, dest_width_);
-    for (size_t i = 0; i < dest_height_; ++i) {
-        for (size_t j = 0; j < dest_width_; ++j) {
-            new_y = (i + 0.5) * delta_y - 0.5;
-            new_pixel = ApplyLanczosY(new_width_pixels, new_y, alpha_, j);
-            new_pixels(i, j) = new_pixel;
-        }
+    image_pixels = Resample(image_pixels, delta_x, delta_y);
+}
+
+BaseFilter::Size LanczosScaleFilter::GetOutputSize(size_t, size_t) const {
+    return {dest_width_, dest_height_};
+}
+
+size_t LanczosScaleFilter::GetAreaReductionFactor(double ratio) {
+    if (ratio < AREA_REDUCTION_MIN_RATIO) {
+        return 1;
     }
-    image_pixels = new_pixels;
+    return static_cast<size_t>(std::floor(ratio));
+}
+
+PixelArray LanczosScaleFilter::Resample(const PixelArray& image_pixels, double delta_x, double delta_y) const {
+    int alpha = static_cast<int>(alpha_);
+    // Проход по строкам pixels до размера size; строка один раз дополняется alpha крайними пикселями
+    // с каждой стороны, и отсчёты считаются без проверок
+    auto resample_rows = [alpha](const PixelArray& pixels, size_t size, double delta) {
+        int64_t width = static_cast<int64_t>(pixels.GetWidth());
+        PixelArray result(pixels.GetHeight(), size);
+        Parallel::ForBands(0, pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            std::vector<PixelArray::Pixel> padded(width + 2 * alpha);
+            for (size_t i = band_begin; i < band_end; ++i) {
+                Border::PadRow(&pixels(i, 0), width, -alpha, width + alpha, BorderMode::CLAMP, padded.data());
+                for (size_t j = 0; j < size; ++j) {
+                    result(i, j) = ApplyLanczos(padded.data(), (j + 0.5) * delta - 0.5, alpha);
+                }
+            }
+        });
+        return result;
+    };
+    PixelArray new_width_pixels = resample_rows(image_pixels, dest_width_, delta_x);
+    // Вертикальный проход выполняется по строкам транспонированного изображения
+    PixelArray new_pixels = resample_rows(PixelMath::Transpose(new_width_pixels), dest_height_, delta_y);
+    return PixelMath::Transpose(new_pixels);
+}
+
+bool LanczosScaleFilter::AddStreamStages(StreamPipeline& sp) const {
+    size_t width = sp.GetWidth();
+    size_t height = sp.GetHeight();
+    if (width == dest_width_ && height == dest_height_) {
+        return true;
+    }
+    int alpha = static_cast<int>(alpha_);
+    double delta_x = static_cast<double>(width) / static_cast<double>(dest_width_);
+    double delta_y = static_cast<double>(height) / static_cast<double>(dest_height_);
+    size_t factor_x = GetAreaReductionFactor(delta_x);
+    size_t factor_y = GetAreaReductionFactor(delta_y);
+    if (factor_x > 1 || factor_y > 1) {
+        sp.AddStage(new WindowStreamStage(factor_y, [factor_y](size_t out_row) {
+            return static_cast<int64_t>(out_row * factor_y);
+        }, [factor_x, factor_y, height](const PixelArray& window, size_t out_row, PixelArray::Pixel* out) {
+            PixelMath::BoxReduceRow(window, 0, std::min(factor_y, height - out_row * factor_y), factor_x, out);
+        }, (height + factor_y - 1) / factor_y, (width + factor_x - 1) / factor_x));
+        delta_x /= static_cast<double>(factor_x);
+        delta_y /= static_cast<double>(factor_y);
+    }
+    size_t dest_width = dest_width_;
+    sp.AddStage(new RowStreamStage([alpha, delta_x, dest_width, padded = std::vector<PixelArray::Pixel>()]
+    (const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) mutable {
+        int64_t row_width = static_cast<int64_t>(width);
+        padded.resize(width + 2 * alpha);
+        Border::PadRow(in, row_width, -alpha, row_width + alpha, BorderMode::CLAMP, padded.data());
+        for (size_t j = 0; j < dest_width; ++j) {
+            out[j] = ApplyLanczos(padded.data(), (j + 0.5) * delta_x - 0.5, alpha);
+        }
+    }, dest_width));
+    // Для выходной строки с координатой y нужны входные строки floor(y) - alpha + 1 ... floor(y) + alpha
+    WindowStreamStage::FirstRowFunction first_row = [alpha, delta_y](size_t out_row) {
+        return static_cast<int64_t>(std::floor((out_row + 0.5) * delta_y - 0.5)) - alpha + 1;
+    };
+    // Строки за краем изображения окно уже заменило крайними, так что веса строк окна считаются один раз
+    // на строку и применяются ко всем столбцам без проверок
+    sp.AddStage(new WindowStreamStage(alpha * 2, first_row, [alpha, delta_y, first_row, weights = std::vector<double>()]
+    (const PixelArray& window, size_t out_row, PixelArray::Pixel* out) mutable {
+        double window_y = (out_row + 0.5) * delta_y - 0.5 - static_cast<double>(first_row(out_row));
+        weights.resize(window.GetHeight());
+        for (size_t k = 0; k < window.GetHeight(); ++k) {
+            weights[k] = Lanczos(window_y - static_cast<double>(k), alpha);
+        }
+        for (size_t j = 0; j < window.GetWidth(); ++j) {
+            double red = 0;
+            double green = 0;
+            double blue = 0;
+            for (size_t k = 0; k < window.GetHeight(); ++k) {
+                const PixelArray::Pixel& pixel = window(k, j);
+                red += pixel.red * weights[k];
+                green += pixel.green * weights[k];
+                blue += pixel.blue * weights[k];
+            }
+            out[j] = PixelArray::Pixel{ToLanczosChannel(red), ToLanczosChannel(green), ToLanczosChannel(blue)};
+        }
+    }, dest_height_));
+    return true;
 }
 
 double LanczosScaleFilter::sinc(double x) {
@@ -233,49 +579,1282 @@ double LanczosScaleFilter::Lanczos(double x, int alpha) {
     return 0;
 }
 
-PixelArray::Pixel LanczosScaleFilter::ApplyLanczosX(const PixelArray& image_pixels, double x, int alpha, size_t row) {
+uint8_t LanczosScaleFilter::ToLanczosChannel(double value) {
+    return static_cast<uint8_t>(std::max(0, std::min(255, static_cast<int>(std::round(value)))));
+}
+
+PixelArray::Pixel LanczosScaleFilter::ApplyLanczos(const PixelArray::Pixel* padded, double x, int alpha) {
     int start = std::floor(x) - alpha + 1;
     int end = std::floor(x) + alpha + 1;
-    PixelArray::Pixel current_pixel{};
-    PixelArray::Pixel new_pixel{};
-    int width = image_pixels.GetWidth();
     double red = 0;
     double green = 0;
     double blue = 0;
-    double current_lanczos;
     for (int i = start; i < end; ++i) {
-        current_pixel = image_pixels(row, std::clamp(i, 0, width - 1));
-        current_lanczos = Lanczos(x - i, alpha);
+        const PixelArray::Pixel& current_pixel = padded[i + alpha];
+        double current_lanczos = Lanczos(x - i, alpha);
         red += current_pixel.red * current_lanczos;
         green += current_pixel.green * current_lanczos;
         blue += current_pixel.blue * current_lanczos;
     }
-    new_pixel.red = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(red)))));
-    new_pixel.green = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(green)))));
-    new_pixel.blue = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(blue)))));
-    return new_pixel;
+    return PixelArray::Pixel{ToLanczosChannel(red), ToLanczosChannel(green), ToLanczosChannel(blue)};
 }
 
-PixelArray::Pixel LanczosScaleFilter::ApplyLanczosY(const PixelArray& image_pixels, double y, int alpha, size_t column) {
-    int start = std::floor(y) - alpha + 1;
-    int end = std::floor(y) + alpha + 1;
-    PixelArray::Pixel current_pixel{};
-    PixelArray::Pixel new_pixel{};
-    int height = image_pixels.GetHeight();
-    double red = 0;
-    double green = 0;
-    double blue = 0;
-    double current_lanczos;
-    for (int i = start; i < end; ++i) {
-        current_pixel = image_pixels(std::clamp(i, 0, height - 1), column);
-        current_lanczos = Lanczos(y - i, alpha);
-        red += current_pixel.red * current_lanczos;
-        green += current_pixel.green * current_lanczos;
-        blue += current_pixel.blue * current_lanczos;
+
+void MedianFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    int64_t height = static_cast<int64_t>(image_pixels.GetHeight());
+    size_t width = image_pixels.GetWidth();
+    int64_t radius = static_cast<int64_t>(radius_);
+    PixelArray new_pixels(image_pixels.GetHeight(), width);
+    auto row = [&image_pixels, height](int64_t i) {
+        return &image_pixels(std::clamp<int64_t>(i, 0, height - 1), 0);
+    };
+    Parallel::ForBands(0, image_pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+        ColumnHistograms histograms(width, radius_);
+        int64_t begin = static_cast<int64_t>(band_begin);
+        for (int64_t i = begin - radius; i <= begin + radius; ++i) {
+            histograms.AddRow(row(i));
+        }
+        for (int64_t i = begin; i < static_cast<int64_t>(band_end); ++i) {
+            if (i > begin) {
+                histograms.RemoveRow(row(i - radius - 1));
+                histograms.AddRow(row(i + radius));
+            }
+            histograms.ComputeRow(&new_pixels(i, 0));
+        }
+    });
+    image_pixels = std::move(new_pixels);
+}
+
+bool MedianFilter::AddStreamStages(StreamPipeline& sp) const {
+    // Гистограммы столбцов переходят от строки к строке: из них вычитается строка, вышедшая из окна,
+    // и прибавляется новая
+    size_t radius = radius_;
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(radius, [radius, histograms = ColumnHistograms(0, radius),
+                                                             first_row = RowSink::Row()]
+    (const PixelArray& window, size_t out_row, PixelArray::Pixel* out) mutable {
+        size_t width = window.GetWidth();
+        if (out_row == 0) {
+            histograms = ColumnHistograms(width, radius);
+            for (size_t i = 0; i < window.GetHeight(); ++i) {
+                histograms.AddRow(&window(i, 0));
+            }
+        } else {
+            histograms.RemoveRow(first_row.data());
+            histograms.AddRow(&window(window.GetHeight() - 1, 0));
+        }
+        first_row.assign(&window(0, 0), &window(0, 0) + width);
+        histograms.ComputeRow(out);
+    }));
+    return true;
+}
+
+std::optional<Region> MedianFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    return output.Expand(radius_, width, height);
+}
+
+MedianFilter::ColumnHistograms::ColumnHistograms(size_t width, size_t radius)
+: width_(width), radius_(radius), fine_(width * CHANNELS * LEVELS), coarse_(width * CHANNELS * COARSE_LEVELS),
+  kernel_fine_(CHANNELS * LEVELS), kernel_coarse_(CHANNELS * COARSE_LEVELS),
+  kernel_fine_column_(CHANNELS * COARSE_LEVELS) {}
+
+void MedianFilter::ColumnHistograms::AddRow(const PixelArray::Pixel* row) {
+    UpdateRow(row, 1);
+}
+
+void MedianFilter::ColumnHistograms::RemoveRow(const PixelArray::Pixel* row) {
+    UpdateRow(row, -1);
+}
+
+void MedianFilter::ColumnHistograms::UpdateRow(const PixelArray::Pixel* row, int delta) {
+    for (size_t j = 0; j < width_; ++j) {
+        const uint8_t values[CHANNELS] = {row[j].red, row[j].green, row[j].blue};
+        for (size_t c = 0; c < CHANNELS; ++c) {
+            fine_[(j * CHANNELS + c) * LEVELS + values[c]] += delta;
+            coarse_[(j * CHANNELS + c) * COARSE_LEVELS + values[c] / COARSE_LEVELS] += delta;
+        }
+    }
+}
+
+size_t MedianFilter::ColumnHistograms::ClampColumn(int64_t column) const {
+    return static_cast<size_t>(std::clamp<int64_t>(column, 0, static_cast<int64_t>(width_) - 1));
+}
+
+void MedianFilter::ColumnHistograms::UpdateKernelCoarse(size_t column, int sign) {
+    const uint16_t* coarse = &coarse_[column * CHANNELS * COARSE_LEVELS];
+    for (size_t k = 0; k < CHANNELS * COARSE_LEVELS; ++k) {
+        kernel_coarse_[k] += sign * coarse[k];
+    }
+}
+
+void MedianFilter::ColumnHistograms::SyncKernelFine(size_t channel, size_t coarse_level, int64_t column) {
+    int64_t radius = static_cast<int64_t>(radius_);
+    int64_t& synced_column = kernel_fine_column_[channel * COARSE_LEVELS + coarse_level];
+    uint16_t* kernel = &kernel_fine_[channel * LEVELS + coarse_level * COARSE_LEVELS];
+    auto segment = [this, channel, coarse_level](int64_t j) {
+        return &fine_[(ClampColumn(j) * CHANNELS + channel) * LEVELS + coarse_level * COARSE_LEVELS];
+    };
+    // Участок давно не обновлялся: проще собрать его заново, чем сдвигать
+    if (column - synced_column > 2 * radius + 1) {
+        std::fill(kernel, kernel + COARSE_LEVELS, 0);
+        for (int64_t j = column - radius; j <= column + radius; ++j) {
+            const uint16_t* added = segment(j);
+            for (size_t k = 0; k < COARSE_LEVELS; ++k) {
+                kernel[k] += added[k];
+            }
+        }
+    } else {
+        for (int64_t j = synced_column + 1; j <= column; ++j) {
+            const uint16_t* added = segment(j + radius);
+            const uint16_t* removed = segment(j - radius - 1);
+            for (size_t k = 0; k < COARSE_LEVELS; ++k) {
+                kernel[k] += added[k] - removed[k];
+            }
+        }
+    }
+    synced_column = column;
+}
+
+uint8_t MedianFilter::ColumnHistograms::FindMedian(size_t channel, int64_t column) {
+    size_t side = 2 * radius_ + 1;
+    size_t rank = side * side / 2; // число значений, меньших медианы
+    const uint16_t* coarse = &kernel_coarse_[channel * COARSE_LEVELS];
+    size_t coarse_level = 0;
+    while (rank >= coarse[coarse_level]) {
+        rank -= coarse[coarse_level];
+        ++coarse_level;
+    }
+    SyncKernelFine(channel, coarse_level, column);
+    const uint16_t* fine = &kernel_fine_[channel * LEVELS + coarse_level * COARSE_LEVELS];
+    size_t fine_level = 0;
+    while (rank >= fine[fine_level]) {
+        rank -= fine[fine_level];
+        ++fine_level;
+    }
+    return static_cast<uint8_t>(coarse_level * COARSE_LEVELS + fine_level);
+}
+
+void MedianFilter::ColumnHistograms::ComputeRow(PixelArray::Pixel* out) {
+    int64_t radius = static_cast<int64_t>(radius_);
+    int64_t last_column = static_cast<int64_t>(width_) - 1;
+    std::fill(kernel_coarse_.begin(), kernel_coarse_.end(), 0);
+    // Участки точной гистограммы будут собраны заново при первом обращении
+    std::fill(kernel_fine_column_.begin(), kernel_fine_column_.end(), -2 * radius - 2);
+    for (int64_t j = -radius; j <= radius; ++j) {
+        UpdateKernelCoarse(ClampColumn(j), 1);
+    }
+    for (int64_t j = 0; j <= last_column; ++j) {
+        out[j].red = FindMedian(0, j);
+        out[j].green = FindMedian(1, j);
+        out[j].blue = FindMedian(2, j);
+        if (j < last_column) {
+            UpdateKernelCoarse(ClampColumn(j + radius + 1), 1);
+            UpdateKernelCoarse(ClampColumn(j - radius), -1);
+        }
+    }
+}
+
+BilateralFilter::GridLayout BilateralFilter::GetGridLayout(size_t height, size_t width) const {
+    size_t max_cells = std::max(MIN_GRID_CELLS, height * width / PIXELS_PER_GRID_CELL);
+    // Лишняя ячейка по каждой оси нужна для интерполяции у правого края
+    auto make_layout = [height, width](double spatial_step, double range_step) {
+        size_t grid_height = static_cast<size_t>((height - 1) / spatial_step) + 2;
+        size_t grid_width = static_cast<size_t>((width - 1) / spatial_step) + 2;
+        size_t grid_depth = static_cast<size_t>(255 / range_step) + 2;
+        return GridLayout{spatial_step, range_step, grid_height * grid_width * grid_depth};
+    };
+    GridLayout layout = make_layout(sigma_s_, sigma_r_);
+    // Сетка 2 x 2 x 2 меньше MIN_GRID_CELLS, так что цикл конечен
+    for (double scale = 1.25; layout.cells > max_cells; scale *= 1.25) {
+        layout = make_layout(sigma_s_ * scale, sigma_r_ * scale);
+    }
+    return layout;
+}
+
+void BilateralFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    size_t height = image_pixels.GetHeight();
+    size_t width = image_pixels.GetWidth();
+    if (height == 0 || width == 0) {
+        return;
+    }
+    GridLayout layout = GetGridLayout(height, width);
+    double spatial_step = layout.spatial_step;
+    double range_step = layout.range_step;
+    Grid grid(static_cast<size_t>((height - 1) / spatial_step) + 2,
+              static_cast<size_t>((width - 1) / spatial_step) + 2, static_cast<size_t>(255 / range_step) + 2);
+    for (size_t i = 0; i < height; ++i) {
+        size_t y = static_cast<size_t>(std::round(i / spatial_step));
+        for (size_t j = 0; j < width; ++j) {
+            const PixelArray::Pixel& pixel = image_pixels(i, j);
+            Cell& cell = grid(y, static_cast<size_t>(std::round(j / spatial_step)),
+                              static_cast<size_t>(std::round(GetGrayscale(pixel) / range_step)));
+            cell.red += pixel.red;
+            cell.green += pixel.green;
+            cell.blue += pixel.blue;
+            cell.weight += 1;
+        }
+    }
+    // Шаги по всем осям увеличены в одно и то же число раз, поэтому sigma в ячейках одинаковая
+    grid.Blur(GaussianBlurFilter::MakeKernel(sigma_s_ / spatial_step));
+    auto to_channel = [](float value) {
+        return static_cast<uint8_t>(std::clamp(static_cast<int>(std::round(value)), 0, 255));
+    };
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                PixelArray::Pixel& pixel = image_pixels(i, j);
+                Cell cell = grid.Interpolate(i / spatial_step, j / spatial_step, GetGrayscale(pixel) / range_step);
+                // Ячейка самого пикселя -- одна из 8 ячеек интерполяции, и её вес после размытия не нулевой
+                pixel.red = to_channel(cell.red / cell.weight);
+                pixel.green = to_channel(cell.green / cell.weight);
+                pixel.blue = to_channel(cell.blue / cell.weight);
+            }
+        }
+    });
+}
+
+void BilateralFilter::Grid::Blur(const std::vector<double>& kernel) {
+    // По глубине и ширине строки сетки независимы, по высоте -- столбцы
+    Parallel::ForBands(0, height_, [this, &kernel](size_t band_begin, size_t band_end) {
+        std::vector<Cell> buffer;
+        for (size_t y = band_begin; y < band_end; ++y) {
+            for (size_t x = 0; x < width_; ++x) {
+                BlurLine(&(*this)(y, x, 0), depth_, 1, kernel, buffer);
+            }
+            for (size_t z = 0; z < depth_; ++z) {
+                BlurLine(&(*this)(y, 0, z), width_, depth_, kernel, buffer);
+            }
+        }
+    });
+    Parallel::ForBands(0, width_, [this, &kernel](size_t band_begin, size_t band_end) {
+        std::vector<Cell> buffer;
+        for (size_t x = band_begin; x < band_end; ++x) {
+            for (size_t z = 0; z < depth_; ++z) {
+                BlurLine(&(*this)(0, x, z), height_, width_ * depth_, kernel, buffer);
+            }
+        }
+    });
+}
+
+void BilateralFilter::Grid::BlurLine(Cell* first, size_t size, size_t stride, const std::vector<double>& kernel,
+                                     std::vector<Cell>& buffer) {
+    int64_t radius = static_cast<int64_t>(kernel.size() / 2);
+    int64_t line_size = static_cast<int64_t>(size);
+    buffer.assign(size, Cell());
+    for (int64_t i = 0; i < line_size; ++i) {
+        const Cell& cell = first[i * stride];
+        if (cell.weight == 0) {
+            continue;
+        }
+        // Ячейка разносится по соседям; пустые ячейки (их в сетке большинство) пропускаются
+        for (int64_t k = std::max<int64_t>(0, i - radius); k <= std::min(line_size - 1, i + radius); ++k) {
+            float weight = static_cast<float>(kernel[k - i + radius]);
+            buffer[k].red += weight * cell.red;
+            buffer[k].green += weight * cell.green;
+            buffer[k].blue += weight * cell.blue;
+            buffer[k].weight += weight * cell.weight;
+        }
+    }
+    for (size_t i = 0; i < size; ++i) {
+        first[i * stride] = buffer[i];
     }
-    new_pixel.red = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(red)))));
-    new_pixel.green = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(green)))));
-    new_pixel.blue = static_cast<size_t>(std::max(0, std::min(255, static_cast<int>(std::round(blue)))));
-    return new_pixel;
 }
 
+BilateralFilter::Cell BilateralFilter::Grid::Interpolate(double y, double x, double z) const {
+    size_t y0 = static_cast<size_t>(y);
+    size_t x0 = static_cast<size_t>(x);
+    size_t z0 = static_cast<size_t>(z);
+    float dy = static_cast<float>(y - y0);
+    float dx = static_cast<float>(x - x0);
+    float dz = static_cast<float>(z - z0);
+    Cell result;
+    for (size_t k = 0; k < 8; ++k) {
+        size_t ky = k & 1;
+        size_t kx = (k >> 1) & 1;
+        size_t kz = (k >> 2) & 1;
+        float weight = (ky ? dy : 1 - dy) * (kx ? dx : 1 - dx) * (kz ? dz : 1 - dz);
+        const Cell& cell = (*this)(y0 + ky, x0 + kx, z0 + kz);
+        result.red += weight * cell.red;
+        result.green += weight * cell.green;
+        result.blue += weight * cell.blue;
+        result.weight += weight * cell.weight;
+    }
+    return result;
+}
+
+void UnsharpMaskFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    size_t width = image_pixels.GetWidth();
+    int64_t radius = static_cast<int64_t>(kernel_.size() / 2);
+    PixelArray new_pixels(image_pixels.GetHeight(), width);
+    Parallel::ForBands(0, image_pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+        Row black_row;
+        auto row = [&](int64_t i) {
+            return Border::GetRow(image_pixels, i, border_, black_row);
+        };
+        std::deque<Row> blurred_rows;
+        Row padded;
+        int64_t begin = static_cast<int64_t>(band_begin);
+        for (int64_t i = begin - radius; i <= begin + radius; ++i) {
+            blurred_rows.emplace_back();
+            BlurRow(row(i), width, padded, blurred_rows.back());
+        }
+        for (int64_t i = begin; i < static_cast<int64_t>(band_end); ++i) {
+            if (i > begin) {
+                // Строка, вышедшая из окна, переиспользуется для новой
+                blurred_rows.push_back(std::move(blurred_rows.front()));
+                blurred_rows.pop_front();
+                BlurRow(row(i + radius), width, padded, blurred_rows.back());
+            }
+            SharpenRow(row(i), blurred_rows, &new_pixels(i, 0));
+        }
+    });
+    image_pixels = std::move(new_pixels);
+}
+
+bool UnsharpMaskFilter::AddStreamStages(StreamPipeline& sp) const {
+    if (border_ != BorderMode::CLAMP) {
+        return false;
+    }
+    size_t radius = kernel_.size() / 2;
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(radius, [this, blurred_rows = std::deque<Row>(), padded = Row()]
+    (const PixelArray& window, size_t out_row, PixelArray::Pixel* out) mutable {
+        size_t width = window.GetWidth();
+        if (out_row == 0) {
+            blurred_rows.resize(window.GetHeight());
+            for (size_t i = 0; i < window.GetHeight(); ++i) {
+                BlurRow(&window(i, 0), width, padded, blurred_rows[i]);
+            }
+        } else {
+            blurred_rows.push_back(std::move(blurred_rows.front()));
+            blurred_rows.pop_front();
+            BlurRow(&window(window.GetHeight() - 1, 0), width, padded, blurred_rows.back());
+        }
+        SharpenRow(&window(window.GetHeight() / 2, 0), blurred_rows, out);
+    }));
+    return true;
+}
+
+std::optional<Region> UnsharpMaskFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    if (border_ == BorderMode::WRAP) {
+        return std::nullopt;
+    }
+    return output.Expand(kernel_.size() / 2, width, height);
+}
+
+void UnsharpMaskFilter::BlurRow(const PixelArray::Pixel* row, size_t width, Row& padded, Row& out) const {
+    out.resize(width);
+    PixelMath::ConvolveRow(row, width, kernel_, border_, padded, out.data());
+}
+
+void UnsharpMaskFilter::SharpenRow(const PixelArray::Pixel* row, const std::deque<Row>& blurred_rows,
+                                   PixelArray::Pixel* out) const {
+    auto sharpen = [this](uint8_t value, double blurred) {
+        double difference = value - std::min(255.0, std::max(0.0, std::round(blurred)));
+        if (std::abs(difference) < threshold_) {
+            return value;
+        }
+        return static_cast<uint8_t>(std::min(255, std::max(0, int(std::round(value + amount_ * difference)))));
+    };
+    for (size_t j = 0; j < blurred_rows.front().size(); ++j) {
+        double red = 0;
+        double green = 0;
+        double blue = 0;
+        for (size_t k = 0; k < kernel_.size(); ++k) {
+            const PixelArray::Pixel& pixel = blurred_rows[k][j];
+            red += kernel_[k] * pixel.red;
+            green += kernel_[k] * pixel.green;
+            blue += kernel_[k] * pixel.blue;
+        }
+        out[j].red = sharpen(row[j].red, red);
+        out[j].green = sharpen(row[j].green, green);
+        out[j].blue = sharpen(row[j].blue, blue);
+    }
+}
+
+namespace {
+    static_assert(sizeof(PixelArray::Pixel) == 3, "pixel channels must be packed into 3 bytes");
+
+    // Поэлементный минимум или максимум двух массивов байт
+    void Combine(const uint8_t* lhv, const uint8_t* rhv, uint8_t* out, size_t size, bool is_max) {
+        if (is_max) {
+            for (size_t k = 0; k < size; ++k) {
+                out[k] = std::max(lhv[k], rhv[k]);
+            }
+        } else {
+            for (size_t k = 0; k < size; ++k) {
+                out[k] = std::min(lhv[k], rhv[k]);
+            }
+        }
+    }
+}
+
+void MorphologyFilter::Apply(Bitmap& image) {
+    for (const Step& step : GetSteps()) {
+        ApplyStep(image.GetPixels(), step);
+    }
+}
+
+bool MorphologyFilter::AddStreamStages(StreamPipeline& sp) const {
+    for (const Step& step : GetSteps()) {
+        size_t width = sp.GetWidth();
+        sp.AddStage(new WindowStreamStage(height_, [step](size_t out_row) {
+            return static_cast<int64_t>(out_row) - static_cast<int64_t>(step.anchor_y);
+        }, [this, step, width, vertical = VerticalPass(width * 3, height_, step.is_max),
+            window = std::vector<const uint8_t*>(), row = std::vector<uint8_t>(), prefix = std::vector<uint8_t>(),
+            padded = std::vector<uint8_t>()]
+        (const PixelArray& window_pixels, size_t, PixelArray::Pixel* out) mutable {
+            window.resize(height_);
+            for (size_t k = 0; k < height_; ++k) {
+                window[k] = reinterpret_cast<const uint8_t*>(&window_pixels(k, 0));
+            }
+            row.resize(width * 3);
+            vertical.ComputeRow(window, row.data());
+            ComputeHorizontal(row.data(), width, step, reinterpret_cast<uint8_t*>(out), prefix, padded);
+        }));
+    }
+    return true;
+}
+
+std::optional<Region> MorphologyFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    return output.Expand(std::max(width_, height_) / 2 * GetSteps().size(), width, height);
+}
+
+std::vector<MorphologyFilter::Step> MorphologyFilter::GetSteps() const {
+    // Эрозия берёт окно [x - anchor, x - anchor + size - 1], дилатация -- отражённое окно,
+    // так что открытие и закрытие с чётными размерами элемента тоже корректны
+    Step erode{false, width_ / 2, height_ / 2};
+    Step dilate{true, width_ - 1 - width_ / 2, height_ - 1 - height_ / 2};
+    switch (operation_) {
+        case Operation::ERODE:
+            return {erode};
+        case Operation::DILATE:
+            return {dilate};
+        case Operation::OPEN:
+            return {erode, dilate};
+        case Operation::CLOSE:
+            return {dilate, erode};
+    }
+    return {};
+}
+
+void MorphologyFilter::ApplyStep(PixelArray& pixels, const Step& step) const {
+    int64_t height = static_cast<int64_t>(pixels.GetHeight());
+    size_t width = pixels.GetWidth();
+    PixelArray new_pixels(pixels.GetHeight(), width);
+    Parallel::ForBands(0, pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+        VerticalPass vertical(width * 3, height_, step.is_max);
+        std::vector<const uint8_t*> window(height_);
+        std::vector<uint8_t> row(width * 3);
+        std::vector<uint8_t> prefix;
+        std::vector<uint8_t> padded;
+        for (size_t i = band_begin; i < band_end; ++i) {
+            int64_t first_row = static_cast<int64_t>(i) - static_cast<int64_t>(step.anchor_y);
+            for (size_t k = 0; k < height_; ++k) {
+                int64_t current_row = std::clamp<int64_t>(first_row + static_cast<int64_t>(k), 0, height - 1);
+                window[k] = reinterpret_cast<const uint8_t*>(&pixels(current_row, 0));
+            }
+            vertical.ComputeRow(window, row.data());
+            ComputeHorizontal(row.data(), width, step, reinterpret_cast<uint8_t*>(&new_pixels(i, 0)), prefix, padded);
+        }
+    });
+    pixels = std::move(new_pixels);
+}
+
+void MorphologyFilter::VerticalPass::ComputeRow(const std::vector<const uint8_t*>& window, uint8_t* out) {
+    size_t position = row_num_ % size_;
+    ++row_num_;
+    if (position == 0) {
+        // Начало блока: окно целиком лежит в блоке, считаем его суффиксные минимумы
+        std::copy(window[size_ - 1], window[size_ - 1] + row_size_, &suffix_[(size_ - 1) * row_size_]);
+        for (size_t k = size_ - 1; k > 0; --k) {
+            Combine(window[k - 1], &suffix_[k * row_size_], &suffix_[(k - 1) * row_size_], row_size_, is_max_);
+        }
+        std::copy(suffix_.begin(), suffix_.begin() + static_cast<std::ptrdiff_t>(row_size_), out);
+        return;
+    }
+    // Последние position строк окна относятся к следующему блоку
+    if (position == 1) {
+        std::copy(window[size_ - 1], window[size_ - 1] + row_size_, prefix_.begin());
+    } else {
+        Combine(prefix_.data(), window[size_ - 1], prefix_.data(), row_size_, is_max_);
+    }
+    Combine(&suffix_[position * row_size_], prefix_.data(), out, row_size_, is_max_);
+}
+
+void MorphologyFilter::ComputeHorizontal(const uint8_t* row, size_t width, const Step& step, uint8_t* out,
+                                         std::vector<uint8_t>& prefix, std::vector<uint8_t>& padded) const {
+    const size_t CHANNELS = 3;
+    size_t size = width_;
+    if (size == 1) {
+        std::copy(row, row + width * CHANNELS, out);
+        return;
+    }
+    // Строка, дополненная копиями крайних пикселей (anchor слева, остальное справа) до целого числа блоков
+    // по size пикселей. Пиксели переставлены так, что t-е пиксели всех блоков лежат подряд в строке t:
+    // тогда префиксы и суффиксы блоков считаются вызовами Combine сразу для всех блоков, как в VerticalPass.
+    size_t block_num = (width + size - 1 + size - 1) / size;
+    size_t block_row_size = block_num * CHANNELS;
+    padded.resize(size * block_row_size);
+    prefix.resize(size * block_row_size);
+    for (size_t b = 0; b < block_num; ++b) {
+        for (size_t t = 0; t < size; ++t) {
+            int64_t column = static_cast<int64_t>(b * size + t) - static_cast<int64_t>(step.anchor_x);
+            column = std::clamp<int64_t>(column, 0, static_cast<int64_t>(width) - 1);
+            std::copy(row + column * CHANNELS, row + (column + 1) * CHANNELS,
+                      &padded[t * block_row_size + b * CHANNELS]);
+        }
+    }
+    std::copy(padded.begin(), padded.begin() + static_cast<std::ptrdiff_t>(block_row_size), prefix.begin());
+    for (size_t t = 1; t < size; ++t) {
+        Combine(&prefix[(t - 1) * block_row_size], &padded[t * block_row_size], &prefix[t * block_row_size],
+                block_row_size, step.is_max);
+    }
+    // Суффиксы считаются на месте дополненной строки
+    for (size_t t = size - 1; t > 0; --t) {
+        Combine(&padded[(t - 1) * block_row_size], &padded[t * block_row_size], &padded[(t - 1) * block_row_size],
+                block_row_size, step.is_max);
+    }
+    // Окно пикселя t блока b -- суффикс с t-го пикселя блока b и префикс до (t - 1)-го пикселя блока b + 1;
+    // результат записывается на место суффиксов
+    Combine(padded.data(), &prefix[(size - 1) * block_row_size], padded.data(), block_row_size, step.is_max);
+    for (size_t t = 1; t < size; ++t) {
+        Combine(&padded[t * block_row_size], &prefix[(t - 1) * block_row_size + CHANNELS], &padded[t * block_row_size],
+                block_row_size - CHANNELS, step.is_max);
+    }
+    for (size_t k = 0; k < width; ++k) {
+        const uint8_t* result = &padded[(k % size) * block_row_size + (k / size) * CHANNELS];
+        std::copy(result, result + CHANNELS, out + k * CHANNELS);
+    }
+}
+
+namespace {
+    // Кольцо из последних size строк по row_size элементов. Строка считается функцией compute при первом
+    // обращении к ней. Запрашиваемые строки должны лежать в окне из size подряд идущих строк, которое
+    // сдвигается только вперёд.
+    template <typename T>
+    class RowRing {
+    public:
+        using ComputeFunction = std::function<void(size_t row, T* out)>;
+
+    public:
+        RowRing(size_t size, size_t row_size, ComputeFunction compute)
+        : row_size_(row_size), rows_(size * row_size), tags_(size, SIZE_MAX), compute_(std::move(compute)) {}
+
+        const T* Get(size_t row) {
+            size_t slot = row % tags_.size();
+            if (tags_[slot] != row) {
+                compute_(row, &rows_[slot * row_size_]);
+                tags_[slot] = row;
+            }
+            return &rows_[slot * row_size_];
+        }
+
+    protected:
+        size_t row_size_;
+        std::vector<T> rows_;
+        std::vector<size_t> tags_;
+        ComputeFunction compute_;
+    };
+}
+
+void CannyFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    size_t height = image_pixels.GetHeight();
+    size_t width = image_pixels.GetWidth();
+    std::vector<uint8_t> labels(height * width);
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        LabelBand(image_pixels, band_begin, band_end, labels.data());
+    });
+    TraceEdges(labels, height, width);
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                uint8_t value = labels[i * width + j] == STRONG ? 255 : 0;
+                image_pixels(i, j) = PixelArray::Pixel{value, value, value};
+            }
+        }
+    });
+}
+
+void CannyFilter::LabelBand(const PixelArray& pixels, size_t band_begin, size_t band_end, uint8_t* labels) const {
+    size_t width = pixels.GetWidth();
+    int64_t last_row = static_cast<int64_t>(pixels.GetHeight()) - 1;
+    int64_t radius = static_cast<int64_t>(kernel_.size() / 2);
+    auto clamp_row = [last_row](int64_t row) {
+        return static_cast<size_t>(std::clamp<int64_t>(row, 0, last_row));
+    };
+    // Строка яркости, дополненная с каждой стороны radius копиями крайних пикселей
+    std::vector<float> padded(width + 2 * radius);
+    RowRing<float> horizontal(kernel_.size(), width, [&](size_t row, float* out) {
+        for (size_t j = 0; j < width; ++j) {
+            padded[radius + j] = GetGrayscale(pixels(row, j));
+        }
+        std::fill(padded.begin(), padded.begin() + radius, padded[radius]);
+        std::fill(padded.end() - radius, padded.end(), padded[radius + width - 1]);
+        std::fill(out, out + width, 0.0f);
+        for (size_t k = 0; k < kernel_.size(); ++k) {
+            for (size_t j = 0; j < width; ++j) {
+                out[j] += kernel_[k] * padded[j + k];
+            }
+        }
+    });
+    RowRing<float> blurred(3, width, [&](size_t row, float* out) {
+        std::fill(out, out + width, 0.0f);
+        for (size_t k = 0; k < kernel_.size(); ++k) {
+            const float* current = horizontal.Get(clamp_row(static_cast<int64_t>(row + k) - radius));
+            for (size_t j = 0; j < width; ++j) {
+                out[j] += kernel_[k] * current[j];
+            }
+        }
+    });
+    RowRing<Gradient> gradients(3, width, [&](size_t row, Gradient* out) {
+        const float* prev = blurred.Get(clamp_row(static_cast<int64_t>(row) - 1));
+        const float* current = blurred.Get(row);
+        const float* next = blurred.Get(clamp_row(static_cast<int64_t>(row) + 1));
+        ComputeGradientRow(prev, current, next, width, out);
+    });
+    for (size_t i = band_begin; i < band_end; ++i) {
+        const Gradient* prev = i > 0 ? gradients.Get(i - 1) : nullptr;
+        const Gradient* current = gradients.Get(i);
+        const Gradient* next = static_cast<int64_t>(i) < last_row ? gradients.Get(i + 1) : nullptr;
+        SuppressRow(prev, current, next, width, labels + i * width);
+    }
+}
+
+void CannyFilter::ComputeGradientRow(const float* prev, const float* row, const float* next, size_t width,
+                                     Gradient* out) {
+    // tg(22.5°): граница между направлением вдоль оси и диагональю
+    const float TAN_22_5 = 0.41421356f;
+    for (size_t j = 0; j < width; ++j) {
+        size_t left = j > 0 ? j - 1 : 0;
+        size_t right = j + 1 < width ? j + 1 : width - 1;
+        float gx = (prev[right] + 2 * row[right] + next[right]) - (prev[left] + 2 * row[left] + next[left]);
+        float gy = (next[left] + 2 * next[j] + next[right]) - (prev[left] + 2 * prev[j] + prev[right]);
+        float abs_x = std::abs(gx);
+        float abs_y = std::abs(gy);
+        out[j].magnitude = std::sqrt(gx * gx + gy * gy) / SOBEL_GAIN;
+        if (abs_y <= abs_x * TAN_22_5) {
+            out[j].direction = ALONG_ROW;
+        } else if (abs_x <= abs_y * TAN_22_5) {
+            out[j].direction = ALONG_COLUMN;
+        } else {
+            out[j].direction = (gx > 0) == (gy > 0) ? MAIN_DIAGONAL : ANTI_DIAGONAL;
+        }
+    }
+}
+
+void CannyFilter::SuppressRow(const Gradient* prev, const Gradient* row, const Gradient* next, size_t width,
+                              uint8_t* out) const {
+    auto magnitude = [width](const Gradient* line, int64_t j) {
+        if (line == nullptr || j < 0 || j >= static_cast<int64_t>(width)) {
+            return 0.0f;
+        }
+        return line[j].magnitude;
+    };
+    for (size_t j = 0; j < width; ++j) {
+        float current = row[j].magnitude;
+        if (current < low_ || current == 0) {
+            out[j] = NONE;
+            continue;
+        }
+        int64_t column = static_cast<int64_t>(j);
+        float before = 0;
+        float after = 0;
+        switch (row[j].direction) {
+            case ALONG_ROW:
+                before = magnitude(row, column - 1);
+                after = magnitude(row, column + 1);
+                break;
+            case MAIN_DIAGONAL:
+                before = magnitude(prev, column - 1);
+                after = magnitude(next, column + 1);
+                break;
+            case ALONG_COLUMN:
+                before = magnitude(prev, column);
+                after = magnitude(next, column);
+                break;
+            case ANTI_DIAGONAL:
+                before = magnitude(next, column - 1);
+                after = magnitude(prev, column + 1);
+                break;
+        }
+        // Из двух равных соседних максимумов (ступенька ровно между пикселями) остаётся только один
+        if (current > before && current >= after) {
+            out[j] = current >= high_ ? STRONG : WEAK;
+        } else {
+            out[j] = NONE;
+        }
+    }
+}
+
+void CannyFilter::TraceEdges(std::vector<uint8_t>& labels, size_t height, size_t width) {
+    std::vector<size_t> queue;
+    for (size_t index = 0; index < labels.size(); ++index) {
+        if (labels[index] == STRONG) {
+            queue.push_back(index);
+        }
+    }
+    for (size_t head = 0; head < queue.size(); ++head) {
+        int64_t i = static_cast<int64_t>(queue[head] / width);
+        int64_t j = static_cast<int64_t>(queue[head] % width);
+        for (int64_t k = std::max<int64_t>(i - 1, 0); k <= std::min<int64_t>(i + 1, height - 1); ++k) {
+            for (int64_t l = std::max<int64_t>(j - 1, 0); l <= std::min<int64_t>(j + 1, width - 1); ++l) {
+                size_t index = static_cast<size_t>(k) * width + static_cast<size_t>(l);
+                if (labels[index] == WEAK) {
+                    labels[index] = STRONG;
+                    queue.push_back(index);
+                }
+            }
+        }
+    }
+}
+
+void AdaptiveThresholdFilter::Apply(Bitmap& image) {
+    size_t window = 2 * radius_ + 1;
+    if (IntegralImageMath::Fits<uint32_t>(window * window, UINT8_MAX)) {
+        ApplyWithSums<uint32_t>(image.GetPixels());
+    } else {
+        ApplyWithSums<uint64_t>(image.GetPixels());
+    }
+}
+
+template <typename Sum>
+void AdaptiveThresholdFilter::ApplyWithSums(PixelArray& pixels) const {
+    size_t height = pixels.GetHeight();
+    size_t width = pixels.GetWidth();
+    if (height == 0 || width == 0) {
+        return;
+    }
+    int64_t radius = static_cast<int64_t>(radius_);
+    size_t window = 2 * radius_ + 1;
+    // Яркость, дополненная с каждой стороны radius копиями крайних строк и столбцов
+    size_t padded_height = height + 2 * radius_;
+    size_t padded_width = width + 2 * radius_;
+    std::vector<uint8_t> brightness(padded_height * padded_width);
+    Parallel::ForBands(0, padded_height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            int64_t row = std::clamp<int64_t>(static_cast<int64_t>(i) - radius, 0, static_cast<int64_t>(height) - 1);
+            for (size_t j = 0; j < padded_width; ++j) {
+                int64_t column = std::clamp<int64_t>(static_cast<int64_t>(j) - radius, 0,
+                                                     static_cast<int64_t>(width) - 1);
+                brightness[i * padded_width + j] = GetGrayscale(pixels(row, column));
+            }
+        }
+    });
+    IntegralImage<Sum> sums(brightness, padded_height, padded_width);
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                uint8_t value = Threshold(brightness[(i + radius_) * padded_width + j + radius_],
+                                          sums.GetSum(Region{i, j, window, window}));
+                pixels(i, j) = PixelArray::Pixel{value, value, value};
+            }
+        }
+    });
+}
+
+bool AdaptiveThresholdFilter::AddStreamStages(StreamPipeline& sp) const {
+    // Суммы яркости по столбцам окна переходят от строки к строке: из них вычитается строка,
+    // вышедшая из окна, и прибавляется новая. Сумма по окну -- разность префиксных сумм этих сумм.
+    sp.AddStage(WindowStreamStage::MakeNeighborhood(radius_, [this, column_sums = std::vector<uint64_t>(),
+                                                              prefix = std::vector<uint64_t>(),
+                                                              first_row = std::vector<uint8_t>()]
+    (const PixelArray& window, size_t out_row, PixelArray::Pixel* out) mutable {
+        size_t width = window.GetWidth();
+        auto add_row = [this, &column_sums, width](const PixelArray::Pixel* row) {
+            for (size_t j = 0; j < width; ++j) {
+                column_sums[j] += GetGrayscale(row[j]);
+            }
+        };
+        if (out_row == 0) {
+            column_sums.assign(width, 0);
+            for (size_t i = 0; i < window.GetHeight(); ++i) {
+                add_row(&window(i, 0));
+            }
+        } else {
+            for (size_t j = 0; j < width; ++j) {
+                column_sums[j] -= first_row[j];
+            }
+            add_row(&window(window.GetHeight() - 1, 0));
+        }
+        first_row.resize(width);
+        for (size_t j = 0; j < width; ++j) {
+            first_row[j] = GetGrayscale(window(0, j));
+        }
+        // prefix[k] -- сумма по столбцам [0, k) строки, дополненной с каждой стороны radius_ крайними столбцами
+        size_t padded_width = width + 2 * radius_;
+        prefix.resize(padded_width + 1);
+        for (size_t k = 0; k < padded_width; ++k) {
+            int64_t column = std::clamp<int64_t>(static_cast<int64_t>(k) - static_cast<int64_t>(radius_), 0,
+                                                 static_cast<int64_t>(width) - 1);
+            prefix[k + 1] = prefix[k] + column_sums[column];
+        }
+        for (size_t j = 0; j < width; ++j) {
+            uint8_t value = Threshold(GetGrayscale(window(radius_, j)), prefix[j + 2 * radius_ + 1] - prefix[j]);
+            out[j] = PixelArray::Pixel{value, value, value};
+        }
+    }));
+    return true;
+}
+
+std::optional<Region> AdaptiveThresholdFilter::GetInputRegion(const Region& output, size_t width,
+                                                              size_t height) const {
+    return output.Expand(radius_, width, height);
+}
+
+void EqualizeFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    size_t height = image_pixels.GetHeight();
+    size_t width = image_pixels.GetWidth();
+    Histogram histogram{};
+    std::mutex histogram_mutex;
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        std::array<Histogram, SUB_HISTOGRAMS> band_histograms{};
+        for (size_t i = band_begin; i < band_end; ++i) {
+            CountRow(&image_pixels(i, 0), width, band_histograms);
+        }
+        Histogram band_histogram = MergeHistograms(band_histograms);
+        std::lock_guard<std::mutex> lock(histogram_mutex);
+        for (size_t v = 0; v < LEVELS; ++v) {
+            histogram[v] += band_histogram[v];
+        }
+    });
+    // Самая тёмная из встречающихся яркостей переходит в 0, самая светлая -- в 255
+    size_t pixel_num = height * width;
+    size_t darkest_num = 0;
+    for (size_t v = 0; v < LEVELS && darkest_num == 0; ++v) {
+        darkest_num = histogram[v];
+    }
+    Lut lut;
+    size_t cumulative = 0;
+    for (size_t v = 0; v < LEVELS; ++v) {
+        cumulative += histogram[v];
+        if (pixel_num == darkest_num) {
+            lut[v] = v;
+        } else if (cumulative < darkest_num) {
+            lut[v] = 0;
+        } else {
+            lut[v] = std::round(static_cast<double>(cumulative - darkest_num) * (LEVELS - 1) /
+                                static_cast<double>(pixel_num - darkest_num));
+        }
+    }
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                uint8_t brightness = GetGrayscale(image_pixels(i, j));
+                ShiftPixel(image_pixels(i, j), lut[brightness] - brightness);
+            }
+        }
+    });
+}
+
+void EqualizeFilter::CountRow(const PixelArray::Pixel* row, size_t size,
+                              std::array<Histogram, SUB_HISTOGRAMS>& histograms) const {
+    size_t j = 0;
+    for (; j + SUB_HISTOGRAMS <= size; j += SUB_HISTOGRAMS) {
+        for (size_t k = 0; k < SUB_HISTOGRAMS; ++k) {
+            ++histograms[k][GetGrayscale(row[j + k])];
+        }
+    }
+    for (; j < size; ++j) {
+        ++histograms[0][GetGrayscale(row[j])];
+    }
+}
+
+EqualizeFilter::Histogram EqualizeFilter::MergeHistograms(const std::array<Histogram, SUB_HISTOGRAMS>& histograms) {
+    Histogram result{};
+    for (const Histogram& histogram : histograms) {
+        for (size_t v = 0; v < LEVELS; ++v) {
+            result[v] += histogram[v];
+        }
+    }
+    return result;
+}
+
+void EqualizeFilter::ShiftPixel(PixelArray::Pixel& pixel, int delta) {
+    auto shift = [delta](uint8_t channel) {
+        return static_cast<uint8_t>(std::clamp(channel + delta, 0, 255));
+    };
+    pixel = PixelArray::Pixel{shift(pixel.red), shift(pixel.green), shift(pixel.blue)};
+}
+
+void ClaheFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    size_t height = image_pixels.GetHeight();
+    size_t width = image_pixels.GetWidth();
+    if (height == 0 || width == 0) {
+        return;
+    }
+    // Прямоугольник t по каждой оси занимает [t * size / tiles, (t + 1) * size / tiles)
+    size_t tiles_y = std::min(tiles_, height);
+    size_t tiles_x = std::min(tiles_, width);
+    std::vector<size_t> row_bounds(tiles_y + 1);
+    for (size_t t = 0; t <= tiles_y; ++t) {
+        row_bounds[t] = t * height / tiles_y;
+    }
+    std::vector<size_t> column_bounds(tiles_x + 1);
+    for (size_t t = 0; t <= tiles_x; ++t) {
+        column_bounds[t] = t * width / tiles_x;
+    }
+    std::vector<Histogram> histograms(tiles_y * tiles_x);
+    std::mutex histograms_mutex;
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        std::vector<std::array<Histogram, SUB_HISTOGRAMS>> band_histograms(tiles_y * tiles_x);
+        // Строки относятся к прямоугольникам по тем же границам, по которым считается число их пикселей
+        size_t tile_row = std::upper_bound(row_bounds.begin(), row_bounds.end(), band_begin) - row_bounds.begin() - 1;
+        for (size_t i = band_begin; i < band_end; ++i) {
+            if (i == row_bounds[tile_row + 1]) {
+                ++tile_row;
+            }
+            for (size_t t = 0; t < tiles_x; ++t) {
+                CountRow(&image_pixels(i, column_bounds[t]), column_bounds[t + 1] - column_bounds[t],
+                         band_histograms[tile_row * tiles_x + t]);
+            }
+        }
+        std::lock_guard<std::mutex> lock(histograms_mutex);
+        for (size_t t = 0; t < histograms.size(); ++t) {
+            Histogram band_histogram = MergeHistograms(band_histograms[t]);
+            for (size_t v = 0; v < LEVELS; ++v) {
+                histograms[t][v] += band_histogram[v];
+            }
+        }
+    });
+    std::vector<Lut> luts(histograms.size());
+    for (size_t ty = 0; ty < tiles_y; ++ty) {
+        size_t tile_height = row_bounds[ty + 1] - row_bounds[ty];
+        for (size_t tx = 0; tx < tiles_x; ++tx) {
+            size_t tile_width = column_bounds[tx + 1] - column_bounds[tx];
+            luts[ty * tiles_x + tx] = MakeTileLut(histograms[ty * tiles_x + tx], tile_height * tile_width);
+        }
+    }
+    std::vector<TileWeight> row_weights = GetTileWeights(height, tiles_y);
+    std::vector<TileWeight> column_weights = GetTileWeights(width, tiles_x);
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            const TileWeight& row_weight = row_weights[i];
+            const Lut* first_luts = &luts[row_weight.first * tiles_x];
+            const Lut* second_luts = &luts[row_weight.second * tiles_x];
+            for (size_t j = 0; j < width; ++j) {
+                const TileWeight& column_weight = column_weights[j];
+                uint8_t brightness = GetGrayscale(image_pixels(i, j));
+                auto interpolate = [&column_weight, brightness](const Lut* tile_luts) {
+                    return static_cast<float>(tile_luts[column_weight.first][brightness]) * (1 - column_weight.weight) +
+                           static_cast<float>(tile_luts[column_weight.second][brightness]) * column_weight.weight;
+                };
+                float mapped = interpolate(first_luts) * (1 - row_weight.weight) +
+                               interpolate(second_luts) * row_weight.weight;
+                ShiftPixel(image_pixels(i, j), static_cast<int>(std::lround(mapped)) - brightness);
+            }
+        }
+    });
+}
+
+std::vector<ClaheFilter::TileWeight> ClaheFilter::GetTileWeights(size_t size, size_t tiles) {
+    std::vector<TileWeight> weights(size);
+    for (size_t x = 0; x < size; ++x) {
+        // Центр прямоугольника t находится в точке (t + 0.5) * size / tiles - 0.5
+        double position = (static_cast<double>(x) + 0.5) * static_cast<double>(tiles) / static_cast<double>(size) - 0.5;
+        if (position <= 0) {
+            weights[x] = {0, 0, 0};
+        } else if (position >= static_cast<double>(tiles - 1)) {
+            weights[x] = {tiles - 1, tiles - 1, 0};
+        } else {
+            size_t first = static_cast<size_t>(position);
+            weights[x] = {first, first + 1, static_cast<float>(position - static_cast<double>(first))};
+        }
+    }
+    return weights;
+}
+
+EqualizeFilter::Lut ClaheFilter::MakeTileLut(Histogram histogram, size_t pixel_num) const {
+    size_t limit = std::max<size_t>(1, static_cast<size_t>(clip_ * static_cast<double>(pixel_num) / LEVELS));
+    size_t excess = 0;
+    for (uint32_t& count : histogram) {
+        if (count > limit) {
+            excess += count - limit;
+            count = limit;
+        }
+    }
+    // Остаток от деления избытка раздаётся по одному в равномерно расставленные столбцы
+    for (size_t v = 0; v < LEVELS; ++v) {
+        histogram[v] += excess / LEVELS;
+    }
+    size_t rest = excess % LEVELS;
+    if (rest > 0) {
+        size_t step = LEVELS / rest;
+        for (size_t v = 0; v < rest * step; v += step) {
+            ++histogram[v];
+        }
+    }
+    Lut lut;
+    size_t cumulative = 0;
+    for (size_t v = 0; v < LEVELS; ++v) {
+        cumulative += histogram[v];
+        lut[v] = std::min<long>(LEVELS - 1, std::lround(static_cast<double>(cumulative) * (LEVELS - 1) /
+                                                          static_cast<double>(pixel_num)));
+    }
+    return lut;
+}
+
+AffineFilter::Matrix AffineFilter::Matrix::Inverse() const {
+    double determinant = GetDeterminant();
+    Matrix inverse{e / determinant, -b / determinant, 0, -d / determinant, a / determinant, 0};
+    inverse.c = -(inverse.a * c + inverse.b * f);
+    inverse.f = -(inverse.d * c + inverse.e * f);
+    return inverse;
+}
+
+void AffineFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    image_pixels = Warp(image_pixels, image_pixels.GetWidth(), image_pixels.GetHeight(), matrix_);
+}
+
+PixelArray AffineFilter::Warp(const PixelArray& pixels, size_t width, size_t height, const Matrix& matrix) const {
+    PixelArray result(height, width);
+    if (pixels.GetHeight() == 0 || pixels.GetWidth() == 0) {
+        return result;
+    }
+    Matrix inverse = matrix.Inverse();
+    Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+        for (size_t tile_row = band_begin; tile_row < band_end; tile_row += TILE_SIZE) {
+            for (size_t tile_column = 0; tile_column < width; tile_column += TILE_SIZE) {
+                Region tile{tile_row, tile_column, std::min(TILE_SIZE, band_end - tile_row),
+                            std::min(TILE_SIZE, width - tile_column)};
+                switch (interpolation_) {
+                    case Interpolation::NEAREST:
+                        WarpTile<Interpolation::NEAREST>(pixels, inverse, tile, result);
+                        break;
+                    case Interpolation::BILINEAR:
+                        WarpTile<Interpolation::BILINEAR>(pixels, inverse, tile, result);
+                        break;
+                    case Interpolation::BICUBIC:
+                        WarpTile<Interpolation::BICUBIC>(pixels, inverse, tile, result);
+                        break;
+                }
+            }
+        }
+    });
+    return result;
+}
+
+namespace {
+    // Веса кубической свёртки Катмулла -- Рома для пикселей на расстоянии 1 + t, t, 1 - t и 2 - t от точки
+    std::array<float, 4> GetCubicWeights(float t) {
+        float t2 = t * t;
+        float t3 = t2 * t;
+        return {(-t3 + 2 * t2 - t) / 2, (3 * t3 - 5 * t2 + 2) / 2, (-3 * t3 + 4 * t2 + t) / 2, (t3 - t2) / 2};
+    }
+
+    uint8_t ToChannel(float value) {
+        return static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+    }
+}
+
+template <AffineFilter::Interpolation interpolation>
+void AffineFilter::WarpTile(const PixelArray& pixels, const Matrix& inverse, const Region& tile, PixelArray& result) {
+    // Строки Region и Matrix считаются сверху вниз, а строки PixelArray -- снизу вверх
+    int64_t height = static_cast<int64_t>(pixels.GetHeight());
+    int64_t width = static_cast<int64_t>(pixels.GetWidth());
+    size_t result_height = result.GetHeight();
+    auto at = [&pixels, height, width](int64_t row, int64_t column) -> const PixelArray::Pixel& {
+        return pixels(height - 1 - std::clamp<int64_t>(row, 0, height - 1), std::clamp<int64_t>(column, 0, width - 1));
+    };
+    for (size_t y = tile.row; y < tile.row + tile.height; ++y) {
+        PixelArray::Pixel* out = &result(result_height - 1 - y, 0);
+        // Прообраз центра пикселя (tile.column, y) в координатах, где центр пикселя (j, i) -- точка (j, i)
+        double out_x = static_cast<double>(tile.column) + 0.5;
+        double out_y = static_cast<double>(y) + 0.5;
+        double x = inverse.a * out_x + inverse.b * out_y + inverse.c - 0.5;
+        double y_in = inverse.d * out_x + inverse.e * out_y + inverse.f - 0.5;
+        for (size_t j = tile.column; j < tile.column + tile.width; ++j, x += inverse.a, y_in += inverse.d) {
+            if (x < -0.5 || y_in < -0.5 || x > static_cast<double>(width) - 0.5 ||
+                y_in > static_cast<double>(height) - 0.5) {
+                continue;
+            }
+            if constexpr (interpolation == Interpolation::NEAREST) {
+                out[j] = at(std::lround(y_in), std::lround(x));
+            } else if constexpr (interpolation == Interpolation::BILINEAR) {
+                int64_t column = static_cast<int64_t>(std::floor(x));
+                int64_t row = static_cast<int64_t>(std::floor(y_in));
+                float fx = static_cast<float>(x - static_cast<double>(column));
+                float fy = static_cast<float>(y_in - static_cast<double>(row));
+                const PixelArray::Pixel& p00 = at(row, column);
+                const PixelArray::Pixel& p01 = at(row, column + 1);
+                const PixelArray::Pixel& p10 = at(row + 1, column);
+                const PixelArray::Pixel& p11 = at(row + 1, column + 1);
+                auto blend = [fx, fy](uint8_t v00, uint8_t v01, uint8_t v10, uint8_t v11) {
+                    float top = static_cast<float>(v00) + (static_cast<float>(v01) - static_cast<float>(v00)) * fx;
+                    float bottom = static_cast<float>(v10) + (static_cast<float>(v11) - static_cast<float>(v10)) * fx;
+                    return ToChannel(top + (bottom - top) * fy);
+                };
+                out[j] = PixelArray::Pixel{blend(p00.red, p01.red, p10.red, p11.red),
+                                           blend(p00.green, p01.green, p10.green, p11.green),
+                                           blend(p00.blue, p01.blue, p10.blue, p11.blue)};
+            } else {
+                int64_t column = static_cast<int64_t>(std::floor(x));
+                int64_t row = static_cast<int64_t>(std::floor(y_in));
+                std::array<float, 4> weights_x = GetCubicWeights(static_cast<float>(x - static_cast<double>(column)));
+                std::array<float, 4> weights_y = GetCubicWeights(static_cast<float>(y_in - static_cast<double>(row)));
+                float red = 0;
+                float green = 0;
+                float blue = 0;
+                for (int64_t k = 0; k < 4; ++k) {
+                    float row_red = 0;
+                    float row_green = 0;
+                    float row_blue = 0;
+                    for (int64_t l = 0; l < 4; ++l) {
+                        const PixelArray::Pixel& current = at(row + k - 1, column + l - 1);
+                        row_red += weights_x[l] * static_cast<float>(current.red);
+                        row_green += weights_x[l] * static_cast<float>(current.green);
+                        row_blue += weights_x[l] * static_cast<float>(current.blue);
+                    }
+                    red += weights_y[k] * row_red;
+                    green += weights_y[k] * row_green;
+                    blue += weights_y[k] * row_blue;
+                }
+                out[j] = PixelArray::Pixel{ToChannel(red), ToChannel(green), ToChannel(blue)};
+            }
+        }
+    }
+}
+
+RotateFilter::RotateFilter(double degrees, Interpolation interpolation)
+: AffineFilter(Matrix{1, 0, 0, 0, 1, 0}, interpolation), degrees_(std::fmod(degrees, 360)) {
+    if (degrees_ < 0) {
+        degrees_ += 360;
+    }
+}
+
+void RotateFilter::Apply(Bitmap& image) {
+    PixelArray& image_pixels = image.GetPixels();
+    if (auto quarter_turns = GetQuarterTurns()) {
+        RotateQuarterTurns(image_pixels, *quarter_turns);
+        return;
+    }
+    double width = static_cast<double>(image_pixels.GetWidth());
+    double height = static_cast<double>(image_pixels.GetHeight());
+    auto [new_width, new_height] = GetOutputSize(image_pixels.GetWidth(), image_pixels.GetHeight());
+    // Центр изображения переходит в центр результата; ось y направлена вниз, поэтому поворот
+    // против часовой стрелки записывается с противоположным знаком синуса
+    double angle = degrees_ * M_PI / 180;
+    double cos = std::cos(angle);
+    double sin = std::sin(angle);
+    double new_center_x = static_cast<double>(new_width) / 2;
+    double new_center_y = static_cast<double>(new_height) / 2;
+    Matrix matrix{cos, sin, new_center_x - cos * width / 2 - sin * height / 2,
+                  -sin, cos, new_center_y + sin * width / 2 - cos * height / 2};
+    image_pixels = Warp(image_pixels, new_width, new_height, matrix);
+}
+
+BaseFilter::Size RotateFilter::GetOutputSize(size_t width, size_t height) const {
+    if (auto quarter_turns = GetQuarterTurns()) {
+        return *quarter_turns % 2 == 0 ? Size{width, height} : Size{height, width};
+    }
+    double angle = degrees_ * M_PI / 180;
+    double cos = std::abs(std::cos(angle));
+    double sin = std::abs(std::sin(angle));
+    double new_width = static_cast<double>(width) * cos + static_cast<double>(height) * sin;
+    double new_height = static_cast<double>(width) * sin + static_cast<double>(height) * cos;
+    return {std::lround(new_width), std::lround(new_height)};
+}
+
+std::optional<size_t> RotateFilter::GetQuarterTurns() const {
+    for (size_t quarter_turns = 0; quarter_turns < 4; ++quarter_turns) {
+        if (degrees_ == static_cast<double>(quarter_turns * 90)) {
+            return quarter_turns;
+        }
+    }
+    return std::nullopt;
+}
+
+void RotateFilter::RotateQuarterTurns(PixelArray& pixels, size_t quarter_turns) {
+    // Строки PixelArray идут снизу вверх. Поворот на 90 градусов против часовой стрелки переводит
+    // пиксель (i, j) в (j, height - 1 - i): это транспонирование и отражение каждой строки.
+    // Поворот на 270 градусов -- транспонирование и обратный порядок строк.
+    if (quarter_turns == 2) {
+        size_t size = pixels.GetHeight() * pixels.GetWidth();
+        if (size > 0) {
+            std::reverse(&pixels(0, 0), &pixels(0, 0) + size);
+        }
+        return;
+    }
+    if (quarter_turns == 0) {
+        return;
+    }
+    PixelArray transposed = PixelMath::Transpose(pixels);
+    if (quarter_turns == 1) {
+        PixelMath::FlipHorizontal(transposed);
+    } else {
+        PixelMath::FlipVertical(transposed);
+    }
+    pixels = std::move(transposed);
+}
+
+void TransposeFilter::Apply(Bitmap& image) {
+    // Строки PixelArray идут снизу вверх, поэтому отражению относительно диагонали из левого верхнего угла
+    // соответствует транспонирование с обратным порядком всех пикселей: (i, j) переходит в
+    // (width - 1 - j, height - 1 - i)
+    PixelArray& image_pixels = image.GetPixels();
+    image_pixels = PixelMath::Transpose(image_pixels);
+    size_t size = image_pixels.GetHeight() * image_pixels.GetWidth();
+    if (size > 0) {
+        std::reverse(&image_pixels(0, 0), &image_pixels(0, 0) + size);
+    }
+}
+
+BaseFilter::Size TransposeFilter::GetOutputSize(size_t width, size_t height) const {
+    return {height, width};
+}
+
+std::optional<Region> TransposeFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    return Region{height - output.column - output.width, width - output.row - output.height, output.width,
+                  output.height};
+}
+
+void TransposeFilter::ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                                    size_t height) {
+    // Нужная область отражается в область output целиком, поэтому достаточно применить фильтр к ней
+    std::optional<Region> needed = GetInputRegion(output, width, height);
+    CutRegion(image.GetPixels(), Region{needed->row - input.row, needed->column - input.column,
+                                        needed->height, needed->width});
+    Apply(image);
+}
+
+void FlipFilter::Apply(Bitmap& image) {
+    if (horizontal_) {
+        PixelMath::FlipHorizontal(image.GetPixels());
+    } else {
+        PixelMath::FlipVertical(image.GetPixels());
+    }
+}
+
+bool FlipFilter::AddStreamStages(StreamPipeline& sp) const {
+    // Для отражения сверху вниз нужна последняя строка изображения раньше первой
+    if (!horizontal_) {
+        return false;
+    }
+    sp.AddStage(new RowStreamStage([](const PixelArray::Pixel* in, size_t width, PixelArray::Pixel* out) {
+        std::reverse_copy(in, in + width, out);
+    }));
+    return true;
+}
+
+std::optional<Region> FlipFilter::GetInputRegion(const Region& output, size_t width, size_t height) const {
+    Region input = output;
+    if (horizontal_) {
+        input.column = width - output.column - output.width;
+    } else {
+        input.row = height - output.row - output.height;
+    }
+    return input;
+}
+
+void FlipFilter::ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                               size_t height) {
+    std::optional<Region> needed = GetInputRegion(output, width, height);
+    CutRegion(image.GetPixels(), Region{needed->row - input.row, needed->column - input.column,
+                                        needed->height, needed->width});
+    Apply(image);
+}
@@ -1,31 +1,80 @@
 #pragma once
 #include "base_filter.h"
+#include "border.h"
+#include "fixed_kernel.h"
+#include <algorithm>
+#include <array>
 #include <cmath>
+#include <cstdint>
+#include <deque>
 #include <vector>
 
 namespace PixelMath {
     using Matrix = std::vector<std::vector<double>>;
 
-    PixelArray::Pixel ApplyMatrix(const PixelArray& pixels, size_t i, size_t j, Matrix& matrix);
+    PixelArray::Pixel ApplyMatrix(const PixelArray& pixels, size_t i, size_t j, const Matrix& matrix);
+
+    // Свёртка строки row шириной width с одномерным ядром kernel нечётной длины. Строка один раз
+    // дополняется полями по правилу border в буфер padded, после чего ядро применяется без проверок.
+    void ConvolveRow(const PixelArray::Pixel* row, size_t width, const std::vector<double>& kernel,
+                     BorderMode border, std::vector<PixelArray::Pixel>& padded, PixelArray::Pixel* out);
 
     Matrix TransposeMatrix(const Matrix& matrix);
+
+    // Уменьшает изображение в factor_x раз по ширине и в factor_y раз по высоте, усредняя блоки пикселей.
+    // Неполные блоки у края изображения усредняются по имеющимся в них пикселям.
+    PixelArray BoxReduce(const PixelArray& pixels, size_t factor_y, size_t factor_x);
+
+    // Считает одну строку BoxReduce по строкам first_row ... first_row + row_count - 1 массива pixels
+    void BoxReduceRow(const PixelArray& pixels, size_t first_row, size_t row_count, size_t factor_x,
+                      PixelArray::Pixel* out);
+
+    // Сторона квадратного блока, которыми транспонируется изображение: блок исходного изображения
+    // и блок результата вместе помещаются в кэш L1
+    const size_t TRANSPOSE_BLOCK = 32;
+
+    // Транспонирует изображение по блокам TRANSPOSE_BLOCK x TRANSPOSE_BLOCK: пиксель (i, j) переходит в (j, i).
+    // Вертикальный проход фильтра можно выполнить горизонтальным между двумя транспонированиями,
+    // тогда он читает пиксели подряд, а не через строку.
+    PixelArray Transpose(const PixelArray& pixels);
+
+    // Отражает порядок строк изображения
+    void FlipVertical(PixelArray& pixels);
+
+    // Отражает каждую строку изображения
+    void FlipHorizontal(PixelArray& pixels);
 }
 
 class GaussianBlurFilter : public BaseFilter {
 public:
     static const size_t PARAM_NUM = 1;
+    static const size_t PARAM_NUM_WITH_BORDER = 2;
 
 public:
-    explicit GaussianBlurFilter(double sigma) {
+    explicit GaussianBlurFilter(double sigma, BorderMode border = BorderMode::CLAMP) : border_(border) {
         GenerateMatrix(sigma);
     }
     void Apply(Bitmap& image) override;
 
+    AlphaMode GetAlphaMode() const override { return AlphaMode::PREMULTIPLIED; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
+
+    // Нормированное одномерное ядро радиусом ceil(3 * sigma)
+    static std::vector<double> MakeKernel(double sigma);
+
 protected:
     void GenerateMatrix(double sigma);
 
 protected:
     PixelMath::Matrix matrix_;
+    BorderMode border_;
 };
 
 class CropFilter : public BaseFilter {
@@ -37,7 +86,23 @@ public:
 
     void Apply(Bitmap& image) override;
 
-    static void RotateImage(PixelArray& pixels);
+    AlphaMode GetAlphaMode() const override { return AlphaMode::MOVE; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    Size GetOutputSize(size_t width, size_t height) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    void ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                       size_t height) override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
+
+    void ApplyPreciseToRegion(FloatImage& image, const Region& input, const Region& output, size_t width,
+                              size_t height) override;
 
 protected:
     size_t width_;
@@ -47,49 +112,107 @@ protected:
 class NegativeFilter : public BaseFilter {
 public:
     void Apply(Bitmap& image) override;
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
+
+    static void ApplyToRow(PixelArray::Pixel* row, size_t width);
 };
 
-class GrayscaleFilter : public BaseFilter {
+// Общая часть фильтров, которые работают с яркостью пикселей. Режим повышенной точности наследники
+// поддерживают, только если сами переопределяют SupportsPrecise и ApplyPrecise.
+class BrightnessFilter : public BaseFilter {
 public:
     const double RED_COEF = 0.299;
     const double GREEN_COEF = 0.587;
     const double BLUE_COEF = 0.114;
 
-public:
-    void Apply(Bitmap& image) override;
-
 protected:
-    uint8_t GetGrayscale(PixelArray::Pixel& pixel) const {
+    uint8_t GetGrayscale(const PixelArray::Pixel& pixel) const {
         return std::round(RED_COEF * pixel.red + GREEN_COEF * pixel.green + BLUE_COEF * pixel.blue);
     }
+
+    // Заменяет пиксели строки серыми той же яркости
+    void ToGrayscaleRow(PixelArray::Pixel* row, size_t width) const;
+
+    // То же для изображения с каналами float; яркость не округляется
+    void ToGrayscalePrecise(FloatImage& image) const;
+};
+
+class GrayscaleFilter : public BrightnessFilter {
+public:
+    void Apply(Bitmap& image) override;
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
 };
 
 class SharpeningFilter : public BaseFilter {
 public:
+    static const size_t PARAM_NUM_WITH_BORDER = 1;
+
+public:
+    explicit SharpeningFilter(BorderMode border = BorderMode::CLAMP) : border_(border) {}
+
     void Apply(Bitmap& image) override;
 
-protected:
-    PixelArray::Pixel GetSharpenPixel(PixelArray& pixels, size_t i, size_t j);
+    AlphaMode GetAlphaMode() const override { return AlphaMode::PREMULTIPLIED; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
 
 protected:
-    PixelMath::Matrix matrix_ = {{0, -1, 0},
-                                 {-1, 5, -1},
-                                 {0, -1, 0}};
+    static constexpr FixedKernel::Kernel<3, 3> KERNEL = {{{0, -1, 0},
+                                                          {-1, 5, -1},
+                                                          {0, -1, 0}}};
+
+    BorderMode border_;
 };
 
-class EdgeDetectionFilter : public GrayscaleFilter {
+class EdgeDetectionFilter : public BrightnessFilter {
 public:
     static const size_t PARAM_NUM = 1;
+    static const size_t PARAM_NUM_WITH_BORDER = 2;
 
 public:
-    explicit EdgeDetectionFilter(double threshold) : threshold_(threshold) {}
+    explicit EdgeDetectionFilter(double threshold, BorderMode border = BorderMode::CLAMP)
+    : threshold_(threshold), border_(border) {}
     void Apply(Bitmap& image) override;
 
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    bool SupportsPrecise() const override { return true; }
+
+    void ApplyPrecise(FloatImage& image) override;
+
 protected:
+    // Превращает отклик ядра в строке в белый (больше порога) или чёрный цвет
+    void ApplyThreshold(PixelArray::Pixel* row, size_t width) const;
+
+protected:
+    static constexpr FixedKernel::Kernel<3, 3> KERNEL = {{{0, -1, 0},
+                                                          {-1, 4, -1},
+                                                          {0, -1, 0}}};
+
     double threshold_;
-    PixelMath::Matrix matrix_ = {{0, -1, 0},
-                                 {-1, 4, -1},
-                                 {0, -1, 0}};
+    BorderMode border_;
 };
 
 class LanczosScaleFilter : public BaseFilter {
@@ -97,14 +220,32 @@ public:
     static const int ALPHA = 3;
     static const size_t PARAM_NUM_WITH_ALPHA = 3;
     static const size_t PARAM_NUM_WO_ALPHA = 2;
+    // Если изображение уменьшается хотя бы во столько раз, оно сначала усредняется по целым блокам
+    // пикселей, а фильтр Ланцоша доуменьшает его меньше чем в 2 раза. Иначе фильтр с 2 * alpha отсчётами
+    // пропускает большую часть пикселей, и на результате появляется алиасинг.
+    static constexpr double AREA_REDUCTION_MIN_RATIO = 2;
 public:
     LanczosScaleFilter(size_t dest_width, size_t dest_height, int alpha = ALPHA)
     : dest_width_(dest_width), dest_height_(dest_height), alpha_(alpha) {}
     void Apply(Bitmap& image) override;
 
+    AlphaMode GetAlphaMode() const override { return AlphaMode::PREMULTIPLIED; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    Size GetOutputSize(size_t width, size_t height) const override;
+
+    // Во сколько раз уменьшить изображение усреднением блоков, если всего его нужно уменьшить в ratio раз
+    static size_t GetAreaReductionFactor(double ratio);
+
 protected:
-    static PixelArray::Pixel ApplyLanczosX(const PixelArray& image_pixels, double x, int alpha, size_t row);
-    static PixelArray::Pixel ApplyLanczosY(const PixelArray& image_pixels, double y, int alpha, size_t column);
+    // Масштабирует фильтром Ланцоша: выходной пиксель j берётся из координаты (j + 0.5) * delta - 0.5
+    PixelArray Resample(const PixelArray& image_pixels, double delta_x, double delta_y) const;
+
+    // Отсчёт в координате x строки, дополненной по краям alpha пикселями: padded[0] -- пиксель -alpha.
+    // Для x из отрезка [-1, width) полей такой ширины достаточно.
+    static PixelArray::Pixel ApplyLanczos(const PixelArray::Pixel* padded, double x, int alpha);
+    static uint8_t ToLanczosChannel(double value);
     static double sinc(double x);
     static double Lanczos(double x, int alpha);
 
@@ -112,4 +253,555 @@ protected:
     size_t dest_width_;
     size_t dest_height_;
     double alpha_;
-};
\ No newline at end of file
+};
+// Медианный фильтр: каждый канал заменяется медианой по квадрату (2 * radius + 1) x (2 * radius + 1).
+// Алгоритм Perreault и Hébert: для каждого столбца хранится гистограмма окна высотой 2 * radius + 1,
+// а гистограмма квадрата сдвигается вдоль строки прибавлением гистограммы одного столбца и вычитанием
+// другой. Время на пиксель не зависит от радиуса. Полосы строк обрабатываются параллельно.
+class MedianFilter : public BaseFilter {
+public:
+    static const size_t PARAM_NUM = 1;
+    // Число пикселей в квадрате должно помещаться в uint16_t
+    static const size_t MAX_RADIUS = 127;
+
+public:
+    explicit MedianFilter(size_t radius) : radius_(radius) {}
+
+    void Apply(Bitmap& image) override;
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+protected:
+    // Гистограммы каналов по столбцам для текущего окна строк. Кроме точной гистограммы из 256 значений
+    // хранится грубая из 16 (по старшим 4 битам). При сдвиге квадрата обновляется только грубая гистограмма
+    // квадрата, а участок точной из 16 значений досчитывается, лишь когда в него попадает медиана.
+    class ColumnHistograms {
+    public:
+        static const size_t LEVELS = 256;
+        static const size_t COARSE_LEVELS = 16;
+        static const size_t CHANNELS = 3;
+
+    public:
+        ColumnHistograms(size_t width, size_t radius);
+
+        void AddRow(const PixelArray::Pixel* row);
+
+        void RemoveRow(const PixelArray::Pixel* row);
+
+        // Считает строку медиан по окну из 2 * radius + 1 строк, добавленных в гистограммы
+        void ComputeRow(PixelArray::Pixel* out);
+
+    protected:
+        void UpdateRow(const PixelArray::Pixel* row, int delta);
+
+        // Прибавляет (sign = 1) или вычитает (sign = -1) грубые гистограммы столбца к грубым гистограммам квадрата
+        void UpdateKernelCoarse(size_t column, int sign);
+
+        // Приводит участок coarse_level точной гистограммы квадрата к квадрату с центром в столбце column
+        void SyncKernelFine(size_t channel, size_t coarse_level, int64_t column);
+
+        uint8_t FindMedian(size_t channel, int64_t column);
+
+        size_t ClampColumn(int64_t column) const;
+
+    protected:
+        size_t width_;
+        size_t radius_;
+        std::vector<uint16_t> fine_;   // [столбец][канал][значение]
+        std::vector<uint16_t> coarse_; // [столбец][канал][значение / 16]
+        std::vector<uint16_t> kernel_fine_;
+        std::vector<uint16_t> kernel_coarse_;
+        // Для какого столбца посчитан каждый участок точной гистограммы квадрата
+        std::vector<int64_t> kernel_fine_column_;
+    };
+
+protected:
+    size_t radius_;
+};
+
+// Билатеральный фильтр на билатеральной сетке (Paris, Durand). Пиксели раскладываются в трёхмерную сетку
+// (строка / sigma_s, столбец / sigma_s, яркость / sigma_r), в каждой ячейке копятся сумма цветов и число
+// пикселей. Сетка размывается гауссовым ядром с sigma в одну ячейку по каждой оси, а результат пикселя --
+// трилинейная интерполяция сетки в его точке, делённая на интерполированное число пикселей. Яркость
+// считается так же, как в GrayscaleFilter. Если при малых sigma сетка вышла бы больше
+// MAX(MIN_GRID_CELLS, число пикселей / PIXELS_PER_GRID_CELL) ячеек, шаги сетки по всем осям увеличиваются
+// в одно и то же число раз, а sigma размытия в ячейках во столько же раз уменьшается. Так время и память
+// линейны по числу пикселей при любых sigma.
+class BilateralFilter : public BrightnessFilter {
+public:
+    static const size_t PARAM_NUM = 2;
+    static constexpr double MIN_SIGMA = 1;
+    static const size_t PIXELS_PER_GRID_CELL = 4;
+    static const size_t MIN_GRID_CELLS = 1 << 16;
+
+    // Шаги сетки (по строкам и столбцам, по яркости) и её размер в ячейках
+    struct GridLayout {
+        double spatial_step;
+        double range_step;
+        size_t cells;
+    };
+
+public:
+    BilateralFilter(double sigma_s, double sigma_r) : sigma_s_(sigma_s), sigma_r_(sigma_r) {}
+
+    void Apply(Bitmap& image) override;
+
+    // Шаги сетки для изображения height x width: sigma_s и sigma_r, если сетка с ними не больше допустимой
+    GridLayout GetGridLayout(size_t height, size_t width) const;
+
+    // Потоковая обработка невозможна: сетка строится по всему изображению
+    bool AddStreamStages(StreamPipeline& /*sp*/) const override { return false; }
+
+    // Результат зависит от того, как ячейки сетки легли на изображение, поэтому фрагмент
+    // нельзя считать отдельно
+    std::optional<Region> GetInputRegion(const Region& /*output*/, size_t /*width*/,
+                                         size_t /*height*/) const override {
+        return std::nullopt;
+    }
+
+protected:
+    // Ячейка сетки: суммы каналов и число пикселей
+    struct Cell {
+        float red = 0;
+        float green = 0;
+        float blue = 0;
+        float weight = 0;
+    };
+
+    class Grid {
+    public:
+        Grid(size_t height, size_t width, size_t depth)
+        : height_(height), width_(width), depth_(depth), cells_(height * width * depth) {}
+
+        Cell& operator()(size_t y, size_t x, size_t z) { return cells_[(y * width_ + x) * depth_ + z]; }
+
+        const Cell& operator()(size_t y, size_t x, size_t z) const { return cells_[(y * width_ + x) * depth_ + z]; }
+
+        // Размывает сетку ядром kernel по каждой из трёх осей; за границей сетки ячейки пустые
+        void Blur(const std::vector<double>& kernel);
+
+        // Трилинейная интерполяция в точке (y, x, z)
+        Cell Interpolate(double y, double x, double z) const;
+
+        size_t GetHeight() const { return height_; }
+
+        size_t GetWidth() const { return width_; }
+
+        size_t GetDepth() const { return depth_; }
+
+    protected:
+        // Размывает size ячеек, лежащих с шагом stride начиная с first
+        static void BlurLine(Cell* first, size_t size, size_t stride, const std::vector<double>& kernel,
+                             std::vector<Cell>& buffer);
+
+    protected:
+        size_t height_;
+        size_t width_;
+        size_t depth_;
+        std::vector<Cell> cells_;
+    };
+
+protected:
+    double sigma_s_;
+    double sigma_r_;
+};
+
+// Нерезкое маскирование: к пикселю прибавляется его отличие от размытой копии, умноженное на amount,
+// если это отличие по модулю не меньше threshold. Размытая копия считается тем же ядром, что и в
+// GaussianBlurFilter, но не целиком: хранятся только 2 * radius + 1 строк, размытых по горизонтали,
+// а вертикальный проход и смешивание с исходной строкой выполняются за один проход по строке.
+class UnsharpMaskFilter : public BaseFilter {
+public:
+    static const size_t PARAM_NUM = 3;
+    static const size_t PARAM_NUM_WITH_BORDER = 4;
+    using Row = std::vector<PixelArray::Pixel>;
+
+public:
+    UnsharpMaskFilter(double sigma, double amount, double threshold, BorderMode border = BorderMode::CLAMP)
+    : kernel_(GaussianBlurFilter::MakeKernel(sigma)), amount_(amount), threshold_(threshold), border_(border) {}
+
+    void Apply(Bitmap& image) override;
+
+    AlphaMode GetAlphaMode() const override { return AlphaMode::PREMULTIPLIED; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+protected:
+    // Размывает строку по горизонтали, так же как первый проход GaussianBlurFilter; padded -- буфер для строки
+    // с полями
+    void BlurRow(const PixelArray::Pixel* row, size_t width, Row& padded, Row& out) const;
+
+    // blurred_rows -- 2 * radius + 1 строк, размытых по горизонтали, с центром в строке row
+    void SharpenRow(const PixelArray::Pixel* row, const std::deque<Row>& blurred_rows, PixelArray::Pixel* out) const;
+
+protected:
+    std::vector<double> kernel_;
+    double amount_;
+    double threshold_;
+    BorderMode border_;
+};
+
+// Полутоновые морфологические операции с прямоугольным структурным элементом width x height: каждый канал
+// заменяется минимумом или максимумом своих значений по окну, изображение не бинаризуется.
+// Минимум (эрозия) и максимум (дилатация) по окну считаются алгоритмом ван Херка -- Гила -- Вермана:
+// строка делится на блоки длиной в окно, в каждом блоке считаются префиксные и суффиксные минимумы,
+// и минимум окна равен минимуму из суффикса одного блока и префикса следующего. Это три операции
+// на элемент при любом размере окна. Сначала окно проходится по вертикали, затем по горизонтали.
+// Каналы обрабатываются как массив байт, поэтому циклы min/max компилятор векторизует.
+class MorphologyFilter : public BaseFilter {
+public:
+    static const size_t PARAM_NUM = 2;
+
+    enum class Operation {
+        ERODE,
+        DILATE,
+        OPEN,  // эрозия, затем дилатация
+        CLOSE  // дилатация, затем эрозия
+    };
+
+public:
+    MorphologyFilter(Operation operation, size_t width, size_t height)
+    : operation_(operation), width_(width), height_(height) {}
+
+    void Apply(Bitmap& image) override;
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+protected:
+    // Вертикальный проход: для очередной выходной строки получает окно из size строк, начинающееся
+    // с этой строки в изображении, дополненном копиями крайних строк. Выходные строки идут подряд.
+    class VerticalPass {
+    public:
+        VerticalPass(size_t row_size, size_t size, bool is_max)
+        : row_size_(row_size), size_(size), is_max_(is_max), suffix_(row_size * size), prefix_(row_size) {}
+
+        void ComputeRow(const std::vector<const uint8_t*>& window, uint8_t* out);
+
+    protected:
+        size_t row_size_;
+        size_t size_;
+        bool is_max_;
+        size_t row_num_ = 0;
+        // Суффиксные минимумы текущего блока строк и префиксный минимум следующего
+        std::vector<uint8_t> suffix_;
+        std::vector<uint8_t> prefix_;
+    };
+
+    // Один шаг (эрозия или дилатация) операции
+    struct Step {
+        bool is_max;
+        size_t anchor_x; // сколько пикселей окна лежит левее текущего
+        size_t anchor_y; // сколько строк окна лежит перед текущей
+    };
+
+    std::vector<Step> GetSteps() const;
+
+    void ApplyStep(PixelArray& pixels, const Step& step) const;
+
+    // Горизонтальный проход по строке из width пикселей. prefix и padded -- буферы, которые
+    // переиспользуются между строками; в padded строка дополняется и переставляется по блокам,
+    // затем заменяется суффиксами и результатом.
+    void ComputeHorizontal(const uint8_t* row, size_t width, const Step& step, uint8_t* out,
+                           std::vector<uint8_t>& prefix, std::vector<uint8_t>& padded) const;
+
+protected:
+    Operation operation_;
+    size_t width_;
+    size_t height_;
+};
+
+// Детектор границ Кэнни. Яркость (как в GrayscaleFilter) размывается гауссовым ядром с заданным sigma,
+// по размытой яркости считаются градиенты Собеля, и из них остаются только локальные максимумы вдоль
+// направления градиента. Максимум с модулем градиента не меньше high (в долях 255) -- сильная граница,
+// не меньше low -- слабая. Слабые границы остаются, только если они связаны с сильными через соседние
+// (в том числе по диагонали) пиксели. Результат -- белые границы на чёрном фоне.
+// Размытие, градиенты и подавление немаксимумов выполняются одним проходом по строкам полосы: каждый
+// этап хранит только кольцо из нескольких последних строк, а не промежуточное изображение целиком.
+class CannyFilter : public BrightnessFilter {
+public:
+    static const size_t PARAM_NUM = 3;
+    // Коэффициент усиления ядра Собеля: на ступеньке высотой 255 модуль градиента равен 255
+    static constexpr float SOBEL_GAIN = 4;
+
+    // Разметка пикселей после подавления немаксимумов
+    enum Label : uint8_t {
+        NONE,
+        WEAK,
+        STRONG
+    };
+
+public:
+    CannyFilter(double low, double high, double sigma)
+    : low_(static_cast<float>(low * 255)), high_(static_cast<float>(high * 255)) {
+        std::vector<double> kernel = GaussianBlurFilter::MakeKernel(sigma);
+        kernel_.assign(kernel.begin(), kernel.end());
+    }
+
+    void Apply(Bitmap& image) override;
+
+    // Слабая граница может быть связана с сильной через всё изображение, поэтому ни построчная
+    // обработка, ни обработка фрагмента невозможны
+    bool AddStreamStages(StreamPipeline& /*sp*/) const override { return false; }
+
+    std::optional<Region> GetInputRegion(const Region& /*output*/, size_t /*width*/,
+                                         size_t /*height*/) const override {
+        return std::nullopt;
+    }
+
+protected:
+    // Направление градиента, округлённое до 45 градусов
+    enum Direction : uint8_t {
+        ALONG_ROW,     // соседи (i, j - 1) и (i, j + 1)
+        MAIN_DIAGONAL, // соседи (i - 1, j - 1) и (i + 1, j + 1)
+        ALONG_COLUMN,  // соседи (i - 1, j) и (i + 1, j)
+        ANTI_DIAGONAL  // соседи (i + 1, j - 1) и (i - 1, j + 1)
+    };
+
+    struct Gradient {
+        float magnitude;
+        Direction direction;
+    };
+
+    // Размечает строки [band_begin, band_end); labels -- разметка всего изображения по строкам
+    void LabelBand(const PixelArray& pixels, size_t band_begin, size_t band_end, uint8_t* labels) const;
+
+    // Градиенты строки row размытой яркости; prev и next -- соседние строки (крайние строки повторяются)
+    static void ComputeGradientRow(const float* prev, const float* row, const float* next, size_t width,
+                                   Gradient* out);
+
+    // Подавление немаксимумов и пороги; за краем изображения модуль градиента считается нулевым,
+    // и вместо строк за краем передаётся nullptr
+    void SuppressRow(const Gradient* prev, const Gradient* row, const Gradient* next, size_t width,
+                     uint8_t* out) const;
+
+    // Превращает в сильные все слабые границы, связанные с сильными (обход в ширину от сильных границ)
+    static void TraceEdges(std::vector<uint8_t>& labels, size_t height, size_t width);
+
+protected:
+    float low_;
+    float high_;
+    std::vector<float> kernel_;
+};
+
+// Адаптивный порог: пиксель становится белым, если его яркость больше средней яркости в квадрате
+// window x window с центром в нём, уменьшенной на c, и чёрным иначе. Строки и столбцы за краем
+// изображения заменяются крайними. Среднее берётся из интегрального изображения яркости,
+// поэтому время на пиксель не зависит от размера окна.
+class AdaptiveThresholdFilter : public BrightnessFilter {
+public:
+    static const size_t PARAM_NUM = 2;
+    // Изображение дополняется на половину окна с каждой стороны, поэтому окно ограничено
+    static const size_t MAX_WINDOW = 1023;
+
+public:
+    AdaptiveThresholdFilter(size_t window, double c) : radius_(window / 2), c_(c) {}
+
+    void Apply(Bitmap& image) override;
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+protected:
+    // Sum -- тип сумм интегрального изображения, которого хватает для суммы по окну
+    template <typename Sum>
+    void ApplyWithSums(PixelArray& pixels) const;
+
+    uint8_t Threshold(uint8_t brightness, uint64_t window_sum) const {
+        double area = static_cast<double>((2 * radius_ + 1) * (2 * radius_ + 1));
+        return brightness * area > static_cast<double>(window_sum) - c_ * area ? 255 : 0;
+    }
+
+protected:
+    size_t radius_;
+    double c_;
+};
+
+// Выравнивание гистограммы яркости (яркость считается так же, как в GrayscaleFilter). Яркость v
+// заменяется на долю пикселей не ярче v, растянутую на [0, 255], а к каждому каналу пикселя
+// прибавляется то же, что и к его яркости, поэтому оттенки сохраняются.
+// Гистограмма считается параллельно по полосам: у каждого потока свои счётчики, причём соседние
+// пиксели попадают в разные из SUB_HISTOGRAMS копий гистограммы, чтобы подряд идущие увеличения
+// одного счётчика не ждали друг друга.
+class EqualizeFilter : public BrightnessFilter {
+public:
+    static const size_t LEVELS = 256;
+    static const size_t SUB_HISTOGRAMS = 4;
+    using Histogram = std::array<uint32_t, LEVELS>;
+    using Lut = std::array<uint8_t, LEVELS>;
+
+public:
+    void Apply(Bitmap& image) override;
+
+    // Отображение яркости строится по гистограмме всего изображения, поэтому ни построчная обработка,
+    // ни обработка фрагмента невозможны
+    bool AddStreamStages(StreamPipeline& /*sp*/) const override { return false; }
+
+    std::optional<Region> GetInputRegion(const Region& /*output*/, size_t /*width*/,
+                                         size_t /*height*/) const override {
+        return std::nullopt;
+    }
+
+protected:
+    // Прибавляет к гистограммам яркости size пикселей, начиная с row
+    void CountRow(const PixelArray::Pixel* row, size_t size, std::array<Histogram, SUB_HISTOGRAMS>& histograms) const;
+
+    static Histogram MergeHistograms(const std::array<Histogram, SUB_HISTOGRAMS>& histograms);
+
+    // Прибавляет к каналам пикселя разность новой и старой яркости
+    static void ShiftPixel(PixelArray::Pixel& pixel, int delta);
+};
+
+// Выравнивание гистограммы с ограничением контраста (CLAHE). Изображение делится на tiles x tiles
+// прямоугольников, и в каждом строится своё отображение яркости, как в EqualizeFilter, но столбцы
+// гистограммы выше clip средних высот обрезаются, а избыток поровну раздаётся всем столбцам.
+// Яркость пикселя отображается всеми четырьмя ближайшими (по центрам) прямоугольниками, и
+// результаты смешиваются билинейно, поэтому границы прямоугольников не видны.
+class ClaheFilter : public EqualizeFilter {
+public:
+    static const size_t PARAM_NUM = 2;
+
+public:
+    ClaheFilter(size_t tiles, double clip) : tiles_(tiles), clip_(clip) {}
+
+    void Apply(Bitmap& image) override;
+
+protected:
+    // Координата пикселя в сетке центров прямоугольников: ближайший центр не дальше пикселя
+    // и вес следующего центра
+    struct TileWeight {
+        size_t first;
+        size_t second;
+        float weight;
+    };
+
+    static std::vector<TileWeight> GetTileWeights(size_t size, size_t tiles);
+
+    Lut MakeTileLut(Histogram histogram, size_t pixel_num) const;
+
+protected:
+    size_t tiles_;
+    double clip_;
+};
+
+// Аффинное преобразование: точка (x, y) исходного изображения переходит в точку (a x + b y + c, d x + e y + f).
+// Координаты отсчитываются от левого верхнего угла изображения, ось y направлена вниз, центр пикселя
+// в столбце x и строке y (сверху) -- точка (x + 0.5, y + 0.5). Размеры результата совпадают с исходными,
+// точки, не попавшие в исходное изображение, чёрные.
+// Для каждого пикселя результата берётся значение исходного изображения в прообразе его центра.
+// Результат обходится квадратами TILE_SIZE x TILE_SIZE, поэтому читаемые пиксели исходного изображения
+// остаются в кэше, а прообраз соседнего пикселя получается прибавлением постоянного шага.
+class AffineFilter : public BaseFilter {
+public:
+    static const size_t PARAM_NUM = 6;
+    static const size_t PARAM_NUM_WITH_INTERPOLATION = 7;
+    static const size_t TILE_SIZE = 64;
+
+    enum class Interpolation {
+        NEAREST,
+        BILINEAR,
+        BICUBIC // кубическая свёртка Катмулла -- Рома по 4 x 4 пикселям
+    };
+
+    struct Matrix {
+        double a;
+        double b;
+        double c;
+        double d;
+        double e;
+        double f;
+
+        double GetDeterminant() const { return a * e - b * d; }
+
+        Matrix Inverse() const;
+    };
+
+public:
+    AffineFilter(const Matrix& matrix, Interpolation interpolation)
+    : matrix_(matrix), interpolation_(interpolation) {}
+
+    void Apply(Bitmap& image) override;
+
+    AlphaMode GetAlphaMode() const override { return AlphaMode::PREMULTIPLIED; }
+
+protected:
+    // Результат размером width x height преобразования matrix изображения pixels
+    PixelArray Warp(const PixelArray& pixels, size_t width, size_t height, const Matrix& matrix) const;
+
+    template <Interpolation interpolation>
+    static void WarpTile(const PixelArray& pixels, const Matrix& inverse, const Region& tile, PixelArray& result);
+
+protected:
+    Matrix matrix_;
+    Interpolation interpolation_;
+};
+
+// Поворот на degrees градусов против часовой стрелки вокруг центра изображения. Результат -- наименьший
+// прямоугольник, содержащий повёрнутое изображение; углы, не покрытые изображением, чёрные.
+// Повороты на углы, кратные 90 градусам, выполняются точно, без интерполяции: транспонированием
+// по блокам и отражением.
+class RotateFilter : public AffineFilter {
+public:
+    static const size_t PARAM_NUM = 1;
+    static const size_t PARAM_NUM_WITH_INTERPOLATION = 2;
+
+public:
+    RotateFilter(double degrees, Interpolation interpolation);
+
+    void Apply(Bitmap& image) override;
+
+    Size GetOutputSize(size_t width, size_t height) const override;
+
+protected:
+    // Сколько четвертей оборота составляет угол, если он кратен 90 градусам
+    std::optional<size_t> GetQuarterTurns() const;
+
+    static void RotateQuarterTurns(PixelArray& pixels, size_t quarter_turns);
+
+protected:
+    double degrees_;
+};
+
+// Отражение изображения относительно диагонали, идущей из левого верхнего угла: столбцы становятся строками
+class TransposeFilter : public BaseFilter {
+public:
+    void Apply(Bitmap& image) override;
+
+    AlphaMode GetAlphaMode() const override { return AlphaMode::MOVE; }
+
+    Size GetOutputSize(size_t width, size_t height) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    void ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                       size_t height) override;
+};
+
+// Отражение изображения слева направо (horizontal == true) или сверху вниз
+class FlipFilter : public BaseFilter {
+public:
+    static const size_t PARAM_NUM = 1;
+
+public:
+    explicit FlipFilter(bool horizontal) : horizontal_(horizontal) {}
+
+    void Apply(Bitmap& image) override;
+
+    AlphaMode GetAlphaMode() const override { return AlphaMode::MOVE; }
+
+    bool AddStreamStages(StreamPipeline& sp) const override;
+
+    std::optional<Region> GetInputRegion(const Region& output, size_t width, size_t height) const override;
+
+    void ApplyToRegion(Bitmap& image, const Region& input, const Region& output, size_t width,
+                       size_t height) override;
+
+protected:
+    bool horizontal_;
+};
@@ -0,0 +1,135 @@
+// Свёртка с ядром, размеры и коэффициенты которого известны при компиляции. Ядро передаётся
+// параметром шаблона, поэтому компилятор разворачивает цикл по ядру, не генерирует кода для нулевых
+// коэффициентов, а коэффициенты 1 и -1 превращает в сложение и вычитание. Суммы целочисленные, и для
+// целого ядра результат совпадает с PixelMath::ApplyMatrix.
+// Новое ядро -- ещё одна constexpr-константа, например
+//     static constexpr FixedKernel::Kernel<3, 3> EMBOSS = {{{-2, -1, 0}, {-1, 1, 1}, {0, 1, 2}}};
+// которая передаётся в FixedKernel::Apply<EMBOSS> или FixedKernel::ApplyRow<EMBOSS>.
+// Края изображения обрабатываются по правилам из border.h.
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bitmap.h"
+#include "border.h"
+#include "parallel.h"
+
+namespace FixedKernel {
+    // Ядро height x width с целыми коэффициентами. Сумма делится на divisor с округлением, так что
+    // можно задавать и дробные коэффициенты с общим знаменателем.
+    template <size_t Height, size_t Width>
+    struct Kernel {
+        static_assert(Height % 2 == 1 && Width % 2 == 1, "kernel must have a central pixel");
+
+        static const size_t HEIGHT = Height;
+        static const size_t WIDTH = Width;
+
+        int weights[Height][Width];
+        int divisor = 1;
+    };
+
+    namespace Detail {
+        inline uint8_t ToChannel(int sum, int divisor) {
+            if (divisor != 1) {
+                // Округление половины от нуля, как у std::round
+                sum = (sum >= 0 ? sum + divisor / 2 : sum - divisor / 2) / divisor;
+            }
+            return static_cast<uint8_t>(std::clamp(sum, 0, 255));
+        }
+
+        template <auto kernel, size_t Tap, typename ColumnFunction>
+        inline void AddTap(const PixelArray::Pixel* const* rows, const ColumnFunction& column, int* sum) {
+            using KernelType = std::remove_cvref_t<decltype(kernel)>;
+            constexpr size_t tap_row = Tap / KernelType::WIDTH;
+            constexpr size_t tap_column = Tap % KernelType::WIDTH;
+            constexpr int weight = kernel.weights[tap_row][tap_column];
+            if constexpr (weight != 0) {
+                const PixelArray::Pixel& pixel = rows[tap_row][column(tap_column)];
+                if constexpr (weight == 1) {
+                    sum[0] += pixel.red;
+                    sum[1] += pixel.green;
+                    sum[2] += pixel.blue;
+                } else if constexpr (weight == -1) {
+                    sum[0] -= pixel.red;
+                    sum[1] -= pixel.green;
+                    sum[2] -= pixel.blue;
+                } else {
+                    sum[0] += weight * pixel.red;
+                    sum[1] += weight * pixel.green;
+                    sum[2] += weight * pixel.blue;
+                }
+            }
+        }
+
+        // rows -- строки изображения под строками ядра, column(t) -- столбец под столбцом t ядра
+        template <auto kernel, typename ColumnFunction, size_t... Taps>
+        inline PixelArray::Pixel ApplyTaps(const PixelArray::Pixel* const* rows, const ColumnFunction& column,
+                                           std::index_sequence<Taps...>) {
+            int sum[3] = {0, 0, 0};
+            (AddTap<kernel, Taps>(rows, column, sum), ...);
+            return PixelArray::Pixel{ToChannel(sum[0], kernel.divisor), ToChannel(sum[1], kernel.divisor),
+                                     ToChannel(sum[2], kernel.divisor)};
+        }
+    }
+
+    // Считает строку row свёртки pixels с ядром kernel, пиксели за краями изображения заменяются по правилу
+    // border. Без проверок считаются все столбцы, кроме radius крайних с каждой стороны: для них
+    // строки под ядром дополняются полями.
+    template <auto kernel>
+    void ApplyRow(const PixelArray& pixels, size_t row, PixelArray::Pixel* out,
+                  BorderMode border = BorderMode::CLAMP) {
+        using KernelType = std::remove_cvref_t<decltype(kernel)>;
+        constexpr int64_t radius_y = KernelType::HEIGHT / 2;
+        constexpr int64_t radius_x = KernelType::WIDTH / 2;
+        constexpr auto taps = std::make_index_sequence<KernelType::HEIGHT * KernelType::WIDTH>();
+        int64_t width = static_cast<int64_t>(pixels.GetWidth());
+        if (width == 0) {
+            return;
+        }
+        std::vector<PixelArray::Pixel> black_row;
+        const PixelArray::Pixel* rows[KernelType::HEIGHT];
+        for (int64_t i = 0; i < static_cast<int64_t>(KernelType::HEIGHT); ++i) {
+            rows[i] = Border::GetRow(pixels, static_cast<int64_t>(row) + i - radius_y, border, black_row);
+        }
+        // Столбцы begin ... end - 1 считаются по строкам, дополненным полями
+        auto apply_at_border = [&](int64_t begin, int64_t end) {
+            PixelArray::Pixel padded[KernelType::HEIGHT][3 * radius_x + 1];
+            const PixelArray::Pixel* padded_rows[KernelType::HEIGHT];
+            for (size_t i = 0; i < KernelType::HEIGHT; ++i) {
+                Border::PadRow(rows[i], width, begin - radius_x, end + radius_x, border, padded[i]);
+                padded_rows[i] = padded[i];
+            }
+            for (int64_t j = begin; j < end; ++j) {
+                out[j] = Detail::ApplyTaps<kernel>(padded_rows, [j, begin](size_t tap_column) {
+                    return j - begin + static_cast<int64_t>(tap_column);
+                }, taps);
+            }
+        };
+        int64_t interior_begin = std::min(radius_x, width);
+        int64_t interior_end = std::max(interior_begin, width - radius_x);
+        apply_at_border(0, interior_begin);
+        for (int64_t j = interior_begin; j < interior_end; ++j) {
+            out[j] = Detail::ApplyTaps<kernel>(rows, [j](size_t tap_column) {
+                return j + static_cast<int64_t>(tap_column) - radius_x;
+            }, taps);
+        }
+        apply_at_border(interior_end, width);
+    }
+
+    // Свёртка всего изображения; полосы строк считаются параллельно
+    template <auto kernel>
+    PixelArray Apply(const PixelArray& pixels, BorderMode border = BorderMode::CLAMP) {
+        PixelArray result(pixels.GetHeight(), pixels.GetWidth());
+        Parallel::ForBands(0, pixels.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            for (size_t i = band_begin; i < band_end; ++i) {
+                ApplyRow<kernel>(pixels, i, &result(i, 0), border);
+            }
+        });
+        return result;
+    }
+}
@@ -0,0 +1,148 @@
+#include "float_image.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+FloatImage::FloatImage(const PixelArray& pixels) : FloatImage(pixels.GetHeight(), pixels.GetWidth()) {
+    Parallel::ForBands(0, height_, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            const PixelArray::Pixel* row = &pixels(i, 0);
+            float* out = GetChannels(i);
+            for (size_t j = 0; j < width_; ++j) {
+                out[j * CHANNELS] = row[j].red;
+                out[j * CHANNELS + 1] = row[j].green;
+                out[j * CHANNELS + 2] = row[j].blue;
+            }
+        }
+    });
+}
+
+void FloatImage::Quantize(PixelArray& pixels) const {
+    auto to_channel = [](float value) {
+        return static_cast<uint8_t>(std::clamp(value + 0.5f, 0.0f, 255.0f));
+    };
+    pixels.Resize(height_, width_);
+    Parallel::ForBands(0, height_, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            const float* row = GetChannels(i);
+            PixelArray::Pixel* out = &pixels(i, 0);
+            for (size_t j = 0; j < width_; ++j) {
+                out[j] = PixelArray::Pixel{to_channel(row[j * CHANNELS]), to_channel(row[j * CHANNELS + 1]),
+                                           to_channel(row[j * CHANNELS + 2])};
+            }
+        }
+    });
+}
+
+void FloatImage::Cut(const Region& region) {
+    if (region.row == 0 && region.column == 0 && region.height == height_ && region.width == width_) {
+        return;
+    }
+    FloatImage result(region.height, region.width);
+    for (size_t i = 0; i < region.height; ++i) {
+        const float* row = GetChannels(region.row + i) + region.column * CHANNELS;
+        std::copy(row, row + region.width * CHANNELS, result.GetChannels(i));
+    }
+    *this = std::move(result);
+}
+
+namespace {
+    // То же, что Border::PadRow, для строки из width пикселей по FloatImage::CHANNELS каналов
+    void PadChannels(const float* row, int64_t width, int64_t begin, int64_t end, BorderMode border, float* out) {
+        const int64_t channels = FloatImage::CHANNELS;
+        int64_t inner_begin = std::clamp<int64_t>(begin, 0, width);
+        int64_t inner_end = std::clamp<int64_t>(end, inner_begin, width);
+        auto pad = [row, width, border, begin, out](int64_t column) {
+            int64_t source = Border::Resolve(column, width, border);
+            float* pixel = out + (column - begin) * channels;
+            if (source >= 0) {
+                std::copy(row + source * channels, row + (source + 1) * channels, pixel);
+            } else {
+                std::fill(pixel, pixel + channels, 0.0f);
+            }
+        };
+        for (int64_t j = begin; j < std::min(inner_begin, end); ++j) {
+            pad(j);
+        }
+        std::copy(row + inner_begin * channels, row + inner_end * channels, out + (inner_begin - begin) * channels);
+        for (int64_t j = std::max(inner_end, begin); j < end; ++j) {
+            pad(j);
+        }
+    }
+}
+
+namespace FloatMath {
+    FloatImage Convolve(const FloatImage& image, const Kernel& kernel, BorderMode border) {
+        int64_t height = static_cast<int64_t>(image.GetHeight());
+        int64_t width = static_cast<int64_t>(image.GetWidth());
+        int64_t radius_y = static_cast<int64_t>(kernel.size() / 2);
+        int64_t radius_x = static_cast<int64_t>(kernel[0].size() / 2);
+        size_t channels = static_cast<size_t>(width) * FloatImage::CHANNELS;
+        FloatImage result(image.GetHeight(), image.GetWidth());
+        Parallel::ForBands(0, image.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            std::vector<float> padded((width + 2 * radius_x) * FloatImage::CHANNELS);
+            for (size_t i = band_begin; i < band_end; ++i) {
+                float* out = result.GetChannels(i);
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    int64_t row = Border::Resolve(static_cast<int64_t>(i + k) - radius_y, height, border);
+                    if (row < 0) {
+                        // За краем чёрная строка, её вклад нулевой
+                        continue;
+                    }
+                    PadChannels(image.GetChannels(row), width, -radius_x, width + radius_x, border, padded.data());
+                    for (size_t l = 0; l < kernel[k].size(); ++l) {
+                        float weight = kernel[k][l];
+                        if (weight == 0) {
+                            continue;
+                        }
+                        const float* taps = padded.data() + l * FloatImage::CHANNELS;
+                        for (size_t c = 0; c < channels; ++c) {
+                            out[c] += weight * taps[c];
+                        }
+                    }
+                }
+            }
+        });
+        return result;
+    }
+
+    FloatImage ConvolveSeparable(const FloatImage& image, const std::vector<float>& kernel, BorderMode border) {
+        int64_t height = static_cast<int64_t>(image.GetHeight());
+        int64_t width = static_cast<int64_t>(image.GetWidth());
+        int64_t radius = static_cast<int64_t>(kernel.size() / 2);
+        size_t channels = static_cast<size_t>(width) * FloatImage::CHANNELS;
+        FloatImage horizontal(image.GetHeight(), image.GetWidth());
+        Parallel::ForBands(0, image.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            std::vector<float> padded((width + 2 * radius) * FloatImage::CHANNELS);
+            for (size_t i = band_begin; i < band_end; ++i) {
+                PadChannels(image.GetChannels(i), width, -radius, width + radius, border, padded.data());
+                float* out = horizontal.GetChannels(i);
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    const float* taps = padded.data() + k * FloatImage::CHANNELS;
+                    for (size_t c = 0; c < channels; ++c) {
+                        out[c] += kernel[k] * taps[c];
+                    }
+                }
+            }
+        });
+        FloatImage result(image.GetHeight(), image.GetWidth());
+        Parallel::ForBands(0, image.GetHeight(), [&](size_t band_begin, size_t band_end) {
+            for (size_t i = band_begin; i < band_end; ++i) {
+                float* out = result.GetChannels(i);
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    int64_t row = Border::Resolve(static_cast<int64_t>(i + k) - radius, height, border);
+                    if (row < 0) {
+                        continue;
+                    }
+                    const float* taps = horizontal.GetChannels(row);
+                    for (size_t c = 0; c < channels; ++c) {
+                        out[c] += kernel[k] * taps[c];
+                    }
+                }
+            }
+        });
+        return result;
+    }
+}
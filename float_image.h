@@ -0,0 +1,68 @@
+// Изображение с каналами float для режима повышенной точности. Конвейер один раз переводит изображение
+// в FloatImage, фильтры цепочки работают с ним без промежуточных округлений и ограничений 0-255,
+// и только результат один раз округляется до 8 бит. Строки, как и в PixelArray, идут снизу вверх.
+// Каналы хранятся одним массивом float, по CHANNELS на пиксель, поэтому строку можно обрабатывать
+// как массив CHANNELS * width чисел, и циклы по нему компилятор векторизует.
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include "base_filter.h"
+#include "border.h"
+
+class FloatImage {
+public:
+    static const size_t CHANNELS = 3;
+
+public:
+    FloatImage() = default;
+
+    FloatImage(size_t height, size_t width) : height_(height), width_(width), channels_(height * width * CHANNELS) {}
+
+    explicit FloatImage(const PixelArray& pixels);
+
+    size_t GetHeight() const { return height_; }
+
+    size_t GetWidth() const { return width_; }
+
+    // Каналы строки row подряд: red, green, blue первого пикселя, затем второго и так далее
+    float* GetChannels(size_t row) { return channels_.data() + row * width_ * CHANNELS; }
+
+    const float* GetChannels(size_t row) const { return channels_.data() + row * width_ * CHANNELS; }
+
+    // Округляет каналы до ближайших целых в пределах 0-255
+    void Quantize(PixelArray& pixels) const;
+
+    // Оставляет область region
+    void Cut(const Region& region);
+
+protected:
+    size_t height_ = 0;
+    size_t width_ = 0;
+    std::vector<float> channels_;
+};
+
+namespace FloatMath {
+    using Kernel = std::vector<std::vector<float>>;
+
+    // Свёртка с ядром kernel нечётных размеров; строка i ядра соответствует строке row + i - radius
+    // изображения, как в PixelMath::ApplyMatrix. Строки под ядром дополняются полями по правилу border,
+    // и каждый ненулевой коэффициент прибавляется ко всей строке результата одним векторизуемым циклом.
+    FloatImage Convolve(const FloatImage& image, const Kernel& kernel, BorderMode border);
+
+    // Свёртка с ядром kernel^T * kernel: сначала по строкам, затем по столбцам
+    FloatImage ConvolveSeparable(const FloatImage& image, const std::vector<float>& kernel, BorderMode border);
+
+    // Коэффициенты ядра из fixed_kernel.h с учётом делителя
+    template <typename FixedKernelType>
+    Kernel ToKernel(const FixedKernelType& fixed) {
+        Kernel kernel(FixedKernelType::HEIGHT, std::vector<float>(FixedKernelType::WIDTH));
+        for (size_t i = 0; i < FixedKernelType::HEIGHT; ++i) {
+            for (size_t j = 0; j < FixedKernelType::WIDTH; ++j) {
+                kernel[i][j] = static_cast<float>(fixed.weights[i][j]) / static_cast<float>(fixed.divisor);
+            }
+        }
+        return kernel;
+    }
+}
@@ -0,0 +1,247 @@
+#include "image_pyramid.h"
+#include "border.h"
+#include "parallel.h"
+
+namespace PyramidMath {
+    const PixelMath::Matrix& GetReduceKernel() {
+        static const PixelMath::Matrix KERNEL = {{1.0 / 16, 4.0 / 16, 6.0 / 16, 4.0 / 16, 1.0 / 16}};
+        return KERNEL;
+    }
+
+    PixelArray Reduce(const PixelArray& pixels) {
+        const std::vector<double>& kernel = GetReduceKernel()[0];
+        const int64_t radius = static_cast<int64_t>(kernel.size() / 2);
+        size_t height = pixels.GetHeight();
+        int64_t width = static_cast<int64_t>(pixels.GetWidth());
+        size_t new_height = (height + 1) / 2;
+        size_t new_width = (pixels.GetWidth() + 1) / 2;
+        if (height == 0 || width == 0) {
+            return PixelArray(new_height, new_width);
+        }
+        auto to_channel = [](double value) {
+            return static_cast<uint8_t>(std::min(255, std::max(0, static_cast<int>(std::round(value)))));
+        };
+        // Горизонтальный проход считается только в чётных столбцах, вертикальный -- только в чётных строках.
+        // Края обрабатываются по правилу BorderMode::CLAMP: строка один раз дополняется полями, а строки
+        // под ядром выбираются заранее, так что сами отсчёты считаются без проверок.
+        PixelArray new_width_pixels(height, new_width);
+        Parallel::ForBands(0, height, [&](size_t band_begin, size_t band_end) {
+            std::vector<PixelArray::Pixel> padded(width + 2 * radius);
+            for (size_t i = band_begin; i < band_end; ++i) {
+                Border::PadRow(&pixels(i, 0), width, -radius, width + radius, BorderMode::CLAMP, padded.data());
+                for (size_t j = 0; j < new_width; ++j) {
+                    const PixelArray::Pixel* taps = &padded[j * 2];
+                    double red = 0;
+                    double green = 0;
+                    double blue = 0;
+                    for (size_t k = 0; k < kernel.size(); ++k) {
+                        red += kernel[k] * taps[k].red;
+                        green += kernel[k] * taps[k].green;
+                        blue += kernel[k] * taps[k].blue;
+                    }
+                    new_width_pixels(i, j) = PixelArray::Pixel{to_channel(red), to_channel(green), to_channel(blue)};
+                }
+            }
+        });
+        PixelArray new_pixels(new_height, new_width);
+        Parallel::ForBands(0, new_height, [&](size_t band_begin, size_t band_end) {
+            std::vector<PixelArray::Pixel> black_row;
+            std::vector<const PixelArray::Pixel*> rows(kernel.size());
+            for (size_t i = band_begin; i < band_end; ++i) {
+                for (size_t k = 0; k < kernel.size(); ++k) {
+                    int64_t row = static_cast<int64_t>(i * 2 + k) - radius;
+                    rows[k] = Border::GetRow(new_width_pixels, row, BorderMode::CLAMP, black_row);
+                }
+                for (size_t j = 0; j < new_width; ++j) {
+                    double red = 0;
+                    double green = 0;
+                    double blue = 0;
+                    for (size_t k = 0; k < kernel.size(); ++k) {
+                        red += kernel[k] * rows[k][j].red;
+                        green += kernel[k] * rows[k][j].green;
+                        blue += kernel[k] * rows[k][j].blue;
+                    }
+                    new_pixels(i, j) = PixelArray::Pixel{to_channel(red), to_channel(green), to_channel(blue)};
+                }
+            }
+        });
+        return new_pixels;
+    }
+
+    namespace {
+        // Одна строка (или столбец) при увеличении вдвое: чётные выходные отсчёты берутся с весами
+        // [1 6 1] / 8, нечётные -- [4 4] / 8. Это то же ядро [1 4 6 4 1] / 16, применённое
+        // к изображению, в которое вставлены нули, и умноженное на 2.
+        void ExpandLine(const double* in, size_t in_size, size_t in_stride,
+                        double* out, size_t out_size, size_t out_stride) {
+            auto get = [in, in_size, in_stride](int64_t index) {
+                return in[std::clamp<int64_t>(index, 0, static_cast<int64_t>(in_size) - 1) * in_stride];
+            };
+            for (size_t x = 0; x < out_size; ++x) {
+                int64_t center = static_cast<int64_t>(x / 2);
+                if (x % 2 == 0) {
+                    out[x * out_stride] = (get(center - 1) + 6 * get(center) + get(center + 1)) / 8;
+                } else {
+                    out[x * out_stride] = (get(center) + get(center + 1)) / 2;
+                }
+            }
+        }
+    }
+
+    PixelArray Expand(const PixelArray& pixels, size_t height, size_t width) {
+        const size_t CHANNELS = 3;
+        size_t in_height = pixels.GetHeight();
+        size_t in_width = pixels.GetWidth();
+        std::vector<double> source(in_height * in_width * CHANNELS);
+        for (size_t i = 0; i < in_height; ++i) {
+            for (size_t j = 0; j < in_width; ++j) {
+                double* current = &source[(i * in_width + j) * CHANNELS];
+                current[0] = pixels(i, j).red;
+                current[1] = pixels(i, j).green;
+                current[2] = pixels(i, j).blue;
+            }
+        }
+        std::vector<double> new_width_values(in_height * width * CHANNELS);
+        for (size_t i = 0; i < in_height; ++i) {
+            for (size_t c = 0; c < CHANNELS; ++c) {
+                ExpandLine(&source[i * in_width * CHANNELS + c], in_width, CHANNELS,
+                           &new_width_values[i * width * CHANNELS + c], width, CHANNELS);
+            }
+        }
+        std::vector<double> new_values(height * width * CHANNELS);
+        for (size_t j = 0; j < width * CHANNELS; ++j) {
+            ExpandLine(&new_width_values[j], in_height, width * CHANNELS,
+                       &new_values[j], height, width * CHANNELS);
+        }
+        PixelArray new_pixels(height, width);
+        auto to_channel = [](double value) {
+            return static_cast<uint8_t>(std::clamp(static_cast<int>(std::round(value)), 0, 255));
+        };
+        for (size_t i = 0; i < height; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                const double* current = &new_values[(i * width + j) * CHANNELS];
+                new_pixels(i, j) = PixelArray::Pixel{to_channel(current[0]), to_channel(current[1]),
+                                                     to_channel(current[2])};
+            }
+        }
+        return new_pixels;
+    }
+
+    void PyramidBlur(PixelArray& pixels, double sigma) {
+        // Уменьшение и увеличение на уровне k добавляют размытие с дисперсией 4^k каждое,
+        // поэтому после level уровней накоплено 2 * (4^level - 1) / 3
+        std::vector<std::pair<size_t, size_t>> sizes;
+        double accumulated_variance = 0;
+        double level_scale = 1;
+        PixelArray level = pixels;
+        while (level.GetWidth() > 1 && level.GetHeight() > 1 &&
+               accumulated_variance + 2 * level_scale * level_scale <= sigma * sigma) {
+            sizes.emplace_back(level.GetHeight(), level.GetWidth());
+            level = Reduce(level);
+            accumulated_variance += 2 * level_scale * level_scale;
+            level_scale *= 2;
+        }
+        double coarse_sigma = std::sqrt(sigma * sigma - accumulated_variance) / level_scale;
+        // Меньшее sigma даёт ядро из одной точки
+        if (coarse_sigma > 1.0 / 3) {
+            Bitmap holder;
+            holder.GetPixels() = std::move(level);
+            GaussianBlurFilter(coarse_sigma).Apply(holder);
+            level = std::move(holder.GetPixels());
+        }
+        for (size_t i = sizes.size(); i > 0; --i) {
+            level = Expand(level, sizes[i - 1].first, sizes[i - 1].second);
+        }
+        pixels = std::move(level);
+    }
+}
+
+GaussianPyramid::GaussianPyramid(const PixelArray& pixels, size_t max_levels) {
+    size_t width = pixels.GetWidth();
+    size_t height = pixels.GetHeight();
+    size_t total_size = 0;
+    while (levels_.size() < max_levels && width > 0 && height > 0) {
+        levels_.push_back({total_size, width, height});
+        total_size += width * height;
+        if (width == 1 && height == 1) {
+            break;
+        }
+        width = (width + 1) / 2;
+        height = (height + 1) / 2;
+    }
+    arena_.resize(total_size);
+    PixelArray level = pixels;
+    for (size_t k = 0; k < levels_.size(); ++k) {
+        if (k > 0) {
+            level = PyramidMath::Reduce(level);
+        }
+        for (size_t i = 0; i < levels_[k].height; ++i) {
+            std::copy(&level(i, 0), &level(i, 0) + levels_[k].width,
+                      arena_.begin() + static_cast<std::ptrdiff_t>(levels_[k].offset + levels_[k].width * i));
+        }
+    }
+}
+
+PixelArray GaussianPyramid::GetLevel(size_t level) const {
+    PixelArray result(levels_[level].height, levels_[level].width);
+    for (size_t i = 0; i < levels_[level].height; ++i) {
+        for (size_t j = 0; j < levels_[level].width; ++j) {
+            result(i, j) = (*this)(level, i, j);
+        }
+    }
+    return result;
+}
+
+LaplacianPyramid::LaplacianPyramid(const PixelArray& pixels, size_t max_levels) {
+    GaussianPyramid gaussian(pixels, max_levels);
+    size_t total_size = 0;
+    for (size_t k = 0; k < gaussian.GetLevelNum(); ++k) {
+        levels_.push_back({total_size, gaussian.GetWidth(k), gaussian.GetHeight(k)});
+        total_size += gaussian.GetWidth(k) * gaussian.GetHeight(k);
+    }
+    arena_.resize(total_size);
+    PixelArray next_level;
+    for (size_t k = levels_.size(); k > 0; --k) {
+        size_t level = k - 1;
+        PixelArray expanded;
+        if (level + 1 < levels_.size()) {
+            expanded = PyramidMath::Expand(next_level, levels_[level].height, levels_[level].width);
+        }
+        for (size_t i = 0; i < levels_[level].height; ++i) {
+            for (size_t j = 0; j < levels_[level].width; ++j) {
+                const PixelArray::Pixel& current = gaussian(level, i, j);
+                PixelArray::Pixel base = expanded.GetHeight() ? expanded(i, j) : PixelArray::Pixel{0, 0, 0};
+                (*this)(level, i, j) = SignedPixel{static_cast<int16_t>(current.red - base.red),
+                                                   static_cast<int16_t>(current.green - base.green),
+                                                   static_cast<int16_t>(current.blue - base.blue)};
+            }
+        }
+        next_level = gaussian.GetLevel(level);
+    }
+}
+
+PixelArray LaplacianPyramid::Reconstruct() const {
+    PixelArray result;
+    auto to_channel = [](int value) {
+        return static_cast<uint8_t>(std::clamp(value, 0, 255));
+    };
+    for (size_t k = levels_.size(); k > 0; --k) {
+        size_t level = k - 1;
+        PixelArray expanded;
+        if (level + 1 < levels_.size()) {
+            expanded = PyramidMath::Expand(result, levels_[level].height, levels_[level].width);
+        }
+        result.Resize(0, 0);
+        result.Resize(levels_[level].height, levels_[level].width);
+        for (size_t i = 0; i < levels_[level].height; ++i) {
+            for (size_t j = 0; j < levels_[level].width; ++j) {
+                const SignedPixel& current = (*this)(level, i, j);
+                PixelArray::Pixel base = expanded.GetHeight() ? expanded(i, j) : PixelArray::Pixel{0, 0, 0};
+                result(i, j) = PixelArray::Pixel{to_channel(base.red + current.red),
+                                                 to_channel(base.green + current.green),
+                                                 to_channel(base.blue + current.blue)};
+            }
+        }
+    }
+    return result;
+}
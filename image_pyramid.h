@@ -0,0 +1,103 @@
+// Гауссова и лапласова пирамиды изображения (Burt, Adelson).
+// Уровень k + 1 гауссовой пирамиды -- это уровень k, размытый 5-точечным ядром [1 4 6 4 1] / 16
+// и прореженный вдвое по каждой оси. Уровень k лапласовой пирамиды -- разность уровня k гауссовой
+// пирамиды и увеличенного вдвое уровня k + 1, последний уровень совпадает с последним уровнем гауссовой.
+// Уровни каждой пирамиды хранятся подряд в одном непрерывном массиве.
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "bitmap.h"
+#include "filters.h"
+
+namespace PyramidMath {
+    // 5-точечное ядро [1 4 6 4 1] / 16
+    const PixelMath::Matrix& GetReduceKernel();
+
+    // Размывает изображение ядром GetReduceKernel и прореживает вдвое
+    PixelArray Reduce(const PixelArray& pixels);
+
+    // Увеличивает изображение до размеров (height, width), где height и width -- размеры уровня,
+    // из которого pixels был получен функцией Reduce
+    PixelArray Expand(const PixelArray& pixels, size_t height, size_t width);
+
+    // Быстрое размытие с большим sigma: изображение уменьшается по гауссовой пирамиде,
+    // доразмывается на грубом уровне фильтром GaussianBlurFilter с меньшим sigma
+    // и увеличивается обратно функцией Expand тем же ядром [1 4 6 4 1] / 16. Размытие, которое вносит
+    // это ядро при уменьшении и увеличении, учитывается при выборе sigma для грубого уровня.
+    void PyramidBlur(PixelArray& pixels, double sigma);
+}
+
+class GaussianPyramid {
+public:
+    // Строит не более max_levels уровней (уровень 0 -- само изображение); построение
+    // останавливается раньше, если уровень стал размером 1 x 1
+    GaussianPyramid(const PixelArray& pixels, size_t max_levels);
+
+    size_t GetLevelNum() const { return levels_.size(); }
+
+    size_t GetWidth(size_t level) const { return levels_[level].width; }
+
+    size_t GetHeight(size_t level) const { return levels_[level].height; }
+
+    const PixelArray::Pixel& operator()(size_t level, size_t row, size_t column) const {
+        return arena_[levels_[level].offset + levels_[level].width * row + column];
+    }
+
+    // Копия уровня в виде отдельного изображения
+    PixelArray GetLevel(size_t level) const;
+
+protected:
+    struct Level {
+        size_t offset;
+        size_t width;
+        size_t height;
+    };
+
+protected:
+    std::vector<Level> levels_;
+    std::vector<PixelArray::Pixel> arena_;
+};
+
+class LaplacianPyramid {
+public:
+    // Разность двух пикселей может быть отрицательной
+    struct SignedPixel {
+        int16_t red;
+        int16_t green;
+        int16_t blue;
+    };
+
+public:
+    LaplacianPyramid(const PixelArray& pixels, size_t max_levels);
+
+    size_t GetLevelNum() const { return levels_.size(); }
+
+    size_t GetWidth(size_t level) const { return levels_[level].width; }
+
+    size_t GetHeight(size_t level) const { return levels_[level].height; }
+
+    // Уровни можно менять (например, для смешивания изображений по частотам) и затем восстановить результат
+    SignedPixel& operator()(size_t level, size_t row, size_t column) {
+        return arena_[levels_[level].offset + levels_[level].width * row + column];
+    }
+
+    const SignedPixel& operator()(size_t level, size_t row, size_t column) const {
+        return arena_[levels_[level].offset + levels_[level].width * row + column];
+    }
+
+    // Восстанавливает изображение по пирамиде. Для неизменённой пирамиды восстановление точное.
+    PixelArray Reconstruct() const;
+
+protected:
+    struct Level {
+        size_t offset;
+        size_t width;
+        size_t height;
+    };
+
+protected:
+    std::vector<Level> levels_;
+    std::vector<SignedPixel> arena_;
+};
@@ -0,0 +1,86 @@
+#include "integral_image.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <iterator>
+#include <mutex>
+
+template <typename Sum>
+IntegralImage<Sum>::IntegralImage(const PixelArray& pixels, bool square)
+: IntegralImage(pixels.GetHeight(), pixels.GetWidth(), PIXEL_CHANNELS, [&pixels, square](size_t row, Sum* out) {
+    const PixelArray::Pixel* current = &pixels(row, 0);
+    for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+        Sum red = current[j].red;
+        Sum green = current[j].green;
+        Sum blue = current[j].blue;
+        out[j * PIXEL_CHANNELS] = square ? red * red : red;
+        out[j * PIXEL_CHANNELS + 1] = square ? green * green : green;
+        out[j * PIXEL_CHANNELS + 2] = square ? blue * blue : blue;
+    }
+}) {}
+
+template <typename Sum>
+IntegralImage<Sum>::IntegralImage(const std::vector<uint8_t>& values, size_t height, size_t width, bool square)
+: IntegralImage(height, width, 1, [&values, width, square](size_t row, Sum* out) {
+    const uint8_t* current = &values[row * width];
+    for (size_t j = 0; j < width; ++j) {
+        Sum value = current[j];
+        out[j] = square ? value * value : value;
+    }
+}) {}
+
+template <typename Sum>
+IntegralImage<Sum>::IntegralImage(size_t height, size_t width, size_t channels, const RowFunction& fill_row)
+: height_(height), width_(width), channels_(channels), table_((height + 1) * (width + 1) * channels) {
+    Build(fill_row);
+}
+
+template <typename Sum>
+void IntegralImage<Sum>::Build(const RowFunction& fill_row) {
+    size_t row_size = (width_ + 1) * channels_;
+    // Полосы строк исходного изображения [begin, end); им соответствуют строки таблицы begin + 1 ... end
+    std::vector<std::pair<size_t, size_t>> bands;
+    std::mutex bands_mutex;
+    Parallel::ForBands(0, height_, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            Sum* row = GetRow(i + 1);
+            fill_row(i, row + channels_);
+            for (size_t j = channels_; j < row_size; ++j) {
+                row[j] += row[j - channels_];
+            }
+            if (i > band_begin) {
+                const Sum* prev = GetRow(i);
+                for (size_t j = 0; j < row_size; ++j) {
+                    row[j] += prev[j];
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(bands_mutex);
+        bands.emplace_back(band_begin, band_end);
+    });
+    std::sort(bands.begin(), bands.end());
+    for (size_t k = 1; k < bands.size(); ++k) {
+        Sum* last = GetRow(bands[k].second);
+        const Sum* prev = GetRow(bands[k].first);
+        for (size_t j = 0; j < row_size; ++j) {
+            last[j] += prev[j];
+        }
+    }
+    Parallel::ForBands(0, height_, [&](size_t band_begin, size_t band_end) {
+        for (size_t i = band_begin; i < band_end; ++i) {
+            // Полоса первого прохода, в которую попала строка i
+            auto band = std::prev(std::upper_bound(bands.begin(), bands.end(), std::make_pair(i, SIZE_MAX)));
+            if (band->first == 0 || i + 1 == band->second) {
+                continue;
+            }
+            Sum* row = GetRow(i + 1);
+            const Sum* offset = GetRow(band->first);
+            for (size_t j = 0; j < row_size; ++j) {
+                row[j] += offset[j];
+            }
+        }
+    });
+}
+
+template class IntegralImage<uint32_t>;
+template class IntegralImage<uint64_t>;
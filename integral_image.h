@@ -0,0 +1,73 @@
+// Интегральное изображение (таблица сумм). Элемент (i, j) таблицы -- сумма значений в строках [0, i)
+// и столбцах [0, j), поэтому сумма по любому прямоугольнику получается из четырёх элементов за O(1).
+// Суммы хранятся в беззнаковом типе Sum по модулю 2^N: даже если суммы всей таблицы переполнились,
+// сумма прямоугольника верна, пока она сама помещается в Sum. Поэтому тип выбирается по площади
+// самого большого запрашиваемого прямоугольника (IntegralImageMath::Fits), и для окон площадью
+// до 2^32 / 255 пикселей хватает вдвое более компактных 32-битных сумм.
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <vector>
+#include "base_filter.h"
+
+namespace IntegralImageMath {
+    // Помещается ли в Sum сумма area значений, каждое из которых не больше max_value
+    template <typename Sum>
+    bool Fits(size_t area, uint64_t max_value) {
+        return max_value == 0 || area <= std::numeric_limits<Sum>::max() / max_value;
+    }
+}
+
+template <typename Sum>
+class IntegralImage {
+public:
+    static const size_t PIXEL_CHANNELS = 3; // red, green, blue
+
+    // Заполняет channels * width значений строки row исходного изображения
+    using RowFunction = std::function<void(size_t row, Sum* out)>;
+
+public:
+    // Суммы каналов пикселей (или их квадратов, если square == true, -- для дисперсии)
+    explicit IntegralImage(const PixelArray& pixels, bool square = false);
+
+    // Суммы одного канала values, записанного по строкам height x width
+    IntegralImage(const std::vector<uint8_t>& values, size_t height, size_t width, bool square = false);
+
+    // Таблица height x width с channels каналами, строки исходного изображения заполняет fill_row
+    IntegralImage(size_t height, size_t width, size_t channels, const RowFunction& fill_row);
+
+    size_t GetHeight() const { return height_; }
+
+    size_t GetWidth() const { return width_; }
+
+    size_t GetChannels() const { return channels_; }
+
+    // Сумма канала channel по области region
+    Sum GetSum(const Region& region, size_t channel = 0) const {
+        size_t top = region.row + region.height;
+        size_t right = region.column + region.width;
+        return At(top, right, channel) - At(region.row, right, channel) - At(top, region.column, channel) +
+               At(region.row, region.column, channel);
+    }
+
+protected:
+    const Sum& At(size_t row, size_t column, size_t channel) const {
+        return table_[(row * (width_ + 1) + column) * channels_ + channel];
+    }
+
+    Sum* GetRow(size_t row) { return &table_[row * (width_ + 1) * channels_]; }
+
+    // Префиксные суммы по строкам и столбцам. Полосы строк считаются параллельно, каждая от нуля;
+    // затем к последней строке каждой полосы по порядку прибавляется последняя строка предыдущей,
+    // и наконец остальные строки полос параллельно получают ту же добавку.
+    void Build(const RowFunction& fill_row);
+
+protected:
+    size_t height_;
+    size_t width_;
+    size_t channels_;
+    std::vector<Sum> table_;
+};
@@ -0,0 +1,51 @@
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace Parallel {
+    namespace {
+        std::atomic<size_t> thread_num_override = 0;
+    }
+
+    size_t GetThreadNum() {
+        if (thread_num_override > 0) {
+            return thread_num_override;
+        }
+        return std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    void SetThreadNum(size_t thread_num) {
+        thread_num_override = thread_num;
+    }
+
+    void ForBands(size_t begin, size_t end, const BandFunction& function) {
+        if (begin >= end) {
+            return;
+        }
+        size_t band_num = std::min(GetThreadNum(), std::max<size_t>(1, (end - begin) / MIN_BAND_HEIGHT));
+        if (band_num == 1) {
+            function(begin, end);
+            return;
+        }
+        std::vector<std::thread> threads;
+        size_t band_height = (end - begin) / band_num;
+        size_t remainder = (end - begin) % band_num;
+        size_t band_begin = begin;
+        for (size_t i = 0; i < band_num; ++i) {
+            size_t band_end = band_begin + band_height + (i < remainder ? 1 : 0);
+            // Последняя полоса считается в текущем потоке
+            if (i + 1 == band_num) {
+                function(band_begin, band_end);
+            } else {
+                threads.emplace_back(function, band_begin, band_end);
+            }
+            band_begin = band_end;
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+    }
+}
@@ -0,0 +1,24 @@
+// Параллельная обработка изображения полосами строк. Диапазон строк делится на полосы примерно
+// одинаковой высоты, и каждая полоса обрабатывается в своём потоке. Полосы не пересекаются,
+// поэтому функция может без синхронизации писать в свои строки результата.
+
+#pragma once
+
+#include <cstddef>
+#include <functional>
+
+namespace Parallel {
+    // Полоса короче этого числа строк не выделяется в отдельный поток
+    const size_t MIN_BAND_HEIGHT = 16;
+
+    using BandFunction = std::function<void(size_t band_begin, size_t band_end)>;
+
+    // Число потоков: std::thread::hardware_concurrency() или значение, заданное SetThreadNum
+    size_t GetThreadNum();
+
+    // 0 возвращает число потоков по умолчанию
+    void SetThreadNum(size_t thread_num);
+
+    // Вызывает function для полос, покрывающих [begin, end), и ждёт завершения всех полос
+    void ForBands(size_t begin, size_t end, const BandFunction& function);
+}
@@ -0,0 +1,50 @@
+// Аппаратные счётчики производительности процессора (Linux perf_event_open).
+// На других системах, а также если ядро запрещает доступ к счётчикам, все счётчики
+// считаются недоступными и программа продолжает работать без них.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string_view>
+
+class PerfCounters {
+public:
+    enum Event {
+        CYCLES,
+        INSTRUCTIONS,
+        CACHE_MISSES,
+        BRANCH_MISSES,
+        DTLB_MISSES,
+        EVENT_NUM
+    };
+    static const std::array<std::string_view, EVENT_NUM> EVENT_NAMES;
+
+    using Values = std::array<uint64_t, EVENT_NUM>;
+
+public:
+    PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    ~PerfCounters();
+
+    // Удалось ли открыть хотя бы один счётчик
+    bool IsAvailable() const;
+
+    bool IsOpened(Event event) const {
+        return fds_[event] >= 0;
+    }
+
+    // Обнуляет и запускает все открытые счётчики
+    void Start();
+
+    // Останавливает счётчики и возвращает их значения. Если ядро мультиплексировало счётчики,
+    // значения экстраполируются на всё время измерения. Для неоткрытых счётчиков возвращается 0.
+    Values Stop();
+
+protected:
+    std::array<int, EVENT_NUM> fds_;
+};
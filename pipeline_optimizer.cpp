@@ -0,0 +1,341 @@
+#include "pipeline_optimizer.h"
+#include "filter_pipeline_factory.h"
+
+#include <cmath>
+#include <map>
+#include <memory>
+#include <sstream>
+
+namespace {
+    std::string FormatDouble(double value) {
+        std::ostringstream stream;
+        stream << value;
+        return stream.str();
+    }
+
+    size_t GetArea(const std::pair<size_t, size_t>& size) {
+        return size.first * size.second;
+    }
+}
+
+PipelineOptimizer::FilterDescriptorVector PipelineOptimizer::Optimize(const FilterDescriptorVector& fdv,
+                                                                      size_t width, size_t height) {
+    static const std::vector<Rule> EXACT_RULES = {
+            &PipelineOptimizer::CancelNegatives,
+            &PipelineOptimizer::MergeGrayscales,
+            &PipelineOptimizer::MergeCrops,
+            &PipelineOptimizer::MovePointwiseAfterCrop,
+            &PipelineOptimizer::MovePointwiseAcrossScale,
+            &PipelineOptimizer::MoveCropBeforeNeighborhood,
+    };
+    static const std::vector<Rule> APPROXIMATE_RULES = {
+            &PipelineOptimizer::MergeScales,
+            &PipelineOptimizer::MoveBlurAfterDownscale,
+    };
+    std::vector<Rule> rules = EXACT_RULES;
+    if (approximate_) {
+        rules.insert(rules.end(), APPROXIMATE_RULES.begin(), APPROXIMATE_RULES.end());
+    }
+    rewrites_.clear();
+    original_plan_ = ToString(fdv);
+    FilterDescriptorVector result = fdv;
+    bool rewritten = true;
+    for (size_t rewrite = 0; rewrite < MAX_REWRITES && rewritten; ++rewrite) {
+        rewritten = false;
+        SizeVector sizes = ComputeSizes(result, width, height);
+        for (size_t pos = 0; pos < result.size() && !rewritten; ++pos) {
+            for (Rule rule : rules) {
+                if ((this->*rule)(result, pos, sizes)) {
+                    rewritten = true;
+                    break;
+                }
+            }
+        }
+    }
+    optimized_plan_ = ToString(result);
+    return result;
+}
+
+void PipelineOptimizer::Explain(std::ostream& stream) const {
+    stream << "original plan:" << original_plan_ << std::endl;
+    stream << "approximate rewrites: " << (approximate_ ? "on" : "off") << std::endl;
+    for (const std::string& i : rewrites_) {
+        stream << "rewrite: " << i << std::endl;
+    }
+    stream << "optimized plan:" << optimized_plan_ << std::endl;
+}
+
+PipelineOptimizer::SizeVector PipelineOptimizer::ComputeSizes(const FilterDescriptorVector& fdv,
+                                                              size_t width, size_t height) {
+    SizeVector sizes = {{width, height}};
+    for (const FilterDescriptor& i : fdv) {
+        if (auto crop_size = GetCropSize(i)) {
+            width = std::min(width, crop_size->first);
+            height = std::min(height, crop_size->second);
+        } else if (auto scale_size = GetScaleSize(i)) {
+            width = scale_size->first;
+            height = scale_size->second;
+        } else if (auto rotated_size = GetRotatedSize(i, width, height)) {
+            width = rotated_size->first;
+            height = rotated_size->second;
+        }
+        sizes.emplace_back(width, height);
+    }
+    return sizes;
+}
+
+std::string PipelineOptimizer::ToString(const FilterDescriptorVector& fdv) {
+    std::string result;
+    for (const FilterDescriptor& i : fdv) {
+        result += " -";
+        result += FilterPipelineFactory::DescribeFilter(i);
+    }
+    return result;
+}
+
+bool PipelineOptimizer::CancelNegatives(FilterDescriptorVector& fdv, size_t pos, const SizeVector&) {
+    if (pos + 1 >= fdv.size() || fdv[pos].filter_name != "neg" || fdv[pos + 1].filter_name != "neg") {
+        return false;
+    }
+    fdv.erase(fdv.begin() + static_cast<std::ptrdiff_t>(pos), fdv.begin() + static_cast<std::ptrdiff_t>(pos) + 2);
+    rewrites_.emplace_back("-neg -neg cancel each other");
+    return true;
+}
+
+bool PipelineOptimizer::MergeGrayscales(FilterDescriptorVector& fdv, size_t pos, const SizeVector&) {
+    if (pos + 1 >= fdv.size() || fdv[pos].filter_name != "gs" || fdv[pos + 1].filter_name != "gs") {
+        return false;
+    }
+    fdv.erase(fdv.begin() + static_cast<std::ptrdiff_t>(pos));
+    rewrites_.emplace_back("-gs -gs is the same as -gs");
+    return true;
+}
+
+bool PipelineOptimizer::MergeCrops(FilterDescriptorVector& fdv, size_t pos, const SizeVector&) {
+    if (pos + 1 >= fdv.size()) {
+        return false;
+    }
+    auto first = GetCropSize(fdv[pos]);
+    auto second = GetCropSize(fdv[pos + 1]);
+    if (!first || !second) {
+        return false;
+    }
+    std::string old_plan = ToString({fdv[pos], fdv[pos + 1]});
+    fdv[pos] = MakeDescriptor("crop", {std::to_string(std::min(first->first, second->first)),
+                                       std::to_string(std::min(first->second, second->second))});
+    fdv.erase(fdv.begin() + static_cast<std::ptrdiff_t>(pos) + 1);
+    rewrites_.push_back(old_plan + " merged into" + ToString({fdv[pos]}));
+    return true;
+}
+
+bool PipelineOptimizer::MergeScales(FilterDescriptorVector& fdv, size_t pos, const SizeVector&) {
+    if (pos + 1 >= fdv.size()) {
+        return false;
+    }
+    auto first = GetScaleSize(fdv[pos]);
+    auto second = GetScaleSize(fdv[pos + 1]);
+    // Если промежуточный размер меньше итогового, первое масштабирование теряет детали, и объединять нельзя
+    if (!first || !second || first->first < second->first || first->second < second->second) {
+        return false;
+    }
+    std::string old_plan = ToString({fdv[pos], fdv[pos + 1]});
+    fdv.erase(fdv.begin() + static_cast<std::ptrdiff_t>(pos));
+    rewrites_.push_back(old_plan + " merged into" + ToString({fdv[pos]}));
+    return true;
+}
+
+bool PipelineOptimizer::MovePointwiseAfterCrop(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes) {
+    if (pos + 1 >= fdv.size() || !IsPointwise(fdv[pos]) || !GetCropSize(fdv[pos + 1]) ||
+        GetArea(sizes[pos + 2]) >= GetArea(sizes[pos])) {
+        return false;
+    }
+    std::swap(fdv[pos], fdv[pos + 1]);
+    rewrites_.push_back("moved" + ToString({fdv[pos + 1]}) + " after" + ToString({fdv[pos]}));
+    return true;
+}
+
+bool PipelineOptimizer::MovePointwiseAcrossScale(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes) {
+    if (pos + 1 >= fdv.size()) {
+        return false;
+    }
+    // Поточечный фильтр лучше применять к меньшему из изображений до и после масштабирования
+    if (IsPointwise(fdv[pos]) && GetScaleSize(fdv[pos + 1]) && GetArea(sizes[pos + 2]) < GetArea(sizes[pos])) {
+        std::swap(fdv[pos], fdv[pos + 1]);
+        rewrites_.push_back("moved" + ToString({fdv[pos + 1]}) + " after downscaling" + ToString({fdv[pos]}));
+        return true;
+    }
+    if (GetScaleSize(fdv[pos]) && IsPointwise(fdv[pos + 1]) && GetArea(sizes[pos + 1]) > GetArea(sizes[pos])) {
+        std::swap(fdv[pos], fdv[pos + 1]);
+        rewrites_.push_back("moved" + ToString({fdv[pos]}) + " before upscaling" + ToString({fdv[pos + 1]}));
+        return true;
+    }
+    return false;
+}
+
+bool PipelineOptimizer::MoveCropBeforeNeighborhood(FilterDescriptorVector& fdv, size_t pos,
+                                                   const SizeVector& sizes) {
+    if (pos + 1 >= fdv.size()) {
+        return false;
+    }
+    auto halo = GetHalo(fdv[pos]);
+    auto crop_size = GetCropSize(fdv[pos + 1]);
+    if (!halo || !crop_size) {
+        return false;
+    }
+    // Обрезка оставляет левый верхний угол, поэтому запас нужен только справа и снизу
+    size_t width = std::min(sizes[pos].first, crop_size->first + *halo);
+    size_t height = std::min(sizes[pos].second, crop_size->second + *halo);
+    if (width == sizes[pos].first && height == sizes[pos].second) {
+        return false;
+    }
+    fdv.insert(fdv.begin() + static_cast<std::ptrdiff_t>(pos),
+               MakeDescriptor("crop", {std::to_string(width), std::to_string(height)}));
+    rewrites_.push_back("added" + ToString({fdv[pos]}) + " before" + ToString({fdv[pos + 1]}) + " to cover" +
+                        ToString({fdv[pos + 2]}) + " with a halo of " + std::to_string(*halo));
+    return true;
+}
+
+bool PipelineOptimizer::MoveBlurAfterDownscale(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes) {
+    if (pos + 1 >= fdv.size() || fdv[pos].filter_name != "blur" || fdv[pos].filter_params.size() != 1 ||
+        !GetScaleSize(fdv[pos + 1])) {
+        return false;
+    }
+    double factor_x = static_cast<double>(sizes[pos].first) / static_cast<double>(sizes[pos + 2].first);
+    double factor_y = static_cast<double>(sizes[pos].second) / static_cast<double>(sizes[pos + 2].second);
+    if (factor_x < 2 || factor_y < 2 || std::abs(factor_x - factor_y) > MAX_ANISOTROPY * std::max(factor_x, factor_y)) {
+        return false;
+    }
+    double sigma;
+    try {
+        sigma = std::stod(std::string(fdv[pos].filter_params[0]));
+    } catch (std::logic_error& e) {
+        return false;
+    }
+    // Размытие с sigma до уменьшения в factor раз равносильно размытию с sigma / factor после него
+    double new_sigma = sigma / std::sqrt(factor_x * factor_y);
+    std::string old_plan = ToString({fdv[pos], fdv[pos + 1]});
+    if (new_sigma < MIN_BLUR_SIGMA) {
+        fdv.erase(fdv.begin() + static_cast<std::ptrdiff_t>(pos));
+    } else {
+        fdv[pos] = MakeDescriptor("blur", {FormatDouble(new_sigma)});
+        std::swap(fdv[pos], fdv[pos + 1]);
+    }
+    rewrites_.push_back(old_plan + " rewritten as" + ToString({fdv[pos]}) +
+                        (new_sigma < MIN_BLUR_SIGMA ? "" : ToString({fdv[pos + 1]})));
+    return true;
+}
+
+FilterDescriptor PipelineOptimizer::MakeDescriptor(std::string_view name, const std::vector<std::string>& params) {
+    FilterDescriptor result;
+    storage_.emplace_back(name);
+    result.filter_name = storage_.back();
+    for (const std::string& i : params) {
+        storage_.push_back(i);
+        result.filter_params.push_back(storage_.back());
+    }
+    return result;
+}
+
+bool PipelineOptimizer::IsPointwise(const FilterDescriptor& fd) {
+    return (fd.filter_name == "neg" || fd.filter_name == "gs") && fd.filter_params.empty();
+}
+
+std::optional<size_t> PipelineOptimizer::GetHalo(const FilterDescriptor& fd) {
+    // При периодическом продолжении краевые пиксели зависят от противоположного края изображения
+    if (!fd.filter_params.empty() && fd.filter_params.back() == "wrap") {
+        return std::nullopt;
+    }
+    auto has_params = [&fd](size_t param_num, size_t param_num_with_border) {
+        return fd.filter_params.size() == param_num || fd.filter_params.size() == param_num_with_border;
+    };
+    if ((fd.filter_name == "sharp" && has_params(0, SharpeningFilter::PARAM_NUM_WITH_BORDER)) ||
+        (fd.filter_name == "edge" &&
+         has_params(EdgeDetectionFilter::PARAM_NUM, EdgeDetectionFilter::PARAM_NUM_WITH_BORDER))) {
+        return 1;
+    }
+    if ((fd.filter_name == "blur" &&
+         has_params(GaussianBlurFilter::PARAM_NUM, GaussianBlurFilter::PARAM_NUM_WITH_BORDER)) ||
+        (fd.filter_name == "unsharp" &&
+         has_params(UnsharpMaskFilter::PARAM_NUM, UnsharpMaskFilter::PARAM_NUM_WITH_BORDER))) {
+        try {
+            // Радиус ядра, как в GaussianBlurFilter::MakeKernel
+            return static_cast<size_t>(std::ceil(std::stod(std::string(fd.filter_params[0])) * 3));
+        } catch (std::logic_error& e) {
+            return std::nullopt;
+        }
+    }
+    if (fd.filter_name == "adaptive_threshold" && fd.filter_params.size() == AdaptiveThresholdFilter::PARAM_NUM) {
+        try {
+            return std::stoul(std::string(fd.filter_params[0])) / 2;
+        } catch (std::logic_error& e) {
+            return std::nullopt;
+        }
+    }
+    bool is_morphology = fd.filter_name == "erode" || fd.filter_name == "dilate" || fd.filter_name == "open" ||
+                         fd.filter_name == "close";
+    if (is_morphology && fd.filter_params.size() == MorphologyFilter::PARAM_NUM) {
+        try {
+            // Как в MorphologyFilter::GetInputRegion: открытие и закрытие -- два прохода
+            size_t steps = fd.filter_name == "open" || fd.filter_name == "close" ? 2 : 1;
+            return std::max(std::stoul(std::string(fd.filter_params[0])),
+                            std::stoul(std::string(fd.filter_params[1]))) / 2 * steps;
+        } catch (std::logic_error& e) {
+            return std::nullopt;
+        }
+    }
+    if (fd.filter_name == "median" && fd.filter_params.size() == MedianFilter::PARAM_NUM) {
+        try {
+            return static_cast<size_t>(std::stoul(std::string(fd.filter_params[0])));
+        } catch (std::logic_error& e) {
+            return std::nullopt;
+        }
+    }
+    return std::nullopt;
+}
+
+std::optional<std::pair<size_t, size_t>> PipelineOptimizer::GetCropSize(const FilterDescriptor& fd) {
+    if (fd.filter_name != "crop" || fd.filter_params.size() != CropFilter::PARAM_NUM) {
+        return std::nullopt;
+    }
+    try {
+        return std::make_pair(FilterFactories::SWtoSize(fd.filter_params[0]),
+                              FilterFactories::SWtoSize(fd.filter_params[1]));
+    } catch (std::logic_error& e) {
+        return std::nullopt;
+    }
+}
+
+std::optional<std::pair<size_t, size_t>> PipelineOptimizer::GetScaleSize(const FilterDescriptor& fd) {
+    if (fd.filter_name != "scale" || (fd.filter_params.size() != LanczosScaleFilter::PARAM_NUM_WO_ALPHA &&
+                                      fd.filter_params.size() != LanczosScaleFilter::PARAM_NUM_WITH_ALPHA)) {
+        return std::nullopt;
+    }
+    try {
+        auto result = std::make_pair(FilterFactories::SWtoSize(fd.filter_params[0]),
+                                     FilterFactories::SWtoSize(fd.filter_params[1]));
+        if (result.first == 0 || result.second == 0) {
+            return std::nullopt;
+        }
+        return result;
+    } catch (std::logic_error& e) {
+        return std::nullopt;
+    }
+}
+
+std::optional<std::pair<size_t, size_t>> PipelineOptimizer::GetRotatedSize(const FilterDescriptor& fd, size_t width,
+                                                                           size_t height) {
+    static const std::map<std::string_view, FilterPipelineFactory::FilterFactory> ROTATIONS = {
+        {"rotate", &FilterFactories::MakeRotateFilter},
+        {"rot90", &FilterFactories::MakeRot90Filter},
+        {"transpose", &FilterFactories::MakeTransposeFilter}};
+    auto rotation = ROTATIONS.find(fd.filter_name);
+    if (rotation == ROTATIONS.end()) {
+        return std::nullopt;
+    }
+    try {
+        std::unique_ptr<BaseFilter> filter(rotation->second(fd));
+        return filter->GetOutputSize(width, height);
+    } catch (std::invalid_argument& e) {
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,81 @@
+// Планировщик цепочки фильтров. До выполнения переписывает цепочку в более дешёвую, результат которой
+// совпадает с исходным или отличается в пределах погрешности округления: сокращает взаимоисключающие
+// фильтры, объединяет соседние обрезки, переносит поточечные фильтры туда, где пикселей меньше,
+// и переносит обрезку раньше фильтров, работающих с окрестностью пикселя (с запасом в радиус окрестности).
+// Приближённые переписывания -- объединение масштабирований и перенос размытия после уменьшения --
+// меняют пиксели сильнее округления и выполняются, только если их явно включить.
+
+#pragma once
+
+#include <deque>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+#include "cmd_arg_parser.h"
+
+class PipelineOptimizer {
+public:
+    using FilterDescriptorVector = CmdLineParser::FilterDescriptorVector;
+    // Размеры изображения перед каждым фильтром цепочки (и после последнего)
+    using SizeVector = std::vector<std::pair<size_t, size_t>>;
+    using Rule = bool (PipelineOptimizer::*)(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+
+    // Ограничение на число переписываний цепочки
+    static const size_t MAX_REWRITES = 64;
+    // Размытие после уменьшения меньше этого sigma почти не отличается от тождественного
+    static constexpr double MIN_BLUR_SIGMA = 0.2;
+    // Допустимое различие коэффициентов уменьшения по осям, при котором размытие можно перенести
+    static constexpr double MAX_ANISOTROPY = 0.1;
+
+public:
+    // Возвращает оптимизированную цепочку для изображения размером width x height.
+    // Параметры новых фильтров хранятся в самом планировщике, поэтому он должен жить,
+    // пока используется результат.
+    FilterDescriptorVector Optimize(const FilterDescriptorVector& fdv, size_t width, size_t height);
+
+    // Печатает исходную цепочку, включены ли приближённые переписывания, применённые переписывания
+    // и итоговую цепочку
+    void Explain(std::ostream& stream) const;
+
+    // Разрешает переписывания, результат которых отличается от исходного больше, чем на округление
+    void EnableApproximate(bool enable) { approximate_ = enable; }
+
+    static SizeVector ComputeSizes(const FilterDescriptorVector& fdv, size_t width, size_t height);
+
+    static std::string ToString(const FilterDescriptorVector& fdv);
+
+protected:
+    // Правила смотрят на фильтр с номером pos и следующий за ним; если правило применимо,
+    // оно переписывает цепочку и возвращает true
+    bool CancelNegatives(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MergeGrayscales(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MergeCrops(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MovePointwiseAfterCrop(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MovePointwiseAcrossScale(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MoveCropBeforeNeighborhood(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+
+    // Приближённые правила: одно масштабирование вместо двух и размытие после уменьшения вместо размытия
+    // до него дают другие пиксели, поэтому применяются только после EnableApproximate(true)
+    bool MergeScales(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+    bool MoveBlurAfterDownscale(FilterDescriptorVector& fdv, size_t pos, const SizeVector& sizes);
+
+    // Создаёт описание фильтра, параметры которого хранятся в storage_
+    FilterDescriptor MakeDescriptor(std::string_view name, const std::vector<std::string>& params);
+
+    static bool IsPointwise(const FilterDescriptor& fd);
+    // Радиус окрестности, от которой зависит выходной пиксель
+    static std::optional<size_t> GetHalo(const FilterDescriptor& fd);
+    static std::optional<std::pair<size_t, size_t>> GetCropSize(const FilterDescriptor& fd);
+    static std::optional<std::pair<size_t, size_t>> GetScaleSize(const FilterDescriptor& fd);
+    // Размеры результата поворота или транспонирования изображения width x height
+    static std::optional<std::pair<size_t, size_t>> GetRotatedSize(const FilterDescriptor& fd, size_t width,
+                                                                   size_t height);
+
+protected:
+    std::deque<std::string> storage_;
+    std::string original_plan_;
+    std::string optimized_plan_;
+    std::vector<std::string> rewrites_;
+    bool approximate_ = false;
+};
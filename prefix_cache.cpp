@@ -0,0 +1,47 @@
+#include "prefix_cache.h"
+
+std::string PrefixCache::MakeKey(uint64_t input_id, std::string_view prefix) {
+    std::string key = std::to_string(input_id);
+    key += ':';
+    key += prefix;
+    return key;
+}
+
+const PixelArray* PrefixCache::Find(const std::string& key) {
+    auto found = index_.find(key);
+    if (found == index_.end()) {
+        ++stats_.misses;
+        return nullptr;
+    }
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    return &found->second->pixels;
+}
+
+void PrefixCache::Insert(const std::string& key, const PixelArray& pixels) {
+    size_t byte_size = GetByteSize(pixels);
+    if (byte_size > max_bytes_) {
+        return;
+    }
+    auto found = index_.find(key);
+    if (found != index_.end()) {
+        size_ -= GetByteSize(found->second->pixels);
+        entries_.erase(found->second);
+        index_.erase(found);
+    }
+    while (size_ + byte_size > max_bytes_) {
+        size_ -= GetByteSize(entries_.back().pixels);
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+        ++stats_.evictions;
+    }
+    entries_.push_front(Entry{key, pixels});
+    index_.emplace(key, entries_.begin());
+    size_ += byte_size;
+}
+
+void PrefixCache::Clear() {
+    entries_.clear();
+    index_.clear();
+    size_ = 0;
+}
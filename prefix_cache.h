@@ -0,0 +1,64 @@
+// Кэш промежуточных результатов конвейера фильтров в памяти. Если несколько конвейеров
+// применяются к одному изображению и начинаются с одинаковых фильтров (например, "-crop 1000 1000 -blur 3"
+// и разные окончания), общее начало считается один раз, а остальные конвейеры берут его результат отсюда.
+// Ключ -- идентификатор входного изображения и описание начала цепочки. Суммарный размер хранимых
+// изображений ограничен; при превышении удаляются давно не использованные (LRU).
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "bitmap.h"
+
+class PrefixCache {
+public:
+    // Попадания и промахи считаются по вызовам Find
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+
+public:
+    explicit PrefixCache(size_t max_bytes) : max_bytes_(max_bytes) {}
+
+    // Ключ для результата первых фильтров цепочки, prefix -- их описание
+    static std::string MakeKey(uint64_t input_id, std::string_view prefix);
+
+    // Возвращает результат или nullptr; найденная запись становится самой свежей.
+    // Указатель действителен до следующего вызова Insert.
+    const PixelArray* Find(const std::string& key);
+
+    // Сохраняет копию pixels. Изображение больше всего бюджета не сохраняется.
+    void Insert(const std::string& key, const PixelArray& pixels);
+
+    void Clear();
+
+    size_t GetSize() const { return size_; }
+
+    size_t GetMaxSize() const { return max_bytes_; }
+
+    const Stats& GetStats() const { return stats_; }
+
+    static size_t GetByteSize(const PixelArray& pixels) {
+        return pixels.GetWidth() * pixels.GetHeight() * sizeof(PixelArray::Pixel);
+    }
+
+protected:
+    struct Entry {
+        std::string key;
+        PixelArray pixels;
+    };
+    using EntryList = std::list<Entry>;
+
+protected:
+    size_t max_bytes_;
+    size_t size_ = 0;
+    // В начале списка -- недавно использованные записи
+    EntryList entries_;
+    std::unordered_map<std::string, EntryList::iterator> index_;
+    Stats stats_;
+};
@@ -0,0 +1,201 @@
+#include "result_cache.h"
+#include "xxhash64.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+    const char* STATS_FILE_NAME = "stats";
+    const char* ENTRY_EXTENSION = ".bmp";
+
+    void AppendString(std::string& out, std::string_view str) {
+        out += std::to_string(str.size());
+        out += ':';
+        out += str;
+    }
+
+    // Число в кратчайшей записи, которая читается обратно в то же значение; остальное без изменений
+    std::string CanonicalParam(std::string_view param) {
+        double value = 0;
+        auto [end, error] = std::from_chars(param.data(), param.data() + param.size(), value);
+        if (error != std::errc() || end != param.data() + param.size()) {
+            return std::string(param);
+        }
+        char buffer[32];
+        auto [canonical_end, canonical_error] = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        return std::string(buffer, canonical_end);
+    }
+
+    // Сохранённые счётчики попаданий, промахов и вытеснений
+    ResultCache::Stats ReadCounters(const std::filesystem::path& directory) {
+        ResultCache::Stats stats;
+        std::ifstream stats_file(directory / STATS_FILE_NAME);
+        if (!(stats_file >> stats.hits >> stats.misses >> stats.evictions)) {
+            stats = ResultCache::Stats();
+        }
+        return stats;
+    }
+}
+
+ResultCache::ResultCache(std::filesystem::path directory, uint64_t max_bytes)
+: directory_(std::move(directory)), max_bytes_(max_bytes) {}
+
+bool ResultCache::Open() {
+    std::error_code error;
+    std::filesystem::create_directories(directory_, error);
+    return std::filesystem::is_directory(directory_, error);
+}
+
+bool ResultCache::ComputeKey(std::istream& input, const CmdLineParser::FilterDescriptorVector& fdv,
+                             std::string_view settings, uint64_t& key) {
+    XXHash64 hash(FORMAT_VERSION);
+    if (!hash.Update(input)) {
+        return false;
+    }
+    // Длина входного файла уже учтена в хеше, поэтому описание цепочки не может совпасть с его хвостом
+    std::string description = Serialize(fdv);
+    AppendString(description, settings);
+    hash.Update(description);
+    key = hash.Digest();
+    return true;
+}
+
+std::string ResultCache::Serialize(const CmdLineParser::FilterDescriptorVector& fdv) {
+    std::string result;
+    result += std::to_string(fdv.size());
+    result += ';';
+    for (const FilterDescriptor& fd : fdv) {
+        AppendString(result, fd.filter_name);
+        result += std::to_string(fd.filter_params.size());
+        result += ';';
+        for (std::string_view param : fd.filter_params) {
+            AppendString(result, CanonicalParam(param));
+        }
+    }
+    return result;
+}
+
+std::filesystem::path ResultCache::GetEntryPath(uint64_t key) const {
+    std::stringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << key << ENTRY_EXTENSION;
+    return directory_ / name.str();
+}
+
+bool ResultCache::Lookup(uint64_t key, const std::filesystem::path& output) {
+    std::filesystem::path entry = GetEntryPath(key);
+    std::error_code error;
+    bool hit = std::filesystem::is_regular_file(entry, error) &&
+               std::filesystem::copy_file(entry, output, std::filesystem::copy_options::overwrite_existing, error);
+    if (hit) {
+        // Отмечаем запись как недавно использованную
+        std::filesystem::last_write_time(entry, std::filesystem::file_time_type::clock::now(), error);
+    }
+    UpdateStats(hit ? 1 : 0, hit ? 0 : 1, 0);
+    return hit;
+}
+
+bool ResultCache::Store(uint64_t key, const std::filesystem::path& result) {
+    std::error_code error;
+    uint64_t size = std::filesystem::file_size(result, error);
+    if (error || size > max_bytes_) {
+        return false;
+    }
+    std::filesystem::path temporary = MakeTemporaryPath();
+    if (!std::filesystem::copy_file(result, temporary, error)) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    std::filesystem::rename(temporary, GetEntryPath(key), error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    Evict();
+    return true;
+}
+
+void ResultCache::Evict() {
+    struct Entry {
+        std::filesystem::path path;
+        std::filesystem::file_time_type last_use;
+        uint64_t size;
+    };
+    std::vector<Entry> entries;
+    uint64_t total_size = 0;
+    std::error_code error;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        if (!item.is_regular_file(error) || item.path().extension() != ENTRY_EXTENSION) {
+            continue;
+        }
+        Entry entry{item.path(), item.last_write_time(error), item.file_size(error)};
+        if (!error) {
+            total_size += entry.size;
+            entries.push_back(std::move(entry));
+        }
+    }
+    if (total_size <= max_bytes_) {
+        return;
+    }
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhv, const Entry& rhv) {
+        return lhv.last_use < rhv.last_use;
+    });
+    uint64_t evictions = 0;
+    for (const Entry& entry : entries) {
+        if (total_size <= max_bytes_) {
+            break;
+        }
+        // Запись мог уже удалить другой процесс
+        if (std::filesystem::remove(entry.path, error)) {
+            ++evictions;
+        }
+        total_size -= entry.size;
+    }
+    UpdateStats(0, 0, evictions);
+}
+
+ResultCache::Stats ResultCache::GetStats() const {
+    Stats stats = ReadCounters(directory_);
+    std::error_code error;
+    for (const auto& item : std::filesystem::directory_iterator(directory_, error)) {
+        if (item.is_regular_file(error) && item.path().extension() == ENTRY_EXTENSION) {
+            ++stats.entries;
+            stats.bytes += item.file_size(error);
+        }
+    }
+    return stats;
+}
+
+void ResultCache::PrintStats(std::ostream& stream) const {
+    Stats stats = GetStats();
+    stream << "cache: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.evictions
+           << " evictions, " << stats.entries << " entries, " << stats.bytes << " bytes of " << max_bytes_
+           << std::endl;
+}
+
+void ResultCache::UpdateStats(uint64_t hits, uint64_t misses, uint64_t evictions) {
+    Stats stats = ReadCounters(directory_);
+    std::filesystem::path temporary = MakeTemporaryPath();
+    {
+        std::ofstream stats_file(temporary);
+        stats_file << stats.hits + hits << ' ' << stats.misses + misses << ' ' << stats.evictions + evictions
+                   << std::endl;
+    }
+    // При одновременных запусках одно из обновлений может потеряться, но файл всегда останется целым
+    std::error_code error;
+    std::filesystem::rename(temporary, directory_ / STATS_FILE_NAME, error);
+    if (error) {
+        std::filesystem::remove(temporary, error);
+    }
+}
+
+std::filesystem::path ResultCache::MakeTemporaryPath() const {
+    static std::mt19937_64 generator(std::random_device{}());
+    std::stringstream name;
+    name << ".tmp-" << std::hex << generator();
+    return directory_ / name.str();
+}
@@ -0,0 +1,72 @@
+// Кэш результатов на диске. Ключ -- хеш XXH64 содержимого входного файла и канонической записи
+// цепочки фильтров, поэтому повторный запуск на тех же данных просто копирует готовый файл,
+// не декодируя изображение и не применяя фильтры.
+// Каждая запись -- отдельный файл <ключ>.bmp в каталоге кэша. Записи добавляются атомарно
+// (запись во временный файл и переименование), так что другой процесс никогда не увидит
+// недописанный файл. Время изменения файла служит временем последнего использования: при превышении
+// лимита размера удаляются давно не использованные записи (LRU).
+// Счётчики попаданий и промахов хранятся в файле stats в том же каталоге.
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include "cmd_arg_parser.h"
+
+class ResultCache {
+public:
+    // Меняется при изменении формата ключа или результатов фильтров, чтобы не выдавать старые записи
+    static const uint32_t FORMAT_VERSION = 1;
+    static const uint64_t DEFAULT_MAX_BYTES = 1ULL << 30;
+
+    struct Stats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+        uint64_t entries = 0;
+        uint64_t bytes = 0;
+    };
+
+public:
+    ResultCache(std::filesystem::path directory, uint64_t max_bytes = DEFAULT_MAX_BYTES);
+
+    // Создаёт каталог кэша, если его нет
+    bool Open();
+
+    // Ключ по содержимому входного файла, цепочке фильтров и прочим настройкам, влияющим на результат
+    // (settings). Возвращает false, если файл не удалось прочитать.
+    static bool ComputeKey(std::istream& input, const CmdLineParser::FilterDescriptorVector& fdv,
+                           std::string_view settings, uint64_t& key);
+
+    // Каноническая запись цепочки: числовые параметры приводятся к кратчайшему виду ("5.0" -> "5"),
+    // длины всех строк записываются явно, поэтому разные цепочки не склеиваются в одинаковые строки
+    static std::string Serialize(const CmdLineParser::FilterDescriptorVector& fdv);
+
+    // При попадании копирует результат в output и возвращает true. Обновляет счётчики.
+    bool Lookup(uint64_t key, const std::filesystem::path& output);
+
+    // Добавляет файл result в кэш под ключом key и удаляет старые записи сверх лимита
+    bool Store(uint64_t key, const std::filesystem::path& result);
+
+    // Счётчики и текущий размер кэша
+    Stats GetStats() const;
+
+    void PrintStats(std::ostream& stream) const;
+
+    std::filesystem::path GetEntryPath(uint64_t key) const;
+
+protected:
+    void Evict();
+
+    // Прибавляет к сохранённым счётчикам и атомарно перезаписывает файл stats
+    void UpdateStats(uint64_t hits, uint64_t misses, uint64_t evictions);
+
+    // Временный файл в каталоге кэша с уникальным именем
+    std::filesystem::path MakeTemporaryPath() const;
+
+protected:
+    std::filesystem::path directory_;
+    uint64_t max_bytes_;
+};
@@ -0,0 +1,152 @@
+#include "stream_pipeline.h"
+
+#include <algorithm>
+
+void StreamStage::Configure(size_t width, size_t height) {
+    width_ = width;
+    height_ = height;
+    out_width_ = width;
+    out_height_ = height;
+}
+
+void RowStreamStage::Configure(size_t width, size_t height) {
+    StreamStage::Configure(width, height);
+    if (fixed_out_width_) {
+        out_width_ = fixed_out_width_;
+    }
+    out_.resize(out_width_);
+}
+
+void RowStreamStage::PushRow(const PixelArray::Pixel* row) {
+    function_(row, width_, out_.data());
+    Emit(out_.data());
+}
+
+WindowStreamStage* WindowStreamStage::MakeNeighborhood(size_t radius, WindowFunction function) {
+    FirstRowFunction first_row = [radius](size_t out_row) {
+        return static_cast<int64_t>(out_row) - static_cast<int64_t>(radius);
+    };
+    return new WindowStreamStage(radius * 2 + 1, first_row, std::move(function));
+}
+
+void WindowStreamStage::Configure(size_t width, size_t height) {
+    StreamStage::Configure(width, height);
+    if (fixed_out_height_) {
+        out_height_ = fixed_out_height_;
+    }
+    if (fixed_out_width_) {
+        out_width_ = fixed_out_width_;
+    }
+    window_.Resize(window_size_, width);
+    out_.resize(out_width_);
+}
+
+void WindowStreamStage::PushRow(const PixelArray::Pixel* row) {
+    history_.emplace_back(row, row + width_);
+    ++received_;
+    EmitReadyRows();
+}
+
+void WindowStreamStage::Finish() {
+    EmitReadyRows();
+    StreamStage::Finish();
+}
+
+size_t WindowStreamStage::ClampRow(int64_t row) const {
+    return std::clamp<int64_t>(row, 0, static_cast<int64_t>(height_) - 1);
+}
+
+void WindowStreamStage::EmitReadyRows() {
+    while (emitted_ < out_height_) {
+        int64_t first = first_row_(emitted_);
+        size_t last = ClampRow(first + static_cast<int64_t>(window_size_) - 1);
+        if (last >= received_) {
+            // Ждём следующих строк. Если их уже не будет, входное изображение оказалось короче заявленного
+            return;
+        }
+        for (size_t i = 0; i < window_size_; ++i) {
+            const Row& source = history_[ClampRow(first + static_cast<int64_t>(i)) - history_begin_];
+            std::copy(source.begin(), source.end(), &window_(i, 0));
+        }
+        function_(window_, emitted_, out_.data());
+        ++emitted_;
+        Emit(out_.data());
+        // Выбрасываем строки, которые больше никому не понадобятся
+        size_t needed_begin = emitted_ < out_height_ ? ClampRow(first_row_(emitted_)) : received_;
+        while (history_begin_ < needed_begin && !history_.empty()) {
+            history_.pop_front();
+            ++history_begin_;
+        }
+    }
+}
+
+void CropStreamStage::Configure(size_t width, size_t height) {
+    StreamStage::Configure(width, height);
+    out_width_ = std::min(crop_width_, width);
+    out_height_ = std::min(crop_height_, height);
+}
+
+void CropStreamStage::PushRow(const PixelArray::Pixel* row) {
+    // Строки идут снизу вверх, а оставить нужно верхние
+    if (received_ >= height_ - out_height_) {
+        Emit(row);
+    }
+    ++received_;
+}
+
+// -------------------------------------------------------------------------------------------------------------
+
+namespace {
+    class WriterSink : public RowSink {
+    public:
+        explicit WriterSink(BitmapRowWriter& writer) : writer_(writer) {}
+
+        void PushRow(const PixelArray::Pixel* row) override {
+            succeeded_ = writer_.WriteRow(row) && succeeded_;
+            ++written_;
+        }
+
+        bool Succeeded() const { return succeeded_; }
+
+        size_t GetWrittenRows() const { return written_; }
+
+    protected:
+        BitmapRowWriter& writer_;
+        bool succeeded_ = true;
+        size_t written_ = 0;
+    };
+}
+
+StreamPipeline::~StreamPipeline() {
+    for (StreamStage* i : stages_) {
+        delete i;
+    }
+}
+
+void StreamPipeline::AddStage(StreamStage* stage) {
+    stage->Configure(width_, height_);
+    width_ = stage->GetOutputWidth();
+    height_ = stage->GetOutputHeight();
+    stages_.push_back(stage);
+}
+
+bool StreamPipeline::Run(BitmapRowReader& reader, std::ostream& stream, BitmapRowWriter::Format format) {
+    BitmapRowWriter writer;
+    if (!writer.Open(stream, reader.GetBMPHeader(), reader.GetDIBHeader(), width_, height_, format)) {
+        return false;
+    }
+    WriterSink sink(writer);
+    for (size_t i = 0; i < stages_.size(); ++i) {
+        stages_[i]->SetNext(i + 1 < stages_.size() ? static_cast<RowSink*>(stages_[i + 1]) : &sink);
+    }
+    RowSink* first = stages_.empty() ? static_cast<RowSink*>(&sink) : stages_.front();
+    RowSink::Row row(reader.GetWidth());
+    for (size_t i = 0; i < reader.GetHeight(); ++i) {
+        if (!reader.ReadRow(row.data())) {
+            return false;
+        }
+        first->PushRow(row.data());
+    }
+    first->Finish();
+    return sink.Succeeded() && sink.GetWrittenRows() == height_;
+}
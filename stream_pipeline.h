@@ -0,0 +1,163 @@
+// Потоковая (построчная) обработка изображений, которые не помещаются в память.
+// Строки читаются из файла по одной и проходят через цепочку стадий. Каждая стадия держит
+// только те строки, которые нужны ей для подсчёта очередной выходной строки (например,
+// 2 * radius + 1 строк для размытия), и сразу передаёт готовые строки дальше, вплоть до записи в файл.
+// Поэтому расход памяти не зависит от высоты изображения.
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <vector>
+#include "bitmap.h"
+
+class RowSink {
+public:
+    using Row = std::vector<PixelArray::Pixel>;
+
+public:
+    virtual ~RowSink() = default;
+
+    // Принимает очередную строку (строки идут в порядке хранения в bmp, снизу вверх)
+    virtual void PushRow(const PixelArray::Pixel* row) = 0;
+
+    // Сообщает, что строк больше не будет
+    virtual void Finish() {}
+};
+
+class StreamStage : public RowSink {
+public:
+    // Запоминает размеры входного изображения и вычисляет размеры выходного.
+    // Вызывается при добавлении стадии в StreamPipeline.
+    virtual void Configure(size_t width, size_t height);
+
+    size_t GetOutputWidth() const { return out_width_; }
+
+    size_t GetOutputHeight() const { return out_height_; }
+
+    void SetNext(RowSink* next) { next_ = next; }
+
+    void Finish() override { next_->Finish(); }
+
+protected:
+    void Emit(const PixelArray::Pixel* row) { next_->PushRow(row); }
+
+protected:
+    size_t width_ = 0;
+    size_t height_ = 0;
+    size_t out_width_ = 0;
+    size_t out_height_ = 0;
+    RowSink* next_ = nullptr;
+};
+
+// Построчное преобразование: каждая выходная строка зависит только от одной входной
+class RowStreamStage : public StreamStage {
+public:
+    using RowFunction = std::function<void(const PixelArray::Pixel* in, size_t in_width, PixelArray::Pixel* out)>;
+
+public:
+    // out_width == 0 означает, что ширина строки не меняется
+    explicit RowStreamStage(RowFunction function, size_t out_width = 0)
+    : function_(std::move(function)), fixed_out_width_(out_width) {}
+
+    void Configure(size_t width, size_t height) override;
+
+    void PushRow(const PixelArray::Pixel* row) override;
+
+protected:
+    RowFunction function_;
+    size_t fixed_out_width_;
+    Row out_;
+};
+
+// Стадия, которой для подсчёта выходной строки out_row нужно окно из window_size входных строк,
+// начиная с first_row(out_row). first_row не должна убывать. Строки за краем изображения
+// заменяются крайними, так же как при std::clamp в PixelMath::ApplyMatrix.
+class WindowStreamStage : public StreamStage {
+public:
+    using FirstRowFunction = std::function<int64_t(size_t out_row)>;
+    using WindowFunction = std::function<void(const PixelArray& window, size_t out_row, PixelArray::Pixel* out)>;
+
+public:
+    // out_height == 0 (out_width == 0) означает, что высота (ширина) изображения не меняется
+    WindowStreamStage(size_t window_size, FirstRowFunction first_row, WindowFunction function,
+                      size_t out_height = 0, size_t out_width = 0)
+    : window_size_(window_size), first_row_(std::move(first_row)), function_(std::move(function)),
+      fixed_out_height_(out_height), fixed_out_width_(out_width) {}
+
+    // Окно из 2 * radius + 1 строк, центр которого -- выходная строка
+    static WindowStreamStage* MakeNeighborhood(size_t radius, WindowFunction function);
+
+    void Configure(size_t width, size_t height) override;
+
+    void PushRow(const PixelArray::Pixel* row) override;
+
+    void Finish() override;
+
+protected:
+    // Считает все выходные строки, для которых уже есть входные строки
+    void EmitReadyRows();
+
+    size_t ClampRow(int64_t row) const;
+
+protected:
+    size_t window_size_;
+    FirstRowFunction first_row_;
+    WindowFunction function_;
+    size_t fixed_out_height_;
+    size_t fixed_out_width_;
+    std::deque<Row> history_;
+    size_t history_begin_ = 0; // номер входной строки, лежащей в history_.front()
+    size_t received_ = 0;
+    size_t emitted_ = 0;
+    PixelArray window_;
+    Row out_;
+};
+
+// Обрезка: оставляет левый верхний угол изображения
+class CropStreamStage : public StreamStage {
+public:
+    CropStreamStage(size_t width, size_t height) : crop_width_(width), crop_height_(height) {}
+
+    void Configure(size_t width, size_t height) override;
+
+    void PushRow(const PixelArray::Pixel* row) override;
+
+protected:
+    size_t crop_width_;
+    size_t crop_height_;
+    size_t received_ = 0;
+};
+
+class StreamPipeline {
+public:
+    using StageVector = std::vector<StreamStage*>;
+
+public:
+    // width и height -- размеры входного изображения
+    StreamPipeline(size_t width, size_t height) : width_(width), height_(height) {}
+
+    StreamPipeline(const StreamPipeline&) = delete;
+
+    StreamPipeline& operator=(const StreamPipeline&) = delete;
+
+    ~StreamPipeline();
+
+    // Добавляет стадию в конец конвейера, сообщая ей текущие размеры изображения
+    void AddStage(StreamStage* stage);
+
+    // Размеры изображения на выходе последней добавленной стадии
+    size_t GetWidth() const { return width_; }
+
+    size_t GetHeight() const { return height_; }
+
+    // Читает изображение из reader, прогоняет через все стадии и пишет результат в stream в формате format
+    bool Run(BitmapRowReader& reader, std::ostream& stream,
+             BitmapRowWriter::Format format = BitmapRowWriter::Format::BGR24);
+
+protected:
+    StageVector stages_;
+    size_t width_;
+    size_t height_;
+};
@@ -1,9 +1,28 @@
 #include <catch.hpp>
+#include "app.h"
 #include "cmd_arg_parser.h"
 #include "filter_pipeline_factory.h"
 #include "filter_pipeline.h"
 #include "filters.h"
+#include "float_image.h"
+#include "fixed_kernel.h"
 #include "bitmap.h"
+#include "bitmap_probe.h"
+#include "border.h"
+#include "thumbnailer.h"
+#include "image_pyramid.h"
+#include "integral_image.h"
+#include "parallel.h"
+#include "pipeline_optimizer.h"
+#include "prefix_cache.h"
+#include "result_cache.h"
+#include "xxhash64.h"
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sstream>
 #include <stdexcept>
 
 TEST_CASE("TestCmdLineParser") {
@@ -73,19 +92,22 @@ TEST_CASE("TestFilterFactories") {
 
     FilterDescriptor sharp_wrong_name{"not_sharp", {}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeSharpeningFilter(sharp_wrong_name), "wrong sharpening filter descriptor");
-    FilterDescriptor sharp_wrong_size{"sharp", {"123"}};
+    FilterDescriptor sharp_wrong_size{"sharp", {"123", "456"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeSharpeningFilter(sharp_wrong_size), "wrong sharpening filter params size");
+    FilterDescriptor sharp_wrong_border{"sharp", {"123"}};
+    REQUIRE_THROWS_WITH(FilterFactories::MakeSharpeningFilter(sharp_wrong_border),
+                        "border must be clamp, reflect, wrap or constant");
 
     FilterDescriptor edge_wrong_name{"not_edge", {"0.1"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeEdgeDetectionFilter(edge_wrong_name), "wrong edge detection filter descriptor");
-    FilterDescriptor edge_wrong_size{"edge", {"0.1", "0.2"}};
+    FilterDescriptor edge_wrong_size{"edge", {"0.1", "reflect", "0.2"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeEdgeDetectionFilter(edge_wrong_size), "wrong edge detection filter params size");
     FilterDescriptor edge_wrong_params{"edge", {"abc"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeEdgeDetectionFilter(edge_wrong_params), "wrong edge detection filter param type");
 
     FilterDescriptor blur_wrong_name{"not_blur", {"3"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeGaussianBlurFilter(blur_wrong_name), "wrong blur filter descriptor");
-    FilterDescriptor blur_wrong_size{"blur", {"3", "123"}};
+    FilterDescriptor blur_wrong_size{"blur", {"3", "wrap", "123"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeGaussianBlurFilter(blur_wrong_size), "wrong blur filter params size");
     FilterDescriptor blur_wrong_params{"blur", {"abc"}};
     REQUIRE_THROWS_WITH(FilterFactories::MakeGaussianBlurFilter(blur_wrong_params), "wrong blur filter param type");
@@ -142,4 +164,2085 @@ TEST_CASE("TestFilters") {
     REQUIRE_NOTHROW(LanczosScaleFilter(2001, 2002, 3).Apply(bmp_file));
     REQUIRE(bmp_file.GetPixels().GetWidth() == 2001);
     REQUIRE(bmp_file.GetPixels().GetHeight() == 2002);
-}
\ No newline at end of file
+}
+
+TEST_CASE("TestCmdLineOptions") {
+    CmdLineParser cmd;
+    char exe_path[9] = "exe_path";
+    char file_input[10] = "input.bmp";
+    char file_output[11] = "output.bmp";
+    char profile[10] = "--profile";
+    char filter_name[5] = "-neg";
+    char option_with_value[12] = "--cache=dir";
+    char* argv[6] = {exe_path, profile, file_input, file_output, filter_name, option_with_value};
+    REQUIRE(CmdLineParser::parse_result::PARSED == cmd.Parse(6, argv));
+    REQUIRE(cmd.GetInputFileName() == "input.bmp");
+    REQUIRE(cmd.GetOutputFileName() == "output.bmp");
+    REQUIRE(cmd.GetData().size() == 1);
+    REQUIRE(cmd.HasOption("profile"));
+    REQUIRE(cmd.GetOption("cache") == "dir");
+    REQUIRE_FALSE(cmd.HasOption("explain"));
+
+    char empty_option[3] = "--";
+    char* argv_empty_option[4] = {exe_path, file_input, file_output, empty_option};
+    REQUIRE(CmdLineParser::parse_result::FAILED == cmd.Parse(4, argv_empty_option));
+
+    // Отрицательные числа -- параметры фильтров
+    char rotate[8] = "-rotate";
+    char negative_angle[4] = "-30";
+    char negative_fraction[4] = "-.5";
+    char* argv_negative[7] = {exe_path, file_input, file_output, rotate, negative_angle, filter_name,
+                              negative_fraction};
+    REQUIRE(CmdLineParser::parse_result::PARSED == cmd.Parse(7, argv_negative));
+    REQUIRE(cmd.GetData().size() == 2);
+    REQUIRE(cmd.GetData()[0].filter_params == std::vector<std::string_view>{"-30"});
+    REQUIRE(cmd.GetData()[1].filter_params == std::vector<std::string_view>{"-.5"});
+    char* argv_number_first[5] = {exe_path, file_input, file_output, negative_angle, rotate};
+    REQUIRE(CmdLineParser::parse_result::FAILED == cmd.Parse(5, argv_number_first));
+}
+
+TEST_CASE("TestAppGrayOutput") {
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    auto run = [&directory](const std::string& name, std::vector<std::string> options) {
+        std::filesystem::path output = directory / ("image_processor_app_" + name + ".bmp");
+        std::vector<std::string> args = {"exe_path", "../examples/town.bmp", output.string(), "-neg", "-crop", "120",
+                                         "90", "--gray-output"};
+        args.insert(args.end(), options.begin(), options.end());
+        std::vector<char*> argv;
+        for (std::string& arg : args) {
+            argv.push_back(arg.data());
+        }
+        App app;
+        app.Setup();
+        app.Run(static_cast<int>(argv.size()), argv.data());
+        std::ifstream file(output, std::ios_base::in | std::ios_base::binary);
+        std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        std::filesystem::remove(output);
+        return data;
+    };
+    // Оптимизированная цепочка тоже переводит изображение в оттенки серого перед записью 8-битного файла
+    std::string expected = run("no_optimize", {"--no-optimize"});
+    REQUIRE_FALSE(expected.empty());
+    REQUIRE(run("optimized", {}) == expected);
+    REQUIRE(run("stream", {"--stream"}) == expected);
+}
+
+TEST_CASE("TestFilterPipelineProfiling") {
+    Bitmap bmp;
+    bmp.GetPixels().Resize(16, 16, PixelArray::Pixel{10, 20, 30});
+    FilterPipeline fp;
+    fp.AddFilter(new NegativeFilter, "neg");
+    fp.AddFilter(new GaussianBlurFilter(1), "blur 1");
+    fp.EnableProfiling(true);
+    fp.Apply(bmp);
+    REQUIRE(fp.GetStats().size() == 2);
+    REQUIRE(fp.GetStats()[0].name == "neg");
+    REQUIRE(fp.GetStats()[1].name == "blur 1");
+    REQUIRE(bmp.GetPixels()(0, 0) == PixelArray::Pixel{245, 235, 225});
+}
+
+TEST_CASE("TestStreamingMatchesInMemory") {
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    FilterPipeline fp;
+    fp.AddFilter(new GaussianBlurFilter(1.5), "blur 1.5");
+    fp.AddFilter(new NegativeFilter, "neg");
+    fp.AddFilter(new FlipFilter(true), "flip h");
+    fp.AddFilter(new SharpeningFilter, "sharp");
+    fp.AddFilter(new CropFilter(200, 150), "crop 200 150");
+    fp.AddFilter(new EdgeDetectionFilter(0.1), "edge 0.1");
+    fp.AddFilter(new LanczosScaleFilter(97, 131), "scale 97 131");
+    fp.Apply(expected);
+
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    PixelArray& expected_pixels = expected.GetPixels();
+    PixelArray& streamed_pixels = streamed.GetPixels();
+    REQUIRE(streamed_pixels.GetHeight() == 131);
+    REQUIRE(streamed_pixels.GetWidth() == 97);
+    for (size_t i = 0; i < expected_pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < expected_pixels.GetWidth(); ++j) {
+            REQUIRE(expected_pixels(i, j) == streamed_pixels(i, j));
+        }
+    }
+}
+
+TEST_CASE("TestLanczosAreaReduction") {
+    REQUIRE(LanczosScaleFilter::GetAreaReductionFactor(0.5) == 1);
+    REQUIRE(LanczosScaleFilter::GetAreaReductionFactor(1.9) == 1);
+    REQUIRE(LanczosScaleFilter::GetAreaReductionFactor(31.25) == 31);
+
+    PixelArray partial_blocks(3, 5, PixelArray::Pixel{10, 10, 10});
+    partial_blocks(2, 4) = PixelArray::Pixel{250, 250, 250};
+    PixelArray reduced = PixelMath::BoxReduce(partial_blocks, 2, 2);
+    REQUIRE(reduced.GetHeight() == 2);
+    REQUIRE(reduced.GetWidth() == 3);
+    REQUIRE(reduced(0, 0) == PixelArray::Pixel{10, 10, 10});
+    REQUIRE(reduced(1, 2) == PixelArray::Pixel{250, 250, 250});
+
+    // Мелкая шахматная доска при сильном уменьшении должна превращаться в ровный серый цвет
+    Bitmap checkerboard;
+    PixelArray& pixels = checkerboard.GetPixels();
+    pixels.Resize(256, 256);
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            uint8_t value = (i + j) % 2 ? 255 : 0;
+            pixels(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    LanczosScaleFilter(23, 17).Apply(checkerboard);
+    REQUIRE(pixels.GetWidth() == 23);
+    REQUIRE(pixels.GetHeight() == 17);
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            REQUIRE(std::abs(static_cast<int>(pixels(i, j).red) - 128) <= 4);
+        }
+    }
+}
+
+TEST_CASE("TestStreamingLargeDownscale") {
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    FilterPipeline fp;
+    fp.AddFilter(new LanczosScaleFilter(31, 19), "scale 31 19");
+    fp.Apply(expected);
+
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    REQUIRE(streamed.GetPixels().GetWidth() == 31);
+    REQUIRE(streamed.GetPixels().GetHeight() == 19);
+    for (size_t i = 0; i < 19; ++i) {
+        for (size_t j = 0; j < 31; ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == streamed.GetPixels()(i, j));
+        }
+    }
+}
+
+TEST_CASE("TestThumbnailer") {
+    Thumbnailer::SizeVector sizes = Thumbnailer::ParseSizes("256x128,30x40");
+    REQUIRE(sizes.size() == 2);
+    REQUIRE(sizes[0].width == 256);
+    REQUIRE(sizes[0].height == 128);
+    REQUIRE(sizes[1].width == 30);
+    REQUIRE(sizes[1].height == 40);
+    REQUIRE_THROWS_WITH(Thumbnailer::ParseSizes("256"), "wrong thumbnail size format");
+    REQUIRE_THROWS_WITH(Thumbnailer::ParseSizes("abcx12"), "wrong thumbnail size format");
+    REQUIRE_THROWS_WITH(Thumbnailer::ParseSizes("0x12"), "thumbnail size must be positive");
+    REQUIRE(Thumbnailer::GetThumbnailFileName("dir/out.bmp", {64, 32}) == "dir/out_64x32.bmp");
+
+    PixelArray pixels(300, 500, PixelArray::Pixel{40, 80, 120});
+    Thumbnailer thumbnailer;
+    thumbnailer.AddSize(64, 32);
+    thumbnailer.AddSize(400, 250);
+    thumbnailer.AddSize(7, 9);
+    Thumbnailer::PixelArrayVector thumbnails = thumbnailer.Generate(pixels);
+    REQUIRE(thumbnails.size() == 3);
+    for (size_t i = 0; i < thumbnails.size(); ++i) {
+        REQUIRE(thumbnails[i].GetWidth() == thumbnailer.GetSizes()[i].width);
+        REQUIRE(thumbnails[i].GetHeight() == thumbnailer.GetSizes()[i].height);
+        REQUIRE(std::abs(static_cast<int>(thumbnails[i](0, 0).blue) - 120) <= 1);
+    }
+
+    // Размер меньше по площади, но шире предыдущего, получается из уровня не уже себя, так же как без соседа
+    PixelArray stripes(1000, 1000);
+    for (size_t i = 0; i < stripes.GetHeight(); ++i) {
+        for (size_t j = 0; j < stripes.GetWidth(); ++j) {
+            uint8_t value = (i / 3 + j / 5) % 2 == 0 ? 0 : 255;
+            stripes(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    Thumbnailer both;
+    both.AddSize(100, 100);
+    both.AddSize(400, 10);
+    Thumbnailer wide_only;
+    wide_only.AddSize(400, 10);
+    PixelArray with_neighbour = both.Generate(stripes)[1];
+    PixelArray alone = wide_only.Generate(stripes)[0];
+    for (size_t i = 0; i < alone.GetHeight(); ++i) {
+        for (size_t j = 0; j < alone.GetWidth(); ++j) {
+            REQUIRE(with_neighbour(i, j) == alone(i, j));
+        }
+    }
+}
+
+TEST_CASE("TestImagePyramid") {
+    Bitmap bmp;
+    REQUIRE(bmp.Load("../examples/town.bmp"));
+    const PixelArray& pixels = bmp.GetPixels();
+
+    GaussianPyramid gaussian(pixels, 4);
+    REQUIRE(gaussian.GetLevelNum() == 4);
+    REQUIRE(gaussian.GetWidth(1) == (pixels.GetWidth() + 1) / 2);
+    REQUIRE(gaussian.GetHeight(3) == (gaussian.GetHeight(2) + 1) / 2);
+    REQUIRE(gaussian(0, 5, 7) == pixels(5, 7));
+    PixelArray level = gaussian.GetLevel(2);
+    REQUIRE(level.GetWidth() == gaussian.GetWidth(2));
+    REQUIRE(level(1, 1) == gaussian(2, 1, 1));
+    REQUIRE(GaussianPyramid(PixelArray(3, 5), 100).GetLevelNum() == 4);
+
+    // Reduce с полями по краям совпадает с двумя проходами PixelMath::ApplyMatrix, у которого каждый отсчёт
+    // ограничивается краем отдельно
+    PixelArray odd(37, 51);
+    for (size_t i = 0; i < 37; ++i) {
+        for (size_t j = 0; j < 51; ++j) {
+            odd(i, j) = PixelArray::Pixel{static_cast<uint8_t>(i * 37 + j * 11), static_cast<uint8_t>(i * j),
+                                          static_cast<uint8_t>((i + j) % 2 * 255)};
+        }
+    }
+    PixelArray reduced = PyramidMath::Reduce(odd);
+    PixelArray horizontal(37, 26);
+    for (size_t i = 0; i < 37; ++i) {
+        for (size_t j = 0; j < 26; ++j) {
+            horizontal(i, j) = PixelMath::ApplyMatrix(odd, i, j * 2, PyramidMath::GetReduceKernel());
+        }
+    }
+    PixelMath::Matrix vertical_kernel = PixelMath::TransposeMatrix(PyramidMath::GetReduceKernel());
+    for (size_t i = 0; i < 19; ++i) {
+        for (size_t j = 0; j < 26; ++j) {
+            REQUIRE(reduced(i, j) == PixelMath::ApplyMatrix(horizontal, i * 2, j, vertical_kernel));
+        }
+    }
+
+    LaplacianPyramid laplacian(pixels, 5);
+    REQUIRE(laplacian.GetLevelNum() == 5);
+    PixelArray reconstructed = laplacian.Reconstruct();
+    REQUIRE(reconstructed.GetHeight() == pixels.GetHeight());
+    REQUIRE(reconstructed.GetWidth() == pixels.GetWidth());
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            REQUIRE(reconstructed(i, j) == pixels(i, j));
+        }
+    }
+
+    // Размытие через пирамиду должно быть близко к обычному размытию
+    PixelArray pyramid_blurred = pixels;
+    PyramidMath::PyramidBlur(pyramid_blurred, 6);
+    Bitmap blurred = bmp;
+    GaussianBlurFilter(6).Apply(blurred);
+    double error = 0;
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            error += std::abs(static_cast<int>(pyramid_blurred(i, j).green) - blurred.GetPixels()(i, j).green);
+        }
+    }
+    REQUIRE(error / static_cast<double>(pixels.GetHeight() * pixels.GetWidth()) < 3);
+}
+
+TEST_CASE("TestPipelineOptimizer") {
+    PipelineOptimizer optimizer;
+    CmdLineParser::FilterDescriptorVector fdv = {{"neg", {}}, {"neg", {}}, {"gs", {}}, {"gs", {}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -gs");
+
+    fdv = {{"sharp", {}}, {"crop", {"100", "50"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 2000, 1000)) == " -crop 101 51 -sharp -crop 100 50");
+    // Изображение и так не больше обрезки с запасом
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 101, 40)) == " -sharp -crop 100 50");
+
+    fdv = {{"neg", {}}, {"crop", {"10", "10"}}, {"crop", {"20", "5"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -crop 10 5 -neg");
+
+    fdv = {{"gs", {}}, {"scale", {"50", "50"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -scale 50 50 -gs");
+    fdv = {{"scale", {"200", "200"}}, {"neg", {}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -neg -scale 200 200");
+
+    // Объединение масштабирований и перенос размытия меняют пиксели и по умолчанию не применяются
+    fdv = {{"scale", {"400", "300"}}, {"scale", {"200", "100", "2"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -scale 400 300 -scale 200 100 2");
+    fdv = {{"blur", {"5"}}, {"scale", {"512", "512"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 2048, 2048)) == " -blur 5 -scale 512 512");
+    std::stringstream explanation;
+    optimizer.Explain(explanation);
+    REQUIRE(explanation.str() == "original plan: -blur 5 -scale 512 512\napproximate rewrites: off\n"
+                                 "optimized plan: -blur 5 -scale 512 512\n");
+
+    optimizer.EnableApproximate(true);
+    fdv = {{"scale", {"400", "300"}}, {"scale", {"200", "100", "2"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -scale 200 100 2");
+    fdv = {{"scale", {"10", "10"}}, {"scale", {"200", "100"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 100, 100)) == " -scale 10 10 -scale 200 100");
+    fdv = {{"blur", {"5"}}, {"scale", {"512", "512"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 2048, 2048)) == " -scale 512 512 -blur 1.25");
+    fdv = {{"blur", {"0.5"}}, {"scale", {"512", "512"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 2048, 2048)) == " -scale 512 512");
+    fdv = {{"blur", {"5"}}, {"scale", {"512", "100"}}};
+    REQUIRE(PipelineOptimizer::ToString(optimizer.Optimize(fdv, 2048, 2048)) == " -blur 5 -scale 512 100");
+    explanation.str("");
+    optimizer.Explain(explanation);
+    REQUIRE(explanation.str() == "original plan: -blur 5 -scale 512 100\napproximate rewrites: on\n"
+                                 "optimized plan: -blur 5 -scale 512 100\n");
+    optimizer.EnableApproximate(false);
+
+    // Переставленная цепочка должна давать тот же результат
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    Bitmap optimized = expected;
+    fdv = {{"blur", {"1"}}, {"neg", {}}, {"sharp", {}}, {"crop", {"60", "40"}}};
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("crop", &FilterFactories::MakeCropFilter);
+    fpf.AddFilterMaker("neg", &FilterFactories::MakeNegativeFilter);
+    fpf.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
+    FilterPipeline fp_expected;
+    REQUIRE(fpf.CreateFilterPipeline(fp_expected, fdv));
+    fp_expected.EnableRegionPropagation(false);
+    fp_expected.Apply(expected);
+    FilterPipeline fp_optimized;
+    CmdLineParser::FilterDescriptorVector optimized_fdv = optimizer.Optimize(fdv, optimized.GetPixels().GetWidth(),
+                                                                             optimized.GetPixels().GetHeight());
+    REQUIRE(optimized_fdv.front().filter_name == "crop");
+    REQUIRE(fpf.CreateFilterPipeline(fp_optimized, optimized_fdv));
+    fp_optimized.Apply(optimized);
+    REQUIRE(optimized.GetPixels().GetWidth() == 60);
+    REQUIRE(optimized.GetPixels().GetHeight() == 40);
+    for (size_t i = 0; i < 40; ++i) {
+        for (size_t j = 0; j < 60; ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == optimized.GetPixels()(i, j));
+        }
+    }
+}
+
+TEST_CASE("TestApproximateRewrites") {
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("scale", &FilterFactories::MakeLanczosScaleFilter);
+    size_t width = source.GetPixels().GetWidth();
+    size_t height = source.GetPixels().GetHeight();
+    PipelineOptimizer optimizer;
+    optimizer.EnableApproximate(true);
+    // Средняя и наибольшая разница каналов результатов исходной и переписанной цепочек
+    auto compare = [&](const CmdLineParser::FilterDescriptorVector& fdv) {
+        Bitmap expected = source;
+        FilterPipeline fp_expected;
+        REQUIRE(fpf.CreateFilterPipeline(fp_expected, fdv));
+        fp_expected.Apply(expected);
+        CmdLineParser::FilterDescriptorVector optimized_fdv = optimizer.Optimize(fdv, width, height);
+        REQUIRE(PipelineOptimizer::ToString(optimized_fdv) != PipelineOptimizer::ToString(fdv));
+        Bitmap optimized = source;
+        FilterPipeline fp_optimized;
+        REQUIRE(fpf.CreateFilterPipeline(fp_optimized, optimized_fdv));
+        fp_optimized.Apply(optimized);
+        const PixelArray& a = expected.GetPixels();
+        const PixelArray& b = optimized.GetPixels();
+        REQUIRE(a.GetHeight() == b.GetHeight());
+        REQUIRE(a.GetWidth() == b.GetWidth());
+        double total = 0;
+        int max_difference = 0;
+        for (size_t i = 0; i < a.GetHeight(); ++i) {
+            for (size_t j = 0; j < a.GetWidth(); ++j) {
+                for (auto channel : {&PixelArray::Pixel::red, &PixelArray::Pixel::green, &PixelArray::Pixel::blue}) {
+                    int difference = std::abs(a(i, j).*channel - b(i, j).*channel);
+                    total += difference;
+                    max_difference = std::max(max_difference, difference);
+                }
+            }
+        }
+        return std::make_pair(total / static_cast<double>(a.GetHeight() * a.GetWidth() * 3), max_difference);
+    };
+    // Размытие после уменьшения в 4 раза: в среднем меньше полутора единиц
+    auto blur = compare({{"blur", {"4"}}, {"scale", {std::to_string(width / 4), std::to_string(height / 4)}}});
+    REQUIRE(blur.first < 1.5);
+    REQUIRE(blur.second <= 24);
+    // Одно уменьшение в 5 раз вместо уменьшений в 2 и 2.5 раза иначе сглаживает мелкие детали
+    auto scales = compare({{"scale", {std::to_string(width / 2), std::to_string(height / 2)}},
+                           {"scale", {std::to_string(width / 5), std::to_string(height / 5)}}});
+    REQUIRE(scales.first < 8);
+    REQUIRE(scales.second <= 64);
+}
+
+TEST_CASE("TestRegionPropagation") {
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("crop", &FilterFactories::MakeCropFilter);
+    fpf.AddFilterMaker("gs", &FilterFactories::MakeGrayscaleFilter);
+    fpf.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
+    fpf.AddFilterMaker("edge", &FilterFactories::MakeEdgeDetectionFilter);
+    fpf.AddFilterMaker("scale", &FilterFactories::MakeLanczosScaleFilter);
+    fpf.AddFilterMaker("transpose", &FilterFactories::MakeTransposeFilter);
+    fpf.AddFilterMaker("flip", &FilterFactories::MakeFlipFilter);
+
+    FilterPipeline fp;
+    REQUIRE(fpf.CreateFilterPipeline(fp, {{"sharp", {}}, {"blur", {"1"}}, {"crop", {"60", "40"}}}));
+    FilterPipeline::RegionPlan plan = fp.PlanRegions(200, 100);
+    REQUIRE(plan.first_stage == 0);
+    // Верхние 40 строк и ещё 3 + 1 строки запаса для размытия и повышения резкости
+    REQUIRE(plan.regions[0] == Region{56, 0, 44, 64});
+    REQUIRE(plan.regions[2] == Region{60, 0, 40, 60});
+    REQUIRE(plan.regions[3] == Region{0, 0, 40, 60});
+
+    // До масштабирования нужна вся картинка
+    fp.Clear();
+    REQUIRE(fpf.CreateFilterPipeline(fp, {{"blur", {"1"}}, {"scale", {"100", "50"}}, {"sharp", {}},
+                                          {"crop", {"10", "10"}}}));
+    plan = fp.PlanRegions(200, 100);
+    REQUIRE(plan.first_stage == 2);
+    REQUIRE(plan.regions[2] == Region{39, 0, 11, 11});
+
+    // Без обрезки считать меньше нечего
+    fp.Clear();
+    REQUIRE(fpf.CreateFilterPipeline(fp, {{"blur", {"1"}}, {"gs", {}}}));
+    REQUIRE(fp.PlanRegions(200, 100).first_stage == 2);
+
+    const std::vector<CmdLineParser::FilterDescriptorVector> pipelines = {
+        {{"sharp", {}}, {"blur", {"1.5"}}, {"crop", {"60", "40"}}},
+        {{"edge", {"0.1"}}, {"crop", {"100", "80"}}, {"blur", {"2"}}, {"gs", {}}, {"crop", {"30", "70"}}},
+        {{"blur", {"1"}}, {"scale", {"120", "90"}}, {"sharp", {}}, {"crop", {"50", "50"}}},
+        {{"crop", {"5000", "5000"}}, {"sharp", {}}, {"crop", {"1", "1"}}},
+        {{"blur", {"1"}}, {"transpose", {}}, {"flip", {"h"}}, {"sharp", {}}, {"crop", {"40", "70"}}},
+        {{"flip", {"v"}}, {"edge", {"0.2"}}, {"transpose", {}}, {"crop", {"50", "30"}}},
+        {{"blur", {"1.5", "reflect"}}, {"sharp", {"constant"}}, {"crop", {"60", "40"}}},
+        {{"sharp", {"wrap"}}, {"edge", {"0.1", "reflect"}}, {"crop", {"30", "20"}}},
+    };
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    for (const CmdLineParser::FilterDescriptorVector& fdv : pipelines) {
+        Bitmap expected = source;
+        Bitmap actual = source;
+        FilterPipeline fp_expected;
+        REQUIRE(fpf.CreateFilterPipeline(fp_expected, fdv));
+        fp_expected.EnableRegionPropagation(false);
+        fp_expected.Apply(expected);
+        FilterPipeline fp_actual;
+        REQUIRE(fpf.CreateFilterPipeline(fp_actual, fdv));
+        fp_actual.Apply(actual);
+        const PixelArray& expected_pixels = expected.GetPixels();
+        const PixelArray& actual_pixels = actual.GetPixels();
+        REQUIRE(expected_pixels.GetWidth() == actual_pixels.GetWidth());
+        REQUIRE(expected_pixels.GetHeight() == actual_pixels.GetHeight());
+        for (size_t i = 0; i < expected_pixels.GetHeight(); ++i) {
+            for (size_t j = 0; j < expected_pixels.GetWidth(); ++j) {
+                REQUIRE(expected_pixels(i, j) == actual_pixels(i, j));
+            }
+        }
+    }
+}
+
+TEST_CASE("TestResultCache") {
+    REQUIRE(XXHash64::Hash("") == 0xEF46DB3751D8E999ULL);
+    REQUIRE(XXHash64::Hash("abc") == 0x44BC2CF5AD770999ULL);
+    std::string text = "Nobody inspects the spammish repetition";
+    REQUIRE(XXHash64::Hash(text) == 0xFBCEA83C8A378BF1ULL);
+    XXHash64 partial_hash;
+    partial_hash.Update(text.substr(0, 5));
+    partial_hash.Update(text.substr(5));
+    REQUIRE(partial_hash.Digest() == XXHash64::Hash(text));
+
+    CmdLineParser::FilterDescriptorVector fdv = {{"blur", {"5.0"}}, {"crop", {"10", "20"}}};
+    CmdLineParser::FilterDescriptorVector same_fdv = {{"blur", {"5"}}, {"crop", {"10", "20"}}};
+    CmdLineParser::FilterDescriptorVector other_fdv = {{"blur", {"5"}}, {"crop", {"102", "0"}}};
+    REQUIRE(ResultCache::Serialize(fdv) == ResultCache::Serialize(same_fdv));
+    REQUIRE(ResultCache::Serialize(fdv) != ResultCache::Serialize(other_fdv));
+    std::stringstream input("image");
+    uint64_t key = 0;
+    REQUIRE(ResultCache::ComputeKey(input, fdv, "", key));
+    std::stringstream other_input("image");
+    uint64_t other_key = 0;
+    REQUIRE(ResultCache::ComputeKey(other_input, fdv, "no-optimize", other_key));
+    REQUIRE(key != other_key);
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "image_processor_test_cache";
+    std::filesystem::remove_all(directory);
+    std::filesystem::path result = directory / "result.bmp";
+    std::filesystem::path output = directory / "output.bmp";
+    // Места хватает только на две записи по 100 байт
+    ResultCache cache(directory / "cache", 250);
+    REQUIRE(cache.Open());
+    std::ofstream(result) << std::string(100, 'a');
+    REQUIRE_FALSE(cache.Lookup(1, output));
+    REQUIRE(cache.Store(1, result));
+    REQUIRE(cache.Lookup(1, output));
+    REQUIRE(std::filesystem::file_size(output) == 100);
+    REQUIRE(cache.Store(2, result));
+    // Запись 1 использована позже записи 2, поэтому вытесняется запись 2
+    std::filesystem::last_write_time(cache.GetEntryPath(2), std::filesystem::file_time_type::clock::now() -
+                                                            std::chrono::hours(1));
+    REQUIRE(cache.Store(3, result));
+    REQUIRE(cache.Lookup(1, output));
+    REQUIRE_FALSE(cache.Lookup(2, output));
+    REQUIRE(cache.Lookup(3, output));
+    ResultCache::Stats stats = cache.GetStats();
+    REQUIRE(stats.hits == 3);
+    REQUIRE(stats.misses == 2);
+    REQUIRE(stats.evictions == 1);
+    REQUIRE(stats.entries == 2);
+    REQUIRE(stats.bytes == 200);
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("TestPrefixCache") {
+    PixelArray small(10, 10, PixelArray::Pixel{1, 2, 3});
+    PrefixCache cache(PrefixCache::GetByteSize(small) * 2);
+    cache.Insert("a", small);
+    cache.Insert("b", small);
+    REQUIRE(cache.Find("a") != nullptr);
+    cache.Insert("c", small);
+    // "b" использовался раньше всех и вытеснен
+    REQUIRE(cache.Find("b") == nullptr);
+    REQUIRE(cache.Find("a") != nullptr);
+    REQUIRE((*cache.Find("c"))(9, 9) == PixelArray::Pixel{1, 2, 3});
+    cache.Insert("big", PixelArray(10, 30));
+    REQUIRE(cache.Find("big") == nullptr);
+    REQUIRE(cache.GetStats().evictions == 1);
+    REQUIRE(cache.GetSize() == PrefixCache::GetByteSize(small) * 2);
+
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("crop", &FilterFactories::MakeCropFilter);
+    fpf.AddFilterMaker("neg", &FilterFactories::MakeNegativeFilter);
+    fpf.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
+    fpf.AddFilterMaker("scale", &FilterFactories::MakeLanczosScaleFilter);
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    PrefixCache pipeline_cache(64 << 20);
+    const std::vector<CmdLineParser::FilterDescriptorVector> pipelines = {
+        {{"scale", {"100", "80"}}, {"blur", {"2"}}, {"neg", {}}},
+        {{"scale", {"100", "80"}}, {"blur", {"2"}}, {"sharp", {}}},
+        {{"scale", {"100", "80"}}, {"blur", {"2"}}, {"sharp", {}}, {"crop", {"20", "20"}}},
+    };
+    for (const CmdLineParser::FilterDescriptorVector& fdv : pipelines) {
+        Bitmap expected = source;
+        FilterPipeline fp_expected;
+        REQUIRE(fpf.CreateFilterPipeline(fp_expected, fdv));
+        fp_expected.Apply(expected);
+        Bitmap actual = source;
+        FilterPipeline fp_actual;
+        REQUIRE(fpf.CreateFilterPipeline(fp_actual, fdv));
+        fp_actual.SetPrefixCache(&pipeline_cache, 1);
+        fp_actual.EnableProfiling(true);
+        fp_actual.Apply(actual);
+        const PixelArray& expected_pixels = expected.GetPixels();
+        const PixelArray& actual_pixels = actual.GetPixels();
+        REQUIRE(expected_pixels.GetWidth() == actual_pixels.GetWidth());
+        REQUIRE(expected_pixels.GetHeight() == actual_pixels.GetHeight());
+        for (size_t i = 0; i < expected_pixels.GetHeight(); ++i) {
+            for (size_t j = 0; j < expected_pixels.GetWidth(); ++j) {
+                REQUIRE(expected_pixels(i, j) == actual_pixels(i, j));
+            }
+        }
+        if (&fdv != &pipelines.front()) {
+            // Общее начало не пересчитывается
+            REQUIRE(fp_actual.GetStats().front().name != "scale 100 80");
+        }
+    }
+    // Второй конвейер взял результат "scale blur", третий -- только "scale": после масштабирования
+    // он считает лишь область под обрезкой, и такие результаты не сохраняются
+    REQUIRE(pipeline_cache.GetStats().hits == 2);
+    REQUIRE(pipeline_cache.GetSize() == PrefixCache::GetByteSize(PixelArray(80, 100)) * 4);
+}
+
+namespace {
+    PixelArray MakeNoise(size_t height, size_t width, unsigned seed) {
+        std::mt19937 generator(seed);
+        std::uniform_int_distribution<int> channel(0, 255);
+        PixelArray pixels(height, width);
+        for (size_t i = 0; i < height; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                pixels(i, j) = PixelArray::Pixel{static_cast<uint8_t>(channel(generator)),
+                                                 static_cast<uint8_t>(channel(generator)),
+                                                 static_cast<uint8_t>(channel(generator))};
+            }
+        }
+        return pixels;
+    }
+
+    uint8_t NaiveMedian(const PixelArray& pixels, int64_t row, int64_t column, int64_t radius,
+                        uint8_t PixelArray::Pixel::*channel) {
+        std::vector<uint8_t> values;
+        int64_t height = static_cast<int64_t>(pixels.GetHeight());
+        int64_t width = static_cast<int64_t>(pixels.GetWidth());
+        for (int64_t i = row - radius; i <= row + radius; ++i) {
+            for (int64_t j = column - radius; j <= column + radius; ++j) {
+                values.push_back(pixels(std::clamp<int64_t>(i, 0, height - 1),
+                                        std::clamp<int64_t>(j, 0, width - 1)).*channel);
+            }
+        }
+        std::nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+        return values[values.size() / 2];
+    }
+}
+
+TEST_CASE("TestMedianFilter") {
+    Bitmap noise;
+    noise.GetPixels() = MakeNoise(41, 23, 5);
+    for (size_t thread_num : {1, 3}) {
+        Parallel::SetThreadNum(thread_num);
+        for (int64_t radius : {1, 2, 4, 30}) {
+            Bitmap filtered = noise;
+            MedianFilter(radius).Apply(filtered);
+            for (size_t i = 0; i < 41; ++i) {
+                for (size_t j = 0; j < 23; ++j) {
+                    const PixelArray::Pixel& pixel = filtered.GetPixels()(i, j);
+                    REQUIRE(pixel.red == NaiveMedian(noise.GetPixels(), i, j, radius, &PixelArray::Pixel::red));
+                    REQUIRE(pixel.green == NaiveMedian(noise.GetPixels(), i, j, radius, &PixelArray::Pixel::green));
+                    REQUIRE(pixel.blue == NaiveMedian(noise.GetPixels(), i, j, radius, &PixelArray::Pixel::blue));
+                }
+            }
+        }
+    }
+    Parallel::SetThreadNum(0);
+
+    FilterPipeline fp;
+    fp.AddFilter(new MedianFilter(3), "median 3");
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    fp.Apply(expected);
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    for (size_t i = 0; i < expected.GetPixels().GetHeight(); ++i) {
+        for (size_t j = 0; j < expected.GetPixels().GetWidth(); ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == streamed.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeMedianFilter({"median", {"0"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeMedianFilter({"median", {"128"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeMedianFilter({"median", {}}), std::invalid_argument);
+    delete FilterFactories::MakeMedianFilter({"median", {"127"}});
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkMedianFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(1080, 1920, 7);
+    for (size_t radius = 1; radius <= 30; ++radius) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        MedianFilter(radius).Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << "median " << radius << ": " << std::chrono::duration<double, std::milli>(finish - start).count()
+                  << " ms" << std::endl;
+    }
+}
+
+TEST_CASE("TestBilateralFilter") {
+    // Ступенька между двумя однотонными половинами должна остаться резкой
+    Bitmap step;
+    step.GetPixels() = PixelArray(40, 60, PixelArray::Pixel{20, 30, 40});
+    for (size_t i = 0; i < 40; ++i) {
+        for (size_t j = 30; j < 60; ++j) {
+            step.GetPixels()(i, j) = PixelArray::Pixel{220, 210, 200};
+        }
+    }
+    Bitmap filtered = step;
+    BilateralFilter(4, 20).Apply(filtered);
+    for (size_t i = 0; i < 40; ++i) {
+        for (size_t j = 0; j < 60; ++j) {
+            REQUIRE(filtered.GetPixels()(i, j) == step.GetPixels()(i, j));
+        }
+    }
+
+    // Шум на ровном фоне сглаживается
+    Bitmap noisy;
+    noisy.GetPixels() = PixelArray(64, 64);
+    std::mt19937 generator(3);
+    std::uniform_int_distribution<int> noise(-10, 10);
+    for (size_t i = 0; i < 64; ++i) {
+        for (size_t j = 0; j < 64; ++j) {
+            uint8_t value = static_cast<uint8_t>(128 + noise(generator));
+            noisy.GetPixels()(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    auto deviation = [](const PixelArray& pixels) {
+        double sum = 0;
+        for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+            for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+                sum += std::abs(pixels(i, j).red - 128);
+            }
+        }
+        return sum / static_cast<double>(pixels.GetHeight() * pixels.GetWidth());
+    };
+    filtered = noisy;
+    BilateralFilter(3, 30).Apply(filtered);
+    REQUIRE(deviation(filtered.GetPixels()) < deviation(noisy.GetPixels()) / 3);
+
+    // При малых sigma сетка большого изображения не растёт больше допустимой
+    BilateralFilter fine(1, 1);
+    BilateralFilter::GridLayout small_layout = fine.GetGridLayout(10, 10);
+    REQUIRE(small_layout.spatial_step == 1);
+    REQUIRE(small_layout.range_step == 1);
+    BilateralFilter::GridLayout large_layout = fine.GetGridLayout(3000, 4000);
+    REQUIRE(large_layout.cells <= 3000 * 4000 / BilateralFilter::PIXELS_PER_GRID_CELL);
+    REQUIRE(large_layout.spatial_step > 1);
+    REQUIRE(large_layout.range_step / large_layout.spatial_step == Approx(1));
+    Bitmap large_step;
+    large_step.GetPixels() = PixelArray(1000, 1000, PixelArray::Pixel{20, 30, 40});
+    for (size_t i = 0; i < 1000; ++i) {
+        for (size_t j = 500; j < 1000; ++j) {
+            large_step.GetPixels()(i, j) = PixelArray::Pixel{220, 210, 200};
+        }
+    }
+    filtered = large_step;
+    fine.Apply(filtered);
+    REQUIRE(filtered.GetPixels()(500, 499) == large_step.GetPixels()(500, 499));
+    REQUIRE(filtered.GetPixels()(500, 500) == large_step.GetPixels()(500, 500));
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeBilateralFilter({"bilateral", {"0.5", "10"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeBilateralFilter({"bilateral", {"5"}}), std::invalid_argument);
+    delete FilterFactories::MakeBilateralFilter({"bilateral", {"5", "10"}});
+}
+
+TEST_CASE("TestUnsharpMaskFilter") {
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    const double amount = 1.5;
+    const double threshold = 4;
+    Bitmap blurred = source;
+    GaussianBlurFilter(2).Apply(blurred);
+    Bitmap sharpened = source;
+    UnsharpMaskFilter(2, amount, threshold).Apply(sharpened);
+    auto expected_channel = [amount, threshold](uint8_t value, uint8_t blurred_value) {
+        double difference = value - blurred_value;
+        if (std::abs(difference) < threshold) {
+            return value;
+        }
+        return static_cast<uint8_t>(std::clamp(static_cast<int>(std::round(value + amount * difference)), 0, 255));
+    };
+    const PixelArray& pixels = source.GetPixels();
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            const PixelArray::Pixel& blurred_pixel = blurred.GetPixels()(i, j);
+            PixelArray::Pixel expected{expected_channel(pixels(i, j).red, blurred_pixel.red),
+                                       expected_channel(pixels(i, j).green, blurred_pixel.green),
+                                       expected_channel(pixels(i, j).blue, blurred_pixel.blue)};
+            REQUIRE(sharpened.GetPixels()(i, j) == expected);
+        }
+    }
+
+    FilterPipeline fp;
+    fp.AddFilter(new UnsharpMaskFilter(2, amount, threshold), "unsharp 2 1.5 4");
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    for (size_t i = 0; i < pixels.GetHeight(); ++i) {
+        for (size_t j = 0; j < pixels.GetWidth(); ++j) {
+            REQUIRE(streamed.GetPixels()(i, j) == sharpened.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeUnsharpMaskFilter({"unsharp", {"0", "1", "0"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeUnsharpMaskFilter({"unsharp", {"1", "1"}}), std::invalid_argument);
+    delete FilterFactories::MakeUnsharpMaskFilter({"unsharp", {"1", "0.5", "2"}});
+}
+
+TEST_CASE("TestMorphologyFilter") {
+    Bitmap noise;
+    noise.GetPixels() = MakeNoise(37, 29, 11);
+    const PixelArray& pixels = noise.GetPixels();
+    int64_t height = static_cast<int64_t>(pixels.GetHeight());
+    int64_t width = static_cast<int64_t>(pixels.GetWidth());
+    // Наивная эрозия (дилатация) с окном [x - anchor, x - anchor + size - 1]
+    auto naive = [height, width](const PixelArray& source, int64_t size_x, int64_t size_y, int64_t anchor_x,
+                                 int64_t anchor_y, bool is_max) {
+        PixelArray result(height, width);
+        for (int64_t i = 0; i < height; ++i) {
+            for (int64_t j = 0; j < width; ++j) {
+                PixelArray::Pixel value = source(i, j);
+                for (int64_t k = i - anchor_y; k < i - anchor_y + size_y; ++k) {
+                    for (int64_t l = j - anchor_x; l < j - anchor_x + size_x; ++l) {
+                        const PixelArray::Pixel& current = source(std::clamp<int64_t>(k, 0, height - 1),
+                                                                  std::clamp<int64_t>(l, 0, width - 1));
+                        auto select = [is_max](uint8_t lhv, uint8_t rhv) {
+                            return is_max ? std::max(lhv, rhv) : std::min(lhv, rhv);
+                        };
+                        value = {select(value.red, current.red), select(value.green, current.green),
+                                 select(value.blue, current.blue)};
+                    }
+                }
+                result(i, j) = value;
+            }
+        }
+        return result;
+    };
+    for (size_t thread_num : {1, 2}) {
+        Parallel::SetThreadNum(thread_num);
+        for (auto [size_x, size_y] : std::vector<std::pair<int64_t, int64_t>>{{1, 1}, {3, 3}, {4, 7}, {15, 2},
+                                                                              {40, 50}}) {
+            PixelArray eroded = naive(pixels, size_x, size_y, size_x / 2, size_y / 2, false);
+            PixelArray dilated = naive(pixels, size_x, size_y, size_x - 1 - size_x / 2, size_y - 1 - size_y / 2, true);
+            PixelArray opened = naive(eroded, size_x, size_y, size_x - 1 - size_x / 2, size_y - 1 - size_y / 2, true);
+            PixelArray closed = naive(dilated, size_x, size_y, size_x / 2, size_y / 2, false);
+            std::vector<std::pair<MorphologyFilter::Operation, const PixelArray*>> cases = {
+                {MorphologyFilter::Operation::ERODE, &eroded}, {MorphologyFilter::Operation::DILATE, &dilated},
+                {MorphologyFilter::Operation::OPEN, &opened}, {MorphologyFilter::Operation::CLOSE, &closed}};
+            for (auto [operation, expected] : cases) {
+                Bitmap filtered = noise;
+                MorphologyFilter(operation, size_x, size_y).Apply(filtered);
+                for (int64_t i = 0; i < height; ++i) {
+                    for (int64_t j = 0; j < width; ++j) {
+                        REQUIRE(filtered.GetPixels()(i, j) == (*expected)(i, j));
+                    }
+                }
+            }
+        }
+    }
+    Parallel::SetThreadNum(0);
+
+    FilterPipeline fp;
+    fp.AddFilter(new MorphologyFilter(MorphologyFilter::Operation::CLOSE, 6, 5), "close 6 5");
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    fp.Apply(expected);
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    for (size_t i = 0; i < expected.GetPixels().GetHeight(); ++i) {
+        for (size_t j = 0; j < expected.GetPixels().GetWidth(); ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == streamed.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeMorphologyFilter({"erode", {"0", "3"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeMorphologyFilter({"thin", {"3", "3"}}), std::invalid_argument);
+    delete FilterFactories::MakeMorphologyFilter({"open", {"3", "3"}});
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkMorphologyFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(1080, 1920, 7);
+    for (size_t size : {3, 7, 15, 31, 61}) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        MorphologyFilter(MorphologyFilter::Operation::ERODE, size, size).Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << "erode " << size << "x" << size << ": "
+                  << std::chrono::duration<double, std::milli>(finish - start).count() << " ms" << std::endl;
+    }
+}
+
+TEST_CASE("TestCannyFilter") {
+    // Вертикальная ступенька между столбцами 9 и 10: в верхней половине высотой top, в нижней -- bottom
+    auto make_step = [](uint8_t bottom, uint8_t top) {
+        Bitmap image;
+        image.GetPixels() = PixelArray(20, 20);
+        for (size_t i = 0; i < 20; ++i) {
+            for (size_t j = 10; j < 20; ++j) {
+                uint8_t value = i < 10 ? bottom : top;
+                image.GetPixels()(i, j) = PixelArray::Pixel{value, value, value};
+            }
+        }
+        return image;
+    };
+    auto is_edge = [](Bitmap& image, size_t i, size_t j) {
+        return image.GetPixels()(i, j) == PixelArray::Pixel{255, 255, 255};
+    };
+
+    // Ровно один столбец границы (столбцы 9 и 10 одинаково близки к ступеньке, остаётся один из них)
+    Bitmap step = make_step(255, 255);
+    CannyFilter(0.1, 0.3, 1).Apply(step);
+    size_t edge_column = is_edge(step, 0, 9) ? 9 : 10;
+    for (size_t i = 0; i < 20; ++i) {
+        for (size_t j = 0; j < 20; ++j) {
+            REQUIRE(is_edge(step, i, j) == (j == edge_column));
+        }
+    }
+
+    // Слабая граница без сильной пропадает
+    Bitmap weak = make_step(40, 40);
+    CannyFilter(0.05, 0.5, 1).Apply(weak);
+    for (size_t i = 0; i < 20; ++i) {
+        for (size_t j = 0; j < 20; ++j) {
+            REQUIRE_FALSE(is_edge(weak, i, j));
+        }
+    }
+
+    // Высота ступеньки плавно растёт от 40 в строке 0 до 255 в строке 39: граница сильная только
+    // в верхних строках, но слабые строки под ней остаются, если их градиент не меньше low
+    Bitmap ramp;
+    ramp.GetPixels() = PixelArray(40, 20);
+    for (size_t i = 0; i < 40; ++i) {
+        for (size_t j = 10; j < 20; ++j) {
+            uint8_t value = 40 + 215 * i / 39;
+            ramp.GetPixels()(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    Bitmap connected = ramp;
+    CannyFilter(0.05, 0.5, 1).Apply(connected);
+    for (size_t i = 0; i < 40; ++i) {
+        REQUIRE((is_edge(connected, i, 9) || is_edge(connected, i, 10)));
+    }
+    Bitmap disconnected = ramp;
+    CannyFilter(0.2, 0.5, 1).Apply(disconnected);
+    REQUIRE((is_edge(disconnected, 39, 9) || is_edge(disconnected, 39, 10)));
+    REQUIRE_FALSE((is_edge(disconnected, 0, 9) || is_edge(disconnected, 0, 10)));
+
+    // Результат не зависит от разбиения на полосы
+    Bitmap noise;
+    noise.GetPixels() = MakeNoise(101, 37, 13);
+    Parallel::SetThreadNum(1);
+    Bitmap expected = noise;
+    CannyFilter(0.1, 0.2, 1.5).Apply(expected);
+    Parallel::SetThreadNum(4);
+    Bitmap banded = noise;
+    CannyFilter(0.1, 0.2, 1.5).Apply(banded);
+    Parallel::SetThreadNum(0);
+    for (size_t i = 0; i < 101; ++i) {
+        for (size_t j = 0; j < 37; ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == banded.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeCannyFilter({"canny", {"0.3", "0.1", "1"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeCannyFilter({"canny", {"0.1", "0.3", "0"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeCannyFilter({"canny", {"0.1", "0.3"}}), std::invalid_argument);
+    delete FilterFactories::MakeCannyFilter({"canny", {"0.1", "0.3", "1.4"}});
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkCannyFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(1080, 1920, 3);
+    auto measure = [&source](BaseFilter&& filter, const std::string& name) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        filter.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(EdgeDetectionFilter(0.1), "edge 0.1");
+    measure(CannyFilter(0.1, 0.2, 1), "canny 0.1 0.2 1");
+    measure(CannyFilter(0.1, 0.2, 3), "canny 0.1 0.2 3");
+}
+
+TEST_CASE("TestFixedKernel") {
+    static constexpr FixedKernel::Kernel<3, 3> SHARPEN = {{{0, -1, 0}, {-1, 5, -1}, {0, -1, 0}}};
+    static constexpr FixedKernel::Kernel<3, 5> WIDE = {{{1, 0, -2, 0, 1}, {3, -1, 7, -1, 3}, {0, 2, 0, 2, 0}},
+                                                       16};
+    auto to_matrix = [](const auto& kernel) {
+        PixelMath::Matrix matrix;
+        for (const auto& kernel_row : kernel.weights) {
+            matrix.emplace_back();
+            for (int weight : kernel_row) {
+                matrix.back().push_back(static_cast<double>(weight) / kernel.divisor);
+            }
+        }
+        return matrix;
+    };
+    // Результат совпадает с общей свёрткой, в том числе на изображениях уже ядра
+    for (auto [height, width] : {std::pair<size_t, size_t>{37, 29}, {1, 1}, {2, 3}, {5, 1}}) {
+        PixelArray pixels = MakeNoise(height, width, 23);
+        PixelArray sharpened = FixedKernel::Apply<SHARPEN>(pixels);
+        PixelArray widened = FixedKernel::Apply<WIDE>(pixels);
+        for (size_t i = 0; i < height; ++i) {
+            for (size_t j = 0; j < width; ++j) {
+                REQUIRE(sharpened(i, j) == PixelMath::ApplyMatrix(pixels, i, j, to_matrix(SHARPEN)));
+                REQUIRE(widened(i, j) == PixelMath::ApplyMatrix(pixels, i, j, to_matrix(WIDE)));
+            }
+        }
+    }
+}
+
+TEST_CASE("TestBorderModes") {
+    // Строка a b c d: за левым краем, затем за правым
+    REQUIRE(Border::Resolve(-2, 4, BorderMode::CLAMP) == 0);
+    REQUIRE(Border::Resolve(5, 4, BorderMode::CLAMP) == 3);
+    REQUIRE(Border::Resolve(-2, 4, BorderMode::REFLECT) == 2);
+    REQUIRE(Border::Resolve(5, 4, BorderMode::REFLECT) == 1);
+    REQUIRE(Border::Resolve(-7, 4, BorderMode::REFLECT) == 1);
+    REQUIRE(Border::Resolve(3, 1, BorderMode::REFLECT) == 0);
+    REQUIRE(Border::Resolve(-2, 4, BorderMode::WRAP) == 2);
+    REQUIRE(Border::Resolve(9, 4, BorderMode::WRAP) == 1);
+    REQUIRE(Border::Resolve(-1, 4, BorderMode::CONSTANT) == -1);
+    REQUIRE(Border::Resolve(2, 4, BorderMode::CONSTANT) == 2);
+
+    const std::vector<BorderMode> modes = {BorderMode::CLAMP, BorderMode::REFLECT, BorderMode::WRAP,
+                                           BorderMode::CONSTANT};
+    PixelArray pixels = MakeNoise(19, 13, 29);
+    auto at = [&pixels](int64_t i, int64_t j, BorderMode mode) {
+        int64_t row = Border::Resolve(i, static_cast<int64_t>(pixels.GetHeight()), mode);
+        int64_t column = Border::Resolve(j, static_cast<int64_t>(pixels.GetWidth()), mode);
+        return row < 0 || column < 0 ? PixelArray::Pixel{0, 0, 0} : pixels(row, column);
+    };
+    std::vector<PixelArray::Pixel> padded(21);
+    Border::PadRow(&pixels(0, 0), 13, -4, 17, BorderMode::REFLECT, padded.data());
+    for (int64_t j = -4; j < 17; ++j) {
+        REQUIRE(padded[j + 4] == at(0, j, BorderMode::REFLECT));
+    }
+
+    // Ядро с проверкой каждого отсчёта для сравнения
+    static constexpr FixedKernel::Kernel<3, 5> KERNEL = {{{1, 0, -2, 0, 1}, {3, -1, 7, -1, 3}, {0, 2, 0, 2, 0}}, 16};
+    for (BorderMode mode : modes) {
+        PixelArray convolved = FixedKernel::Apply<KERNEL>(pixels, mode);
+        for (int64_t i = 0; i < 19; ++i) {
+            for (int64_t j = 0; j < 13; ++j) {
+                int sum[3] = {0, 0, 0};
+                for (int64_t k = 0; k < 3; ++k) {
+                    for (int64_t l = 0; l < 5; ++l) {
+                        PixelArray::Pixel pixel = at(i + k - 1, j + l - 2, mode);
+                        sum[0] += KERNEL.weights[k][l] * pixel.red;
+                        sum[1] += KERNEL.weights[k][l] * pixel.green;
+                        sum[2] += KERNEL.weights[k][l] * pixel.blue;
+                    }
+                }
+                auto channel = [](int value) {
+                    return static_cast<uint8_t>(std::clamp(static_cast<int>(std::round(value / 16.0)), 0, 255));
+                };
+                REQUIRE(convolved(i, j) == PixelArray::Pixel{channel(sum[0]), channel(sum[1]), channel(sum[2])});
+            }
+        }
+    }
+
+    // Размытие: горизонтальный проход, затем вертикальный, каждый с округлением
+    std::vector<double> kernel = GaussianBlurFilter::MakeKernel(1);
+    int64_t radius = static_cast<int64_t>(kernel.size() / 2);
+    for (BorderMode mode : modes) {
+        Bitmap blurred;
+        blurred.GetPixels() = pixels;
+        GaussianBlurFilter(1, mode).Apply(blurred);
+        PixelArray horizontal(19, 13);
+        auto convolve = [&kernel, radius](auto&& get, int64_t i, int64_t j, bool vertical) {
+            double sum[3] = {0, 0, 0};
+            for (int64_t k = -radius; k <= radius; ++k) {
+                PixelArray::Pixel pixel = vertical ? get(i + k, j) : get(i, j + k);
+                sum[0] += kernel[k + radius] * pixel.red;
+                sum[1] += kernel[k + radius] * pixel.green;
+                sum[2] += kernel[k + radius] * pixel.blue;
+            }
+            auto channel = [](double value) {
+                return static_cast<uint8_t>(std::clamp(static_cast<int>(std::round(value)), 0, 255));
+            };
+            return PixelArray::Pixel{channel(sum[0]), channel(sum[1]), channel(sum[2])};
+        };
+        for (int64_t i = 0; i < 19; ++i) {
+            for (int64_t j = 0; j < 13; ++j) {
+                horizontal(i, j) = convolve([&](int64_t row, int64_t column) { return at(row, column, mode); },
+                                            i, j, false);
+            }
+        }
+        auto horizontal_at = [&](int64_t row, int64_t column) {
+            int64_t source = Border::Resolve(row, 19, mode);
+            return source < 0 ? PixelArray::Pixel{0, 0, 0} : horizontal(source, column);
+        };
+        for (int64_t i = 0; i < 19; ++i) {
+            for (int64_t j = 0; j < 13; ++j) {
+                REQUIRE(blurred.GetPixels()(i, j) == convolve(horizontal_at, i, j, true));
+            }
+        }
+    }
+
+    // Чёрное поле затемняет края нерезкой маски меньше, чем размытия, но середина от полей не зависит
+    Bitmap flat;
+    flat.GetPixels() = PixelArray(20, 20, PixelArray::Pixel{100, 100, 100});
+    Bitmap flat_blurred = flat;
+    GaussianBlurFilter(1, BorderMode::CONSTANT).Apply(flat_blurred);
+    UnsharpMaskFilter(1, 1, 0, BorderMode::CONSTANT).Apply(flat);
+    REQUIRE(flat_blurred.GetPixels()(0, 0).red < 100);
+    REQUIRE(flat.GetPixels()(0, 0).red > 100);
+    REQUIRE(flat.GetPixels()(10, 10).red == 100);
+    REQUIRE(flat_blurred.GetPixels()(10, 10).red == 100);
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkFixedKernel", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(2160, 3840, 5);
+    auto measure = [&source](BaseFilter&& filter, const std::string& name) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        filter.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(SharpeningFilter(), "sharp");
+    measure(EdgeDetectionFilter(0.1), "edge 0.1");
+}
+
+TEST_CASE("TestIntegralImage") {
+    PixelArray pixels = MakeNoise(53, 19, 17);
+    auto naive_sum = [&pixels](const Region& region, size_t channel, bool square) {
+        uint64_t sum = 0;
+        for (size_t i = region.row; i < region.row + region.height; ++i) {
+            for (size_t j = region.column; j < region.column + region.width; ++j) {
+                const PixelArray::Pixel& pixel = pixels(i, j);
+                uint64_t value = channel == 0 ? pixel.red : (channel == 1 ? pixel.green : pixel.blue);
+                sum += square ? value * value : value;
+            }
+        }
+        return sum;
+    };
+    std::vector<Region> regions = {{0, 0, 53, 19}, {0, 0, 0, 0}, {5, 7, 1, 1}, {10, 3, 30, 16}, {52, 18, 1, 1}};
+    for (size_t thread_num : {1, 4}) {
+        Parallel::SetThreadNum(thread_num);
+        for (bool square : {false, true}) {
+            IntegralImage<uint32_t> sums32(pixels, square);
+            IntegralImage<uint64_t> sums64(pixels, square);
+            for (const Region& region : regions) {
+                for (size_t channel = 0; channel < IntegralImage<uint32_t>::PIXEL_CHANNELS; ++channel) {
+                    REQUIRE(sums32.GetSum(region, channel) == naive_sum(region, channel, square));
+                    REQUIRE(sums64.GetSum(region, channel) == naive_sum(region, channel, square));
+                }
+            }
+        }
+    }
+    Parallel::SetThreadNum(0);
+
+    // Суммы всей таблицы переполняют 32 бита, но сумма небольшого окна остаётся верной
+    size_t height = 300;
+    size_t width = 300;
+    std::vector<uint8_t> values(height * width, 255);
+    IntegralImage<uint32_t> overflowed(values, height, width, true);
+    REQUIRE_FALSE(IntegralImageMath::Fits<uint32_t>(height * width, 255 * 255));
+    REQUIRE(IntegralImageMath::Fits<uint32_t>(100 * 100, 255 * 255));
+    REQUIRE(overflowed.GetSum({200, 200, 100, 100}) == 100 * 100 * 255 * 255);
+}
+
+TEST_CASE("TestAdaptiveThresholdFilter") {
+    Bitmap noise;
+    noise.GetPixels() = MakeNoise(31, 45, 19);
+    int64_t height = 31;
+    int64_t width = 45;
+    for (size_t window : {1, 3, 7, 21}) {
+        for (double c : {0.0, 5.5}) {
+            Bitmap filtered = noise;
+            AdaptiveThresholdFilter(window, c).Apply(filtered);
+            int64_t radius = static_cast<int64_t>(window / 2);
+            for (int64_t i = 0; i < height; ++i) {
+                for (int64_t j = 0; j < width; ++j) {
+                    double sum = 0;
+                    for (int64_t k = i - radius; k <= i + radius; ++k) {
+                        for (int64_t l = j - radius; l <= j + radius; ++l) {
+                            PixelArray::Pixel pixel = noise.GetPixels()(std::clamp<int64_t>(k, 0, height - 1),
+                                                                        std::clamp<int64_t>(l, 0, width - 1));
+                            sum += std::round(0.299 * pixel.red + 0.587 * pixel.green + 0.114 * pixel.blue);
+                        }
+                    }
+                    const PixelArray::Pixel& pixel = noise.GetPixels()(i, j);
+                    double brightness = std::round(0.299 * pixel.red + 0.587 * pixel.green + 0.114 * pixel.blue);
+                    uint8_t expected = brightness > sum / static_cast<double>(window * window) - c ? 255 : 0;
+                    REQUIRE(filtered.GetPixels()(i, j) == PixelArray::Pixel{expected, expected, expected});
+                }
+            }
+        }
+    }
+
+    FilterPipeline fp;
+    fp.AddFilter(new AdaptiveThresholdFilter(15, 3), "adaptive_threshold 15 3");
+    Bitmap expected;
+    REQUIRE(expected.Load("../examples/town.bmp"));
+    fp.Apply(expected);
+    std::ifstream input("../examples/town.bmp", std::ios_base::in | std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(input));
+    std::stringstream output;
+    REQUIRE(fp.ApplyStreaming(reader, output));
+    Bitmap streamed;
+    REQUIRE(streamed.Load(output));
+    for (size_t i = 0; i < expected.GetPixels().GetHeight(); ++i) {
+        for (size_t j = 0; j < expected.GetPixels().GetWidth(); ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == streamed.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeAdaptiveThresholdFilter({"adaptive_threshold", {"4", "2"}}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeAdaptiveThresholdFilter({"adaptive_threshold", {"5"}}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeAdaptiveThresholdFilter({"adaptive_threshold", {"999999999", "2"}}),
+                      std::invalid_argument);
+    delete FilterFactories::MakeAdaptiveThresholdFilter({"adaptive_threshold", {"5", "2"}});
+    delete FilterFactories::MakeAdaptiveThresholdFilter({"adaptive_threshold", {"1023", "2"}});
+}
+
+TEST_CASE("TestEqualizeFilter") {
+    // Две яркости растягиваются до 0 и 255
+    Bitmap two_levels;
+    two_levels.GetPixels() = PixelArray(6, 8);
+    for (size_t i = 0; i < 6; ++i) {
+        for (size_t j = 0; j < 8; ++j) {
+            uint8_t value = j < 3 ? 100 : 110;
+            two_levels.GetPixels()(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    EqualizeFilter().Apply(two_levels);
+    for (size_t i = 0; i < 6; ++i) {
+        for (size_t j = 0; j < 8; ++j) {
+            uint8_t value = j < 3 ? 0 : 255;
+            REQUIRE(two_levels.GetPixels()(i, j) == PixelArray::Pixel{value, value, value});
+        }
+    }
+
+    // Каналы цветного пикселя сдвигаются вместе с яркостью
+    Bitmap colored;
+    colored.GetPixels() = PixelArray(1, 2);
+    colored.GetPixels()(0, 0) = PixelArray::Pixel{60, 70, 80};
+    colored.GetPixels()(0, 1) = PixelArray::Pixel{200, 100, 60};
+    EqualizeFilter().Apply(colored);
+    // Яркости 68 и 125 переходят в 0 и 255
+    REQUIRE(colored.GetPixels()(0, 0) == PixelArray::Pixel{0, 2, 12});
+    REQUIRE(colored.GetPixels()(0, 1) == PixelArray::Pixel{255, 230, 190});
+
+    // Постоянное изображение не меняется
+    Bitmap constant;
+    constant.GetPixels() = PixelArray(3, 3);
+    EqualizeFilter().Apply(constant);
+    REQUIRE(constant.GetPixels()(1, 1) == PixelArray::Pixel{0, 0, 0});
+}
+
+TEST_CASE("TestClaheFilter") {
+    Bitmap gray;
+    gray.GetPixels() = MakeNoise(67, 41, 23);
+    GrayscaleFilter().Apply(gray);
+    // Один прямоугольник без ограничения: яркость v переходит в долю пикселей не ярче v
+    std::array<size_t, 256> histogram{};
+    for (size_t i = 0; i < 67; ++i) {
+        for (size_t j = 0; j < 41; ++j) {
+            ++histogram[gray.GetPixels()(i, j).red];
+        }
+    }
+    std::array<uint8_t, 256> lut{};
+    size_t cumulative = 0;
+    for (size_t v = 0; v < 256; ++v) {
+        cumulative += histogram[v];
+        lut[v] = std::lround(static_cast<double>(cumulative) * 255 / (67 * 41));
+    }
+    Bitmap single = gray;
+    ClaheFilter(1, 1000).Apply(single);
+    for (size_t i = 0; i < 67; ++i) {
+        for (size_t j = 0; j < 41; ++j) {
+            uint8_t value = lut[gray.GetPixels()(i, j).red];
+            REQUIRE(single.GetPixels()(i, j) == PixelArray::Pixel{value, value, value});
+        }
+    }
+
+    // Чем сильнее ограничение, тем меньше меняется изображение
+    auto total_change = [&gray](double clip) {
+        Bitmap filtered = gray;
+        ClaheFilter(2, clip).Apply(filtered);
+        int64_t change = 0;
+        for (size_t i = 0; i < 67; ++i) {
+            for (size_t j = 0; j < 41; ++j) {
+                change += std::abs(filtered.GetPixels()(i, j).red - gray.GetPixels()(i, j).red);
+            }
+        }
+        return change;
+    };
+    REQUIRE(total_change(1) < total_change(2));
+    REQUIRE(total_change(2) < total_change(1000));
+
+    // Размеры не делятся на число прямоугольников: каждый прямоугольник переводит свою наибольшую яркость
+    // в 255, поэтому одноцветное изображение становится белым целиком
+    for (size_t size : {10, 11, 31}) {
+        Bitmap constant;
+        constant.GetPixels().Resize(size, size + 3, PixelArray::Pixel{77, 77, 77});
+        ClaheFilter(3, 1000).Apply(constant);
+        for (size_t i = 0; i < size; ++i) {
+            for (size_t j = 0; j < size + 3; ++j) {
+                REQUIRE(constant.GetPixels()(i, j) == PixelArray::Pixel{255, 255, 255});
+            }
+        }
+    }
+
+    // Результат не зависит от разбиения на полосы
+    Bitmap noise;
+    noise.GetPixels() = MakeNoise(101, 37, 29);
+    Parallel::SetThreadNum(1);
+    Bitmap expected = noise;
+    ClaheFilter(5, 2.5).Apply(expected);
+    Bitmap equalized = noise;
+    EqualizeFilter().Apply(equalized);
+    Parallel::SetThreadNum(4);
+    Bitmap banded = noise;
+    ClaheFilter(5, 2.5).Apply(banded);
+    Bitmap banded_equalized = noise;
+    EqualizeFilter().Apply(banded_equalized);
+    Parallel::SetThreadNum(0);
+    for (size_t i = 0; i < 101; ++i) {
+        for (size_t j = 0; j < 37; ++j) {
+            REQUIRE(expected.GetPixels()(i, j) == banded.GetPixels()(i, j));
+            REQUIRE(equalized.GetPixels()(i, j) == banded_equalized.GetPixels()(i, j));
+        }
+    }
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeClaheFilter({"clahe", {"0", "2"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeClaheFilter({"clahe", {"8", "0"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeEqualizeFilter({"equalize", {"8"}}), std::invalid_argument);
+    delete FilterFactories::MakeClaheFilter({"clahe", {"8", "2"}});
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkEqualizeFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(1080, 1920, 5);
+    auto measure = [&source](BaseFilter&& filter, const std::string& name) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        filter.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(GrayscaleFilter(), "gs");
+    measure(EqualizeFilter(), "equalize");
+    measure(ClaheFilter(8, 3), "clahe 8 3");
+}
+
+TEST_CASE("TestRotateFilter") {
+    // Поворот на 90 градусов против часовой стрелки: правый верхний угол переходит в левый верхний
+    Bitmap square;
+    square.GetPixels() = MakeNoise(23, 23, 31);
+    Bitmap rotated = square;
+    RotateFilter(90, AffineFilter::Interpolation::BILINEAR).Apply(rotated);
+    REQUIRE(rotated.GetPixels()(22, 0) == square.GetPixels()(22, 22));
+    // Тот же поворот общим путём: x' = y, y' = 23 - x
+    for (auto interpolation : {AffineFilter::Interpolation::NEAREST, AffineFilter::Interpolation::BILINEAR,
+                               AffineFilter::Interpolation::BICUBIC}) {
+        Bitmap warped = square;
+        AffineFilter({0, 1, 0, -1, 0, 23}, interpolation).Apply(warped);
+        for (size_t i = 0; i < 23; ++i) {
+            for (size_t j = 0; j < 23; ++j) {
+                REQUIRE(warped.GetPixels()(i, j) == rotated.GetPixels()(i, j));
+            }
+        }
+    }
+
+    // Повороты на кратные 90 градусам углы прямоугольного изображения
+    Bitmap image;
+    image.GetPixels() = MakeNoise(70, 45, 37);
+    const PixelArray& pixels = image.GetPixels();
+    for (double degrees : {0.0, 90.0, 180.0, 270.0, -90.0, 450.0}) {
+        Bitmap result = image;
+        RotateFilter filter(degrees, AffineFilter::Interpolation::NEAREST);
+        REQUIRE(filter.GetOutputSize(45, 70) ==
+                (static_cast<int>(degrees) % 180 == 0 ? BaseFilter::Size{45, 70} : BaseFilter::Size{70, 45}));
+        filter.Apply(result);
+        const PixelArray& rotated_pixels = result.GetPixels();
+        for (size_t i = 0; i < 70; ++i) {
+            for (size_t j = 0; j < 45; ++j) {
+                int turns = (static_cast<int>(degrees) / 90 % 4 + 4) % 4;
+                const PixelArray::Pixel& expected = pixels(i, j);
+                if (turns == 0) {
+                    REQUIRE(rotated_pixels(i, j) == expected);
+                } else if (turns == 1) {
+                    REQUIRE(rotated_pixels(j, 69 - i) == expected);
+                } else if (turns == 2) {
+                    REQUIRE(rotated_pixels(69 - i, 44 - j) == expected);
+                } else {
+                    REQUIRE(rotated_pixels(44 - j, i) == expected);
+                }
+            }
+        }
+    }
+
+    // Тождественное преобразование и сдвиг на целое число пикселей не меняют значений
+    for (auto interpolation : {AffineFilter::Interpolation::NEAREST, AffineFilter::Interpolation::BILINEAR,
+                               AffineFilter::Interpolation::BICUBIC}) {
+        Bitmap shifted = image;
+        // Вправо на 3 и вверх на 2 пикселя
+        AffineFilter({1, 0, 3, 0, 1, -2}, interpolation).Apply(shifted);
+        for (size_t i = 0; i < 70; ++i) {
+            for (size_t j = 0; j < 45; ++j) {
+                bool covered = j >= 3 && i >= 2;
+                REQUIRE(shifted.GetPixels()(i, j) ==
+                        (covered ? pixels(i - 2, j - 3) : PixelArray::Pixel{0, 0, 0}));
+            }
+        }
+    }
+
+    // Поворот на 45 градусов: размер описанного прямоугольника, центр остаётся на месте, углы чёрные
+    Bitmap flat;
+    flat.GetPixels() = PixelArray(100, 100, PixelArray::Pixel{200, 100, 50});
+    RotateFilter diagonal(45, AffineFilter::Interpolation::BICUBIC);
+    REQUIRE(diagonal.GetOutputSize(100, 100) == BaseFilter::Size{141, 141});
+    diagonal.Apply(flat);
+    REQUIRE(flat.GetPixels().GetWidth() == 141);
+    REQUIRE(flat.GetPixels()(70, 70) == PixelArray::Pixel{200, 100, 50});
+    REQUIRE(flat.GetPixels()(0, 0) == PixelArray::Pixel{0, 0, 0});
+    REQUIRE(flat.GetPixels()(140, 140) == PixelArray::Pixel{0, 0, 0});
+
+    // Размеры после поворота известны планировщику цепочки
+    CmdLineParser::FilterDescriptorVector fdv = {{"rotate", {"90"}}, {"crop", {"50", "60"}}};
+    REQUIRE(PipelineOptimizer::ComputeSizes(fdv, 300, 200)[1] == std::make_pair<size_t, size_t>(200, 300));
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeRotateFilter({"rotate", {"30", "linear"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeAffineFilter({"affine", {"1", "2", "0", "2", "4", "0"}}),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeAffineFilter({"affine", {"1", "0", "0", "0", "1"}}),
+                      std::invalid_argument);
+    delete FilterFactories::MakeRotateFilter({"rotate", {"-30", "bicubic"}});
+    delete FilterFactories::MakeAffineFilter({"affine", {"1", "0.2", "-5", "0", "1", "0", "nearest"}});
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkRotateFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(1080, 1920, 9);
+    auto measure = [&source](BaseFilter&& filter, const std::string& name) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        filter.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(RotateFilter(90, AffineFilter::Interpolation::BILINEAR), "rotate 90");
+    measure(RotateFilter(30, AffineFilter::Interpolation::NEAREST), "rotate 30 nearest");
+    measure(RotateFilter(30, AffineFilter::Interpolation::BILINEAR), "rotate 30 bilinear");
+    measure(RotateFilter(30, AffineFilter::Interpolation::BICUBIC), "rotate 30 bicubic");
+}
+
+TEST_CASE("TestTransposeFilter") {
+    Bitmap image;
+    image.GetPixels() = MakeNoise(70, 45, 41);
+    const PixelArray& pixels = image.GetPixels();
+    // Размеры не кратны блоку транспонирования
+    PixelArray transposed = PixelMath::Transpose(MakeNoise(70, 45, 41));
+    REQUIRE(transposed.GetHeight() == 45);
+    REQUIRE(transposed.GetWidth() == 70);
+
+    Bitmap mirrored = image;
+    TransposeFilter().Apply(mirrored);
+    REQUIRE(TransposeFilter().GetOutputSize(45, 70) == BaseFilter::Size{70, 45});
+    Bitmap flipped_h = image;
+    FlipFilter(true).Apply(flipped_h);
+    Bitmap flipped_v = image;
+    FlipFilter(false).Apply(flipped_v);
+    for (size_t i = 0; i < 70; ++i) {
+        for (size_t j = 0; j < 45; ++j) {
+            REQUIRE(transposed(j, i) == pixels(i, j));
+            // Левый верхний угол остаётся на месте, строки сверху становятся столбцами слева
+            REQUIRE(mirrored.GetPixels()(44 - j, 69 - i) == pixels(i, j));
+            REQUIRE(flipped_h.GetPixels()(i, 44 - j) == pixels(i, j));
+            REQUIRE(flipped_v.GetPixels()(69 - i, j) == pixels(i, j));
+        }
+    }
+
+    // -rot90 совпадает с -rotate 90
+    std::unique_ptr<BaseFilter> rot90(FilterFactories::MakeRot90Filter({"rot90", {}}));
+    Bitmap quarter = image;
+    rot90->Apply(quarter);
+    Bitmap rotated = image;
+    RotateFilter(90, AffineFilter::Interpolation::BILINEAR).Apply(rotated);
+    REQUIRE(quarter.GetPixels().GetWidth() == 70);
+    for (size_t i = 0; i < 45; ++i) {
+        for (size_t j = 0; j < 70; ++j) {
+            REQUIRE(quarter.GetPixels()(i, j) == rotated.GetPixels()(i, j));
+        }
+    }
+
+    CmdLineParser::FilterDescriptorVector fdv = {{"transpose", {}}, {"flip", {"v"}}, {"rot90", {}}};
+    PipelineOptimizer::SizeVector sizes = PipelineOptimizer::ComputeSizes(fdv, 300, 200);
+    REQUIRE(sizes[1] == std::make_pair<size_t, size_t>(200, 300));
+    REQUIRE(sizes[2] == std::make_pair<size_t, size_t>(200, 300));
+    REQUIRE(sizes[3] == std::make_pair<size_t, size_t>(300, 200));
+
+    REQUIRE_THROWS_AS(FilterFactories::MakeFlipFilter({"flip", {"x"}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeFlipFilter({"flip", {}}), std::invalid_argument);
+    REQUIRE_THROWS_AS(FilterFactories::MakeTransposeFilter({"transpose", {"1"}}), std::invalid_argument);
+}
+
+// Запуск: image_processor_test [benchmark]
+TEST_CASE("BenchmarkTransposeFilter", "[.benchmark]") {
+    Bitmap source;
+    source.GetPixels() = MakeNoise(2160, 3840, 13);
+    auto measure = [&source](BaseFilter&& filter, const std::string& name) {
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        filter.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(TransposeFilter(), "transpose");
+    measure(FlipFilter(true), "flip h");
+    measure(FlipFilter(false), "flip v");
+    measure(GaussianBlurFilter(2), "blur 2");
+    measure(LanczosScaleFilter(1920, 1080), "scale 1920 1080");
+}
+
+TEST_CASE("TestPreciseMode") {
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("crop", &FilterFactories::MakeCropFilter);
+    fpf.AddFilterMaker("neg", &FilterFactories::MakeNegativeFilter);
+    fpf.AddFilterMaker("gs", &FilterFactories::MakeGrayscaleFilter);
+    fpf.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
+    fpf.AddFilterMaker("edge", &FilterFactories::MakeEdgeDetectionFilter);
+    fpf.AddFilterMaker("median", &FilterFactories::MakeMedianFilter);
+    fpf.AddFilterMaker("canny", &FilterFactories::MakeCannyFilter);
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    auto apply = [&fpf](Bitmap image, const CmdLineParser::FilterDescriptorVector& fdv, bool precise,
+                        bool region_propagation = true) {
+        FilterPipeline fp;
+        REQUIRE(fpf.CreateFilterPipeline(fp, fdv));
+        fp.EnablePrecise(precise);
+        fp.EnableRegionPropagation(region_propagation);
+        fp.Apply(image);
+        return image.GetPixels();
+    };
+    auto max_difference = [](const PixelArray& a, const PixelArray& b) {
+        REQUIRE(a.GetWidth() == b.GetWidth());
+        REQUIRE(a.GetHeight() == b.GetHeight());
+        int result = 0;
+        for (size_t i = 0; i < a.GetHeight(); ++i) {
+            for (size_t j = 0; j < a.GetWidth(); ++j) {
+                result = std::max({result, std::abs(a(i, j).red - b(i, j).red),
+                                   std::abs(a(i, j).green - b(i, j).green), std::abs(a(i, j).blue - b(i, j).blue)});
+            }
+        }
+        return result;
+    };
+
+    // Без свёрток float-режим отличается от 8-битного только округлением яркости
+    CmdLineParser::FilterDescriptorVector exact = {{"neg", {}}, {"crop", {"120", "90"}}, {"neg", {}}};
+    REQUIRE(max_difference(apply(source, exact, true), apply(source, exact, false)) == 0);
+    CmdLineParser::FilterDescriptorVector gray = {{"gs", {}}, {"neg", {}}, {"crop", {"120", "90"}}};
+    REQUIRE(max_difference(apply(source, gray, true), apply(source, gray, false)) <= 1);
+
+    // float-версия есть только у фильтров, которые объявили её сами
+    REQUIRE(GrayscaleFilter().SupportsPrecise());
+    REQUIRE(EdgeDetectionFilter(0.1).SupportsPrecise());
+    REQUIRE_FALSE(BilateralFilter(4, 20).SupportsPrecise());
+    REQUIRE_FALSE(CannyFilter(0.1, 0.3, 1).SupportsPrecise());
+    REQUIRE_FALSE(AdaptiveThresholdFilter(15, 5).SupportsPrecise());
+    REQUIRE_FALSE(MedianFilter(1).SupportsPrecise());
+
+    // Распространение областей и фильтры без float-версии внутри цепочки не меняют результат
+    const std::vector<CmdLineParser::FilterDescriptorVector> pipelines = {
+        {{"sharp", {}}, {"blur", {"1.5"}}, {"crop", {"60", "40"}}},
+        {{"blur", {"1", "reflect"}}, {"median", {"1"}}, {"sharp", {"constant"}}, {"crop", {"50", "70"}}},
+        {{"edge", {"0.1"}}, {"canny", {"0.1", "0.3", "1"}}, {"blur", {"1"}}, {"crop", {"30", "30"}}},
+    };
+    for (const CmdLineParser::FilterDescriptorVector& fdv : pipelines) {
+        REQUIRE(max_difference(apply(source, fdv, true), apply(source, fdv, true, false)) == 0);
+    }
+
+    // Точный результат цепочки размытий и повышений резкости на канале green, края -- повторение крайних пикселей
+    Bitmap small = source;
+    BaseFilter::CutRegion(small.GetPixels(), Region{0, 0, 100, 160});
+    const PixelArray& small_pixels = small.GetPixels();
+    int64_t height = static_cast<int64_t>(small_pixels.GetHeight());
+    int64_t width = static_cast<int64_t>(small_pixels.GetWidth());
+    std::vector<std::vector<double>> reference(height, std::vector<double>(width));
+    for (int64_t i = 0; i < height; ++i) {
+        for (int64_t j = 0; j < width; ++j) {
+            reference[i][j] = small_pixels(i, j).green;
+        }
+    }
+    auto at = [&](const std::vector<std::vector<double>>& plane, int64_t i, int64_t j) {
+        return plane[std::clamp<int64_t>(i, 0, height - 1)][std::clamp<int64_t>(j, 0, width - 1)];
+    };
+    const std::vector<double> blur_kernel = GaussianBlurFilter::MakeKernel(1);
+    const int64_t radius = static_cast<int64_t>(blur_kernel.size() / 2);
+    auto reference_blur = [&]() {
+        std::vector<std::vector<double>> horizontal = reference;
+        for (int64_t i = 0; i < height; ++i) {
+            for (int64_t j = 0; j < width; ++j) {
+                horizontal[i][j] = 0;
+                for (int64_t k = -radius; k <= radius; ++k) {
+                    horizontal[i][j] += blur_kernel[k + radius] * at(reference, i, j + k);
+                }
+            }
+        }
+        for (int64_t i = 0; i < height; ++i) {
+            for (int64_t j = 0; j < width; ++j) {
+                reference[i][j] = 0;
+                for (int64_t k = -radius; k <= radius; ++k) {
+                    reference[i][j] += blur_kernel[k + radius] * at(horizontal, i + k, j);
+                }
+            }
+        }
+    };
+    auto reference_sharp = [&]() {
+        std::vector<std::vector<double>> result = reference;
+        for (int64_t i = 0; i < height; ++i) {
+            for (int64_t j = 0; j < width; ++j) {
+                result[i][j] = 5 * at(reference, i, j) - at(reference, i - 1, j) - at(reference, i + 1, j) -
+                               at(reference, i, j - 1) - at(reference, i, j + 1);
+            }
+        }
+        reference = std::move(result);
+    };
+    CmdLineParser::FilterDescriptorVector chain = {{"blur", {"1"}}, {"sharp", {}}, {"blur", {"1"}}, {"sharp", {}}};
+    reference_blur();
+    reference_sharp();
+    reference_blur();
+    reference_sharp();
+    auto reference_error = [&](const PixelArray& pixels) {
+        double error = 0;
+        for (int64_t i = 0; i < height; ++i) {
+            for (int64_t j = 0; j < width; ++j) {
+                double expected = std::clamp(std::round(reference[i][j]), 0.0, 255.0);
+                error += std::abs(expected - pixels(i, j).green);
+            }
+        }
+        return error / static_cast<double>(height * width);
+    };
+    double precise_error = reference_error(apply(small, chain, true));
+    double error = reference_error(apply(small, chain, false));
+    REQUIRE(precise_error < 0.1);
+    REQUIRE(precise_error < error);
+}
+
+TEST_CASE("BenchmarkPreciseMode", "[.benchmark]") {
+    FilterPipelineFactory fpf;
+    fpf.AddFilterMaker("blur", &FilterFactories::MakeGaussianBlurFilter);
+    fpf.AddFilterMaker("sharp", &FilterFactories::MakeSharpeningFilter);
+    Bitmap source;
+    source.GetPixels() = MakeNoise(2160, 3840, 17);
+    auto measure = [&](bool precise, const std::string& name) {
+        FilterPipeline fp;
+        REQUIRE(fpf.CreateFilterPipeline(fp, {{"blur", {"2"}}, {"sharp", {}}, {"blur", {"2"}}, {"sharp", {}}}));
+        fp.EnablePrecise(precise);
+        Bitmap filtered = source;
+        auto start = std::chrono::steady_clock::now();
+        fp.Apply(filtered);
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    measure(false, "blur sharp blur sharp, 8 bit");
+    measure(true, "blur sharp blur sharp, float");
+}
+
+TEST_CASE("TestAlphaChannel") {
+    Bitmap source;
+    REQUIRE(source.Load("../examples/town.bmp"));
+    REQUIRE(source.GetAlpha() == nullptr);
+    BaseFilter::CutRegion(source.GetPixels(), Region{0, 0, 30, 41});
+    PixelArray alpha(30, 41);
+    for (size_t i = 0; i < alpha.GetHeight(); ++i) {
+        for (size_t j = 0; j < alpha.GetWidth(); ++j) {
+            uint8_t value = (i * 37 + j * 11) % 256;
+            alpha(i, j) = PixelArray::Pixel{value, value, value};
+        }
+    }
+    source.SetAlpha(alpha);
+
+    // Запись и чтение 32-битного файла
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "image_processor_alpha_test.bmp";
+    REQUIRE(source.CreateFile(path.c_str()));
+    REQUIRE(std::filesystem::file_size(path) == 54 + 30 * 41 * 4);
+    Bitmap loaded;
+    REQUIRE(loaded.Load(path.c_str()));
+    REQUIRE(loaded.GetAlpha() != nullptr);
+    for (size_t i = 0; i < alpha.GetHeight(); ++i) {
+        for (size_t j = 0; j < alpha.GetWidth(); ++j) {
+            REQUIRE(loaded.GetPixels()(i, j) == source.GetPixels()(i, j));
+            REQUIRE((*loaded.GetAlpha())(i, j) == alpha(i, j));
+        }
+    }
+    // Нулевой четвёртый байт во всём файле означает, что альфы нет
+    Bitmap opaque = source;
+    opaque.SetAlpha(PixelArray(30, 41));
+    REQUIRE(opaque.CreateFile(path.c_str()));
+    REQUIRE(loaded.Load(path.c_str()));
+    REQUIRE(loaded.GetAlpha() == nullptr);
+    std::filesystem::remove(path);
+
+    // Цвет прозрачных пикселей не подмешивается при размытии и масштабировании
+    Bitmap halves = source.CopyWithPixels(PixelArray(20, 20, PixelArray::Pixel{0, 0, 0}));
+    PixelArray halves_alpha(20, 20, PixelArray::Pixel{255, 255, 255});
+    for (size_t i = 0; i < 20; ++i) {
+        for (size_t j = 0; j < 10; ++j) {
+            halves.GetPixels()(i, j) = PixelArray::Pixel{255, 255, 255};
+            halves_alpha(i, j) = PixelArray::Pixel{0, 0, 0};
+        }
+    }
+    halves.SetAlpha(halves_alpha);
+    FilterPipeline fp;
+    fp.AddFilter(new GaussianBlurFilter(2), "blur 2");
+    fp.AddFilter(new LanczosScaleFilter(15, 17), "scale 15 17");
+    fp.Apply(halves);
+    REQUIRE(halves.GetAlpha() != nullptr);
+    REQUIRE(halves.GetAlpha()->GetWidth() == 15);
+    REQUIRE(halves.GetAlpha()->GetHeight() == 17);
+    size_t translucent = 0;
+    for (size_t i = 0; i < 17; ++i) {
+        for (size_t j = 0; j < 15; ++j) {
+            uint8_t a = (*halves.GetAlpha())(i, j).red;
+            translucent += a > 0 && a < 255;
+            if (a > 0) {
+                REQUIRE(halves.GetPixels()(i, j) == PixelArray::Pixel{0, 0, 0});
+            }
+        }
+    }
+    REQUIRE(translucent > 0);
+
+    // Поточечные фильтры меняют исходные цвета и не трогают альфу
+    Bitmap negative = source;
+    fp.Clear();
+    fp.AddFilter(new NegativeFilter, "neg");
+    fp.AddFilter(new CropFilter(20, 10), "crop 20 10");
+    fp.Apply(negative);
+    REQUIRE(negative.GetAlpha()->GetWidth() == 20);
+    for (size_t i = 0; i < 10; ++i) {
+        for (size_t j = 0; j < 20; ++j) {
+            REQUIRE(negative.GetPixels()(i, j).green == 255 - source.GetPixels()(i + 20, j).green);
+            REQUIRE((*negative.GetAlpha())(i, j) == alpha(i + 20, j));
+        }
+    }
+
+    // Распространение областей обрезает альфу так же, как цвета
+    auto apply = [&source](bool region_propagation) {
+        Bitmap image = source;
+        FilterPipeline pipeline;
+        pipeline.AddFilter(new EdgeDetectionFilter(0.1), "edge 0.1");
+        pipeline.AddFilter(new GaussianBlurFilter(1), "blur 1");
+        pipeline.AddFilter(new FlipFilter(true), "flip h");
+        pipeline.AddFilter(new CropFilter(25, 12), "crop 25 12");
+        pipeline.EnableRegionPropagation(region_propagation);
+        pipeline.Apply(image);
+        return image;
+    };
+    Bitmap expected = apply(false);
+    Bitmap actual = apply(true);
+    REQUIRE(actual.GetAlpha()->GetWidth() == 25);
+    REQUIRE(actual.GetAlpha()->GetHeight() == 12);
+    for (size_t i = 0; i < 12; ++i) {
+        for (size_t j = 0; j < 25; ++j) {
+            REQUIRE(actual.GetPixels()(i, j) == expected.GetPixels()(i, j));
+            REQUIRE((*actual.GetAlpha())(i, j) == (*expected.GetAlpha())(i, j));
+        }
+    }
+}
+
+namespace {
+    // Файл bmp с заголовком BITMAPINFOHEADER, палитрой palette (по 4 байта на цвет) и пикселями data,
+    // записанными как есть
+    std::string MakeBmp(uint16_t bits_per_pixel, uint32_t compression, int32_t width, int32_t height,
+                                  const std::vector<uint8_t>& palette, const std::vector<uint8_t>& data) {
+        Bitmap::BMPHeader bmp_header{};
+        Bitmap::DIBHeader dib_header{};
+        bmp_header.signature = 0x4D42;
+        bmp_header.bitarray_offset = sizeof(bmp_header) + sizeof(dib_header) + palette.size();
+        bmp_header.file_size = bmp_header.bitarray_offset + data.size();
+        dib_header.dib_header_size = sizeof(dib_header);
+        dib_header.width = width;
+        dib_header.height = height;
+        dib_header.planes = 1;
+        dib_header.bits_per_pixel = bits_per_pixel;
+        dib_header.compression = compression;
+        dib_header.raw_bitmap_data_size = data.size();
+        dib_header.colors_used = palette.size() / 4;
+        std::string file(reinterpret_cast<const char*>(&bmp_header), sizeof(bmp_header));
+        file.append(reinterpret_cast<const char*>(&dib_header), sizeof(dib_header));
+        file.append(palette.begin(), palette.end());
+        file.append(data.begin(), data.end());
+        return file;
+    }
+
+    // Индексы палитры из четырёх цветов, в которой цвет i -- {10 * i, 20 * i, 30 * i}
+    void CheckIndices(Bitmap& bmp, const std::vector<std::vector<uint8_t>>& indices) {
+        const PixelArray& pixels = bmp.GetPixels();
+        REQUIRE(pixels.GetHeight() == indices.size());
+        REQUIRE(pixels.GetWidth() == indices[0].size());
+        for (size_t i = 0; i < indices.size(); ++i) {
+            for (size_t j = 0; j < indices[i].size(); ++j) {
+                uint8_t index = indices[i][j];
+                REQUIRE(pixels(i, j) == PixelArray::Pixel{static_cast<uint8_t>(10 * index),
+                                                          static_cast<uint8_t>(20 * index),
+                                                          static_cast<uint8_t>(30 * index)});
+            }
+        }
+    }
+}
+
+TEST_CASE("TestPalettizedBitmap") {
+    const std::vector<uint8_t> palette = {0, 0, 0, 0, 10, 20, 30, 0, 20, 40, 60, 0, 30, 60, 90, 0};
+    Bitmap bmp;
+    auto load = [&bmp](const std::string& file) {
+        std::istringstream stream(file);
+        return bmp.Load(stream);
+    };
+
+    // 8 бит, строки по 5 байт дополнены до 8
+    REQUIRE(load(MakeBmp(8, Bitmap::BI_RGB, 5, 2, palette,
+                                   {0, 1, 2, 3, 1, 9, 9, 9, 3, 3, 2, 2, 1, 9, 9, 9})));
+    CheckIndices(bmp, {{0, 1, 2, 3, 1}, {3, 3, 2, 2, 1}});
+    REQUIRE(bmp.GetAlpha() == nullptr);
+    // Индексы за пределами палитры дают чёрный цвет
+    REQUIRE(load(MakeBmp(8, Bitmap::BI_RGB, 1, 1, palette, {200, 0, 0, 0})));
+    CheckIndices(bmp, {{0}});
+    // Палитра больше, чем позволяет число бит, и обрезанные данные
+    REQUIRE_FALSE(load(MakeBmp(1, Bitmap::BI_RGB, 1, 1, palette, {0, 0, 0, 0})));
+    REQUIRE_FALSE(load(MakeBmp(8, Bitmap::BI_RGB, 5, 2, palette, {0, 1, 2, 3, 1, 9, 9, 9})));
+
+    // 4 бита, старшая половина байта -- левый пиксель
+    REQUIRE(load(MakeBmp(4, Bitmap::BI_RGB, 5, 2, palette, {0x01, 0x23, 0x10, 0, 0x33, 0x22, 0x10, 0})));
+    CheckIndices(bmp, {{0, 1, 2, 3, 1}, {3, 3, 2, 2, 1}});
+
+    // 1 бит
+    REQUIRE(load(MakeBmp(1, Bitmap::BI_RGB, 10, 1, {0, 0, 0, 0, 10, 20, 30, 0}, {0b10110000, 0b01000000,
+                                                                                           0, 0})));
+    CheckIndices(bmp, {{1, 0, 1, 1, 0, 0, 0, 0, 0, 1}});
+
+    // RLE8: повторение, неупакованный участок с выравниванием, смещение из начала второй строки в третий
+    // столбец третьей и конец изображения
+    REQUIRE(load(MakeBmp(8, Bitmap::BI_RLE8, 6, 4, palette,
+                                   {3, 2, 0, 3, 1, 3, 1, 0, 0, 0,
+                                    0, 2, 2, 1, 1, 3, 0, 0,
+                                    0, 1})));
+    CheckIndices(bmp, {{2, 2, 2, 1, 3, 1}, {0, 0, 0, 0, 0, 0}, {0, 0, 3, 0, 0, 0}, {0, 0, 0, 0, 0, 0}});
+
+    // RLE4: повторение чередует два индекса, неупакованный участок из 3 индексов занимает 2 байта
+    REQUIRE(load(MakeBmp(4, Bitmap::BI_RLE4, 5, 2, palette,
+                                   {5, 0x12, 0, 0,
+                                    0, 3, 0x32, 0x10, 2, 0x33, 0, 1})));
+    CheckIndices(bmp, {{1, 2, 1, 2, 1}, {3, 2, 1, 3, 3}});
+    // Поток RLE обрывается
+    REQUIRE_FALSE(load(MakeBmp(8, Bitmap::BI_RLE8, 6, 2, palette, {3, 2, 0, 0, 3})));
+
+    // Серое изображение по запросу записывается 8-битным и читается обратно без потерь, без запроса -- 24-битным
+    Bitmap gray;
+    REQUIRE(gray.Load("../examples/town.bmp"));
+    GrayscaleFilter().Apply(gray);
+    size_t width = gray.GetPixels().GetWidth();
+    size_t height = gray.GetPixels().GetHeight();
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    std::filesystem::path full_path = directory / "image_processor_gray_full_test.bmp";
+    REQUIRE(gray.CreateFile(full_path.c_str()));
+    REQUIRE(std::filesystem::file_size(full_path) == 54 + height * ((width * 3 + 3) / 4 * 4));
+    std::filesystem::path path = directory / "image_processor_gray_test.bmp";
+    REQUIRE(gray.CreateFile(path.c_str(), true));
+    REQUIRE(std::filesystem::file_size(path) == 54 + 1024 + height * ((width + 3) / 4 * 4));
+    // Потоковый режим пишет тот же 8-битный файл
+    std::ifstream full_input(full_path, std::ios_base::binary);
+    BitmapRowReader reader;
+    REQUIRE(reader.Open(full_input));
+    std::ostringstream streamed;
+    FilterPipeline empty;
+    REQUIRE(empty.ApplyStreaming(reader, streamed, true));
+    std::ifstream written(path, std::ios_base::binary);
+    REQUIRE(streamed.str() == std::string(std::istreambuf_iterator<char>(written), {}));
+    REQUIRE(bmp.Load(path.c_str()));
+    std::filesystem::remove(path);
+    std::filesystem::remove(full_path);
+    REQUIRE(bmp.GetPixels().GetWidth() == width);
+    REQUIRE(bmp.GetPixels().GetHeight() == height);
+    for (size_t i = 0; i < height; ++i) {
+        for (size_t j = 0; j < width; ++j) {
+            REQUIRE(bmp.GetPixels()(i, j) == gray.GetPixels()(i, j));
+        }
+    }
+}
+
+TEST_CASE("BenchmarkPalettizedBitmap", "[.benchmark]") {
+    Bitmap color;
+    color.GetPixels() = MakeNoise(2160, 3840, 19);
+    Bitmap gray = color;
+    GrayscaleFilter().Apply(gray);
+    std::filesystem::path directory = std::filesystem::temp_directory_path();
+    auto measure = [](const std::string& name, auto&& function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto finish = std::chrono::steady_clock::now();
+        std::cout << name << ": " << std::chrono::duration<double, std::milli>(finish - start).count() << " ms"
+                  << std::endl;
+    };
+    std::filesystem::path color_path = directory / "image_processor_color_benchmark.bmp";
+    std::filesystem::path gray_path = directory / "image_processor_gray_benchmark.bmp";
+    // Файлы удаляются перед каждой записью, чтобы не замерять освобождение страниц перезаписываемого файла
+    auto write = [](Bitmap& image, const std::filesystem::path& path, bool gray) {
+        std::filesystem::remove(path);
+        REQUIRE(image.CreateFile(path.c_str(), gray));
+    };
+    measure("write 24 bit", [&] { write(color, color_path, false); });
+    measure("write 24 bit gray", [&] { write(gray, color_path, false); });
+    measure("write 8 bit gray", [&] { write(gray, gray_path, true); });
+    Bitmap loaded;
+    measure("load 24 bit", [&] { REQUIRE(loaded.Load(color_path.c_str())); });
+    measure("load 8 bit gray", [&] { REQUIRE(loaded.Load(gray_path.c_str())); });
+    std::filesystem::remove(color_path);
+    std::filesystem::remove(gray_path);
+}
+
+TEST_CASE("TestBitmapHeaders") {
+    Bitmap bmp;
+    auto load = [&bmp](const std::string& file) {
+        std::istringstream stream(file);
+        return bmp.Load(stream);
+    };
+    // Строки 3 x 2 пикселей с выравниванием до 12 байт, нижняя строка первая
+    const std::vector<uint8_t> rows = {1, 2, 3, 4, 5, 6, 7, 8, 9, 0, 0, 0, 11, 12, 13, 14, 15, 16, 17, 18, 19, 0, 0, 0};
+    auto check = [&bmp]() {
+        const PixelArray& pixels = bmp.GetPixels();
+        REQUIRE(pixels.GetWidth() == 3);
+        REQUIRE(pixels.GetHeight() == 2);
+        REQUIRE(pixels(0, 0) == PixelArray::Pixel{1, 2, 3});
+        REQUIRE(pixels(0, 2) == PixelArray::Pixel{7, 8, 9});
+        REQUIRE(pixels(1, 1) == PixelArray::Pixel{14, 15, 16});
+    };
+    const std::string file = MakeBmp(24, Bitmap::BI_RGB, 3, 2, {}, rows);
+    REQUIRE(load(file));
+    check();
+
+    // Строки сверху вниз при отрицательной высоте
+    std::string top_down = MakeBmp(24, Bitmap::BI_RGB, 3, -2, {}, {rows.begin() + 12, rows.end()});
+    top_down.append(rows.begin(), rows.begin() + 12);
+    REQUIRE(load(top_down));
+    check();
+
+    // BITMAPV5HEADER: поля после первых 40 байт заголовка пропускаются
+    std::string v5 = file;
+    v5.insert(54, 84, '\0');
+    uint32_t v5_size = 124;
+    uint32_t v5_offset = 14 + 124;
+    v5.replace(14, 4, reinterpret_cast<const char*>(&v5_size), 4);
+    v5.replace(10, 4, reinterpret_cast<const char*>(&v5_offset), 4);
+    REQUIRE(load(v5));
+    check();
+
+    // BITMAPCOREHEADER с 16-битными размерами и трёхбайтными цветами палитры
+    std::string core = "BM";
+    core.append(12, '\0');
+    uint32_t core_offset = 14 + 12 + 2 * 3;
+    core.replace(10, 4, reinterpret_cast<const char*>(&core_offset), 4);
+    const uint16_t core_header[] = {12, 0, 2, 1, 1, 1};
+    core.append(reinterpret_cast<const char*>(core_header), sizeof(core_header));
+    core.append({'\x0A', '\x14', '\x1E', '\x00', '\x00', '\x00'});
+    core.append({'\x40', '\x00', '\x00', '\x00'});
+    REQUIRE(load(core));
+    REQUIRE(bmp.GetPixels().GetWidth() == 2);
+    REQUIRE(bmp.GetPixels()(0, 0) == PixelArray::Pixel{10, 20, 30});
+    REQUIRE(bmp.GetPixels()(0, 1) == PixelArray::Pixel{0, 0, 0});
+
+    // Ошибки в заголовках обнаруживаются до чтения и выделения памяти под пиксели
+    std::string wrong_signature = file;
+    wrong_signature[0] = 'X';
+    REQUIRE_FALSE(load(wrong_signature));
+    std::string wrong_header_size = file;
+    wrong_header_size[14] = 20;
+    REQUIRE_FALSE(load(wrong_header_size));
+    REQUIRE_FALSE(load(MakeBmp(24, Bitmap::BI_RGB, -3, 2, {}, rows)));
+    REQUIRE_FALSE(load(MakeBmp(24, Bitmap::BI_RGB, 3, 2, {}, {rows.begin(), rows.end() - 1})));
+    REQUIRE_FALSE(load(MakeBmp(24, Bitmap::BI_RGB, 100000, 100000, {}, rows)));
+    REQUIRE_FALSE(load(MakeBmp(8, Bitmap::BI_RLE8, 3, -2, std::vector<uint8_t>(4), {0, 1})));
+    REQUIRE_FALSE(load(MakeBmp(8, Bitmap::BI_RLE8, 60000, 60000, std::vector<uint8_t>(4), {0, 1})));
+    REQUIRE_FALSE(load(MakeBmp(16, Bitmap::BI_RGB, 3, 2, {}, rows)));
+
+    // Маленький RLE файл с огромными размерами проходит проверку заголовков, но память под строки
+    // выделяется только по мере распаковки, и обрыв данных обнаруживается без выделения всего изображения
+    std::string huge_rle = MakeBmp(8, Bitmap::BI_RLE8, 16384, 16384, std::vector<uint8_t>(4), {0, 0, 5});
+    std::istringstream huge_stream(huge_rle);
+    BitmapRowReader huge_reader;
+    REQUIRE(huge_reader.Open(huge_stream));
+    REQUIRE_FALSE(load(huge_rle));
+    REQUIRE(bmp.GetPixels().GetHeight() <= 2);
+    REQUIRE(bmp.GetPixels().GetWidth() == 16384);
+    // Конец изображения в RLE допустим: строки после него заполняются нулевым цветом палитры
+    REQUIRE(load(MakeBmp(8, Bitmap::BI_RLE8, 3, 5, {10, 20, 30, 0}, {2, 0, 0, 0, 0, 1})));
+    REQUIRE(bmp.GetPixels().GetHeight() == 5);
+    REQUIRE(bmp.GetPixels()(0, 0) == PixelArray::Pixel{10, 20, 30});
+    REQUIRE(bmp.GetPixels()(0, 2) == PixelArray::Pixel{10, 20, 30});
+    REQUIRE(bmp.GetPixels()(4, 2) == PixelArray::Pixel{10, 20, 30});
+}
+
+TEST_CASE("TestBitmapProbe") {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "image_processor_probe_test";
+    std::filesystem::remove_all(directory);
+    std::filesystem::create_directories(directory / "nested");
+    auto write = [](const std::filesystem::path& path, const std::string& data) {
+        std::ofstream(path, std::ios_base::binary) << data;
+    };
+    const std::vector<uint8_t> rows(24);
+    const std::string file = MakeBmp(24, Bitmap::BI_RGB, 3, 2, {}, rows);
+    write(directory / "b.bmp", file);
+    write(directory / "a.bmp", file.substr(0, file.size() - 5));
+    write(directory / "nested" / "c.bmp", MakeBmp(8, Bitmap::BI_RLE8, 640, 480, std::vector<uint8_t>(4), {0, 1}));
+    write(directory / "nested" / "d.bmp", "not a bmp");
+    write(directory / "e.txt", MakeBmp(24, Bitmap::BI_RGB, 3, -2, {}, rows));
+    // Ссылка на каталог выше по дереву не обходится, иначе файлы находились бы бесконечно
+    std::filesystem::create_directory_symlink(directory, directory / "nested" / "up");
+
+    BitmapProbe::ResultVector results = BitmapProbe::ProbeAll(directory);
+    REQUIRE(results.size() == 4);
+    REQUIRE(results[0].path == directory / "a.bmp");
+    REQUIRE(results[0].valid);
+    REQUIRE_FALSE(results[0].IsComplete());
+    REQUIRE(results[0].file_size + 5 == results[0].required_size);
+    REQUIRE(results[1].path == directory / "b.bmp");
+    REQUIRE(results[1].valid);
+    REQUIRE(results[1].width == 3);
+    REQUIRE(results[1].height == 2);
+    REQUIRE(results[1].bits_per_pixel == 24);
+    REQUIRE(results[1].IsComplete());
+    // Размеры сжатого изображения известны без распаковки
+    REQUIRE(results[2].valid);
+    REQUIRE(results[2].width == 640);
+    REQUIRE(results[2].height == 480);
+    REQUIRE(results[2].compression == uint32_t{Bitmap::BI_RLE8});
+    REQUIRE(results[2].IsComplete());
+    REQUIRE_FALSE(results[3].valid);
+
+    std::ostringstream output;
+    BitmapProbe::Print(results[1], output);
+    REQUIRE(output.str() == (directory / "b.bmp").string() + ": 3x2, 24 bpp, file size ok\n");
+    output.str("");
+    BitmapProbe::Print(results[0], output);
+    REQUIRE(output.str() == (directory / "a.bmp").string() + ": 3x2, 24 bpp, file is truncated: " +
+                                std::to_string(file.size() - 5) + " of " + std::to_string(file.size()) + " bytes\n");
+
+    // Отдельный файл проверяется, даже если у него другое расширение
+    results = BitmapProbe::ProbeAll(directory / "e.txt");
+    REQUIRE(results.size() == 1);
+    REQUIRE(results[0].valid);
+    REQUIRE(results[0].height == 2);
+    REQUIRE(results[0].top_down);
+    output.str("");
+    BitmapProbe::Print(results[0], output);
+    REQUIRE(output.str() == (directory / "e.txt").string() + ": 3x2, 24 bpp, top-down, file size ok\n");
+    std::filesystem::remove_all(directory);
+}
+
+TEST_CASE("BenchmarkBitmapProbe", "[.benchmark]") {
+    const size_t directories = 20;
+    const size_t files_per_directory = 500;
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "image_processor_probe_benchmark";
+    std::filesystem::remove_all(directory);
+    Bitmap bmp;
+    bmp.GetPixels() = MakeNoise(64, 64, 23);
+    for (size_t i = 0; i < directories; ++i) {
+        std::filesystem::path subdirectory = directory / std::to_string(i);
+        std::filesystem::create_directories(subdirectory);
+        for (size_t j = 0; j < files_per_directory; ++j) {
+            REQUIRE(bmp.CreateFile((subdirectory / (std::to_string(j) + ".bmp")).c_str()));
+        }
+    }
+    auto measure = [](const std::string& name, auto&& function) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto finish = std::chrono::steady_clock::now();
+        double milliseconds = std::chrono::duration<double, std::milli>(finish - start).count();
+        std::cout << name << ": " << milliseconds << " ms, "
+                  << static_cast<double>(directories * files_per_directory) * 1000 / milliseconds << " files/s"
+                  << std::endl;
+    };
+    measure("probe", [&] {
+        BitmapProbe::ResultVector results = BitmapProbe::ProbeAll(directory);
+        REQUIRE(results.size() == directories * files_per_directory);
+    });
+    measure("load", [&] {
+        for (const std::filesystem::path& path : BitmapProbe::FindFiles(directory)) {
+            REQUIRE(bmp.Load(path.c_str()));
+        }
+    });
+    std::filesystem::remove_all(directory);
+}
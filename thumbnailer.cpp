@@ -0,0 +1,76 @@
+#include "thumbnailer.h"
+#include "filter_pipeline_factory.h"
+
+#include <stdexcept>
+
+void Thumbnailer::AddSize(size_t width, size_t height) {
+    sizes_.push_back({width, height});
+}
+
+Thumbnailer::PixelArrayVector Thumbnailer::Generate(const PixelArray& pixels) const {
+    PixelArrayVector result(sizes_.size());
+    // Уровни пирамиды строятся при первой надобности и сохраняются: размер, меньший по площади, может быть
+    // шире или выше предыдущего, и тогда ему нужен уровень крупнее, чем предыдущему
+    PixelArrayVector reduced_levels;
+    auto get_level = [&pixels, &reduced_levels](size_t level) -> const PixelArray& {
+        return level == 0 ? pixels : reduced_levels[level - 1];
+    };
+    for (size_t i = 0; i < sizes_.size(); ++i) {
+        const Size& size = sizes_[i];
+        size_t level = 0;
+        // Следующий уровень пирамиды (округление вверх, как в PixelMath::BoxReduce) ещё не меньше нужного
+        // по обоим измерениям
+        while ((get_level(level).GetWidth() + 1) / 2 >= size.width &&
+               (get_level(level).GetHeight() + 1) / 2 >= size.height && get_level(level).GetWidth() > 1 &&
+               get_level(level).GetHeight() > 1) {
+            if (level == reduced_levels.size()) {
+                PixelArray reduced = PixelMath::BoxReduce(get_level(level), 2, 2);
+                reduced_levels.push_back(std::move(reduced));
+            }
+            ++level;
+        }
+        Bitmap holder;
+        holder.GetPixels() = get_level(level);
+        LanczosScaleFilter(size.width, size.height).Apply(holder);
+        result[i] = std::move(holder.GetPixels());
+    }
+    return result;
+}
+
+Thumbnailer::SizeVector Thumbnailer::ParseSizes(std::string_view sizes) {
+    SizeVector result;
+    while (!sizes.empty()) {
+        size_t comma_pos = sizes.find(',');
+        std::string_view current_size = sizes.substr(0, comma_pos);
+        sizes = comma_pos == std::string_view::npos ? std::string_view() : sizes.substr(comma_pos + 1);
+        size_t x_pos = current_size.find('x');
+        if (x_pos == std::string_view::npos) {
+            throw std::invalid_argument("wrong thumbnail size format");
+        }
+        size_t width;
+        size_t height;
+        try {
+            width = FilterFactories::SWtoSize(current_size.substr(0, x_pos));
+            height = FilterFactories::SWtoSize(current_size.substr(x_pos + 1));
+        } catch (std::invalid_argument& e) {
+            throw std::invalid_argument("wrong thumbnail size format");
+        }
+        if (width == 0 || height == 0) {
+            throw std::invalid_argument("thumbnail size must be positive");
+        }
+        result.push_back({width, height});
+    }
+    if (result.empty()) {
+        throw std::invalid_argument("no thumbnail sizes given");
+    }
+    return result;
+}
+
+std::string Thumbnailer::GetThumbnailFileName(std::string_view output_file_name, Size size) {
+    std::string_view extension = ".bmp";
+    if (output_file_name.ends_with(extension)) {
+        output_file_name.remove_suffix(extension.size());
+    }
+    return std::string(output_file_name) + "_" + std::to_string(size.width) + "x" + std::to_string(size.height) +
+           std::string(extension);
+}
@@ -0,0 +1,38 @@
+// Построение нескольких уменьшенных копий изображения за одно чтение файла.
+// Изображение последовательно уменьшается вдвое (пирамида разрешений), и каждая копия
+// получается фильтром Ланцоша из ближайшего уровня пирамиды, который ещё не меньше неё.
+// Так полноразмерное изображение усредняется только один раз, а не для каждого размера.
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "bitmap.h"
+
+class Thumbnailer {
+public:
+    struct Size {
+        size_t width;
+        size_t height;
+    };
+    using SizeVector = std::vector<Size>;
+    using PixelArrayVector = std::vector<PixelArray>;
+
+public:
+    void AddSize(size_t width, size_t height);
+
+    const SizeVector& GetSizes() const { return sizes_; }
+
+    // Возвращает уменьшенные копии pixels в порядке добавления размеров
+    PixelArrayVector Generate(const PixelArray& pixels) const;
+
+    // Разбирает список размеров вида "256x256,128x96". Бросает std::invalid_argument при ошибке формата.
+    static SizeVector ParseSizes(std::string_view sizes);
+
+    // Имя файла для копии: "out.bmp" -> "out_256x128.bmp"
+    static std::string GetThumbnailFileName(std::string_view output_file_name, Size size);
+
+protected:
+    SizeVector sizes_;
+};
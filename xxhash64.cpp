@@ -0,0 +1,125 @@
+#include "xxhash64.h"
+
+#include <bit>
+#include <cstring>
+#include <vector>
+
+namespace {
+    const uint64_t PRIME1 = 11400714785074694791ULL;
+    const uint64_t PRIME2 = 14029467366897019727ULL;
+    const uint64_t PRIME3 = 1609587929392839161ULL;
+    const uint64_t PRIME4 = 9650029242287828579ULL;
+    const uint64_t PRIME5 = 2870177450012600261ULL;
+
+    uint64_t Read64(const uint8_t* data) {
+        uint64_t result;
+        std::memcpy(&result, data, sizeof(result));
+        if constexpr (std::endian::native == std::endian::big) {
+            result = __builtin_bswap64(result);
+        }
+        return result;
+    }
+
+    uint32_t Read32(const uint8_t* data) {
+        uint32_t result;
+        std::memcpy(&result, data, sizeof(result));
+        if constexpr (std::endian::native == std::endian::big) {
+            result = __builtin_bswap32(result);
+        }
+        return result;
+    }
+
+    uint64_t Round(uint64_t accumulator, uint64_t input) {
+        accumulator += input * PRIME2;
+        accumulator = std::rotl(accumulator, 31);
+        return accumulator * PRIME1;
+    }
+
+    uint64_t MergeRound(uint64_t accumulator, uint64_t value) {
+        accumulator ^= Round(0, value);
+        return accumulator * PRIME1 + PRIME4;
+    }
+}
+
+XXHash64::XXHash64(uint64_t seed) : seed_(seed) {
+    accumulators_ = {seed + PRIME1 + PRIME2, seed + PRIME2, seed, seed - PRIME1};
+}
+
+void XXHash64::Update(const void* data, size_t size) {
+    const uint8_t* current = static_cast<const uint8_t*>(data);
+    const uint8_t* end = current + size;
+    total_size_ += size;
+    if (buffer_size_ + size < STRIPE_SIZE) {
+        std::memcpy(buffer_.data() + buffer_size_, current, size);
+        buffer_size_ += size;
+        return;
+    }
+    if (buffer_size_ > 0) {
+        size_t missing = STRIPE_SIZE - buffer_size_;
+        std::memcpy(buffer_.data() + buffer_size_, current, missing);
+        current += missing;
+        for (size_t i = 0; i < accumulators_.size(); ++i) {
+            accumulators_[i] = Round(accumulators_[i], Read64(buffer_.data() + i * 8));
+        }
+        buffer_size_ = 0;
+    }
+    while (end - current >= static_cast<std::ptrdiff_t>(STRIPE_SIZE)) {
+        for (size_t i = 0; i < accumulators_.size(); ++i) {
+            accumulators_[i] = Round(accumulators_[i], Read64(current + i * 8));
+        }
+        current += STRIPE_SIZE;
+    }
+    buffer_size_ = end - current;
+    std::memcpy(buffer_.data(), current, buffer_size_);
+}
+
+bool XXHash64::Update(std::istream& stream) {
+    const size_t CHUNK_SIZE = 1 << 16;
+    std::vector<char> chunk(CHUNK_SIZE);
+    while (stream) {
+        stream.read(chunk.data(), CHUNK_SIZE);
+        Update(chunk.data(), static_cast<size_t>(stream.gcount()));
+    }
+    return stream.eof() && !stream.bad();
+}
+
+uint64_t XXHash64::Digest() const {
+    uint64_t result;
+    if (total_size_ >= STRIPE_SIZE) {
+        result = std::rotl(accumulators_[0], 1) + std::rotl(accumulators_[1], 7) +
+                 std::rotl(accumulators_[2], 12) + std::rotl(accumulators_[3], 18);
+        for (uint64_t accumulator : accumulators_) {
+            result = MergeRound(result, accumulator);
+        }
+    } else {
+        result = seed_ + PRIME5;
+    }
+    result += total_size_;
+    const uint8_t* current = buffer_.data();
+    const uint8_t* end = current + buffer_size_;
+    for (; end - current >= 8; current += 8) {
+        result ^= Round(0, Read64(current));
+        result = std::rotl(result, 27) * PRIME1 + PRIME4;
+    }
+    if (end - current >= 4) {
+        result ^= static_cast<uint64_t>(Read32(current)) * PRIME1;
+        result = std::rotl(result, 23) * PRIME2 + PRIME3;
+        current += 4;
+    }
+    for (; current < end; ++current) {
+        result ^= *current * PRIME5;
+        result = std::rotl(result, 11) * PRIME1;
+    }
+    result ^= result >> 33;
+    result *= PRIME2;
+    result ^= result >> 29;
+    result *= PRIME3;
+    result ^= result >> 32;
+    return result;
+}
+
+uint64_t XXHash64::Hash(std::string_view data, uint64_t seed) {
+    XXHash64 hash(seed);
+    hash.Update(data);
+    return hash.Digest();
+}
@@ -0,0 +1,37 @@
+// 64-битный некриптографический хеш XXH64 (Yann Collet). Считается порциями, поэтому
+// файл любого размера можно хешировать, не загружая его в память целиком.
+// Данные читаются как little-endian, результат совпадает с эталонной реализацией на x86 и ARM.
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0);
+
+    void Update(const void* data, size_t size);
+
+    void Update(std::string_view data) { Update(data.data(), data.size()); }
+
+    // Дочитывает stream до конца. Возвращает false при ошибке чтения.
+    bool Update(std::istream& stream);
+
+    // Хеш всех переданных данных; после вызова можно продолжать добавлять данные
+    uint64_t Digest() const;
+
+    static uint64_t Hash(std::string_view data, uint64_t seed = 0);
+
+protected:
+    static const size_t STRIPE_SIZE = 32;
+
+protected:
+    std::array<uint64_t, 4> accumulators_;
+    std::array<uint8_t, STRIPE_SIZE> buffer_;
+    size_t buffer_size_ = 0;
+    uint64_t total_size_ = 0;
+    uint64_t seed_;
+};